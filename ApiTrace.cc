@@ -0,0 +1,198 @@
+#include <cstring>
+
+#include "ApiTrace.h"
+#include "RenderContext.h"
+
+namespace {
+
+// magic bytes at start of file
+const char magic[8] = { 'N', 'o', 'G', 'L', '3', 'd', 'T', '\0' };
+// version of file format
+// (version 1 lacks the viewport in frames, i.e. is still readable)
+const uint32 version = 2;
+// byte order mark (to detect files of other byte order)
+const uint32 byteOrder = 0x01020304;
+
+// kinds of records in file
+enum { TagTex = 1, TagFrame = 2 };
+
+// number of float values of a command (0 ... command with argument)
+uint getNValues(CommandBuffer::OpCode op)
+{
+  switch (op) {
+    case CommandBuffer::OpSetProjMat:
+    case CommandBuffer::OpSetViewMat:
+    case CommandBuffer::OpSetCamMat:
+    case CommandBuffer::OpSetModelMat: return 16;
+    case CommandBuffer::OpSetAmbient: return 1;
+    case CommandBuffer::OpSetNormal: return 3;
+    case CommandBuffer::OpSetColor: return 4;
+    case CommandBuffer::OpSetTexCoord: return 2;
+    case CommandBuffer::OpDrawVertex: return 3;
+    case CommandBuffer::OpSetClearColor: return 4;
+    case CommandBuffer::OpSetViewport: return 2;
+    default: return 0; // OpEnable, OpSetTex, OpClear
+  }
+}
+
+// writes a 32 bit value
+void write(std::ostream &out, uint32 value)
+{
+  out.write((const char*)&value, sizeof value);
+}
+
+// reads a 32 bit value
+bool read(std::istream &in, uint32 &value)
+{
+  return (bool)in.read((char*)&value, sizeof value);
+}
+
+} // namespace
+
+bool ApiTraceWriter::open(
+  const std::string &file, uint width, uint height, uint format)
+{
+  _fOut.open(file, std::ios::binary | std::ios::trunc);
+  if (!_fOut) return false;
+  _fOut.write(magic, sizeof magic);
+  write(_fOut, version); write(_fOut, byteOrder);
+  write(_fOut, width); write(_fOut, height); write(_fOut, format);
+  return (bool)_fOut;
+}
+
+void ApiTraceWriter::writeTex(uint width, uint height, const uint32 img[])
+{
+  write(_fOut, TagTex); write(_fOut, width); write(_fOut, height);
+  _fOut.write((const char*)img, (std::streamsize)width * height * 4);
+}
+
+void ApiTraceWriter::writeFrame(const CommandBuffer &cmdBuf)
+{
+  write(_fOut, TagFrame); write(_fOut, (uint32)cmdBuf.size());
+  const float *values = cmdBuf.values();
+  const CommandBuffer::Command *cmd = cmdBuf.cmds();
+  for (const CommandBuffer::Command *end = cmd + cmdBuf.size();
+    cmd != end; ++cmd) {
+    _fOut.put((char)cmd->op);
+    if (const uint nValues = getNValues(cmd->op)) {
+      _fOut.write((const char*)(values + cmd->arg), nValues * sizeof (float));
+    } else write(_fOut, cmd->arg);
+  }
+}
+
+bool ApiTraceWriter::close()
+{
+  _fOut.close();
+  return (bool)_fOut;
+}
+
+ApiTraceReader::ApiTraceReader():
+  _width(0), _height(0), _format(0), _texWidth(0), _texHeight(0)
+{ }
+
+bool ApiTraceReader::open(const std::string &file)
+{
+  _fIn.open(file, std::ios::binary);
+  if (!_fIn) { _error = "Cannot open file."; return false; }
+  char magicFile[sizeof magic];
+  uint32 versionFile, byteOrderFile;
+  if (!_fIn.read(magicFile, sizeof magicFile)
+    || std::memcmp(magicFile, magic, sizeof magic) != 0
+    || !::read(_fIn, versionFile) || !::read(_fIn, byteOrderFile)) {
+    _error = "Not an API trace."; return false;
+  }
+  if (versionFile < 1 || versionFile > version) {
+    _error = "Unsupported version of API trace."; return false;
+  }
+  if (byteOrderFile != byteOrder) {
+    _error = "API trace of other byte order."; return false;
+  }
+  if (!::read(_fIn, _width) || !::read(_fIn, _height)
+    || !::read(_fIn, _format)) {
+    _error = "Truncated header."; return false;
+  }
+  return true;
+}
+
+ApiTraceReader::Record ApiTraceReader::read()
+{
+  uint32 tag;
+  if (!::read(_fIn, tag)) return RecEnd;
+  switch (tag) {
+    case TagTex: {
+      if (!::read(_fIn, _texWidth) || !::read(_fIn, _texHeight)
+        || !isPowerOf2(_texWidth) || !isPowerOf2(_texHeight)
+        || _texWidth > 1 << 15 || _texHeight > 1 << 15) {
+        return error("Broken texture record.");
+      }
+      _texImg.resize((size_t)_texWidth * _texHeight);
+      if (!_fIn.read((char*)_texImg.data(), _texImg.size() * 4)) {
+        return error("Truncated texture record.");
+      }
+    } return RecTex;
+    case TagFrame: {
+      uint32 nCmds;
+      if (!::read(_fIn, nCmds)) return error("Truncated frame record.");
+      _cmdBuf.reset();
+      for (uint32 i = 0; i < nCmds; ++i) {
+        const int op = _fIn.get();
+        if (op < 0 || op > CommandBuffer::OpSetViewport) { // last op code
+          return error("Broken command in frame record.");
+        }
+        const uint nValues = getNValues((CommandBuffer::OpCode)op);
+        float values[16]; uint32 arg = 0;
+        if (!(nValues
+          ? (bool)_fIn.read((char*)values, nValues * sizeof (float))
+          : ::read(_fIn, arg))) {
+          return error("Truncated frame record.");
+        }
+        Mat4x4f mat;
+        if (nValues == 16) std::copy(values, values + 16, mat.comp);
+        switch (op) {
+          case CommandBuffer::OpSetProjMat: _cmdBuf.setProjMat(mat); break;
+          case CommandBuffer::OpSetViewMat: _cmdBuf.setViewMat(mat); break;
+          case CommandBuffer::OpSetCamMat: _cmdBuf.setCamMat(mat); break;
+          case CommandBuffer::OpSetModelMat: _cmdBuf.setModelMat(mat); break;
+          case CommandBuffer::OpEnable:
+            if (arg / 2 >= RenderContext::NModes) {
+              return error("Unknown mode in frame record.");
+            }
+            _cmdBuf.enable(arg / 2, (arg & 1) != 0);
+            break;
+          case CommandBuffer::OpSetAmbient:
+            _cmdBuf.setAmbient(values[0]);
+            break;
+          case CommandBuffer::OpSetNormal:
+            _cmdBuf.setNormal(Vec3f(values[0], values[1], values[2]));
+            break;
+          case CommandBuffer::OpSetColor:
+            _cmdBuf.setColor(
+              Vec4f(values[0], values[1], values[2], values[3]));
+            break;
+          case CommandBuffer::OpSetTexCoord:
+            _cmdBuf.setTexCoord(Vec2f(values[0], values[1]));
+            break;
+          case CommandBuffer::OpDrawVertex:
+            _cmdBuf.drawVertex(Vec3f(values[0], values[1], values[2]));
+            break;
+          case CommandBuffer::OpSetTex: _cmdBuf.setTex(arg); break;
+          case CommandBuffer::OpSetClearColor:
+            _cmdBuf.setClearColor(
+              Vec4f(values[0], values[1], values[2], values[3]));
+            break;
+          case CommandBuffer::OpClear:
+            _cmdBuf.clear((arg & 1) != 0, (arg & 2) != 0);
+            break;
+          case CommandBuffer::OpSetViewport:
+            if (!(values[0] >= 1.0f && values[0] <= 1 << 15
+              && values[1] >= 1.0f && values[1] <= 1 << 15)) {
+              return error("Broken viewport in frame record.");
+            }
+            _cmdBuf.setViewport((uint)values[0], (uint)values[1]);
+            break;
+        }
+      }
+    } return RecFrame;
+    default: return error("Unknown record.");
+  }
+}
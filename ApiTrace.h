@@ -0,0 +1,211 @@
+/** @file
+ * interface of classes ApiTraceWriter and ApiTraceReader
+ */
+
+#ifndef API_TRACE_H
+#define API_TRACE_H
+
+// standard C++ header:
+#include <fstream>
+#include <string>
+#include <vector>
+
+// own header:
+#include "CommandBuffer.h"
+#include "util.h"
+
+/* An API trace records the calls to a RenderContext (see
+ * RenderContext::startApiTrace()) in a compact binary file:
+ *
+ * - header: magic "NoGL3dT", version, byte order mark,
+ *   width, height, and pixel format of the render context
+ * - texture records: width, height, and texels (RGBA)
+ *   in order of RenderContext::loadTex()
+ * - frame records: number of commands and the commands of one frame
+ *   (op code as byte followed by its argument or its float values
+ *   as in CommandBuffer).
+ *
+ * All values are stored in native byte order (checked by reader).
+ * Each frame starts with the complete render state (including the size
+ * of frame buffers as viewport since version 2).
+ * Thus, any frame can be replayed on its own (after all textures which
+ * precede it are loaded).
+ */
+
+/** provides writing of API traces.
+ */
+class ApiTraceWriter {
+
+  // variables:
+  private:
+    /// output file
+    std::ofstream _fOut;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// constructor.
+    ApiTraceWriter() = default;
+
+    /// destructor.
+    ~ApiTraceWriter() = default;
+
+    // disabled:
+    ApiTraceWriter(const ApiTraceWriter&) = delete;
+    ApiTraceWriter& operator=(const ApiTraceWriter&) = delete;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /** opens a file and writes the header.
+     *
+     * @param file path of file
+     * @param width width of frame buffers
+     * @param height height of frame buffers
+     * @param format pixel format of color buffer
+     * @return true ... file opened\n
+     *         false ... file not writable
+     */
+    bool open(const std::string &file, uint width, uint height, uint format);
+
+    /** writes a texture record.
+     *
+     * @param width width of texture
+     * @param height height of texture
+     * @param img texels of texture (RGBA)
+     */
+    void writeTex(uint width, uint height, const uint32 img[]);
+
+    /** writes a frame record.
+     *
+     * @param cmdBuf commands of frame
+     */
+    void writeFrame(const CommandBuffer &cmdBuf);
+
+    /** closes the file.
+     *
+     * @return true ... everything written\n
+     *         false ... write error occurred
+     */
+    bool close();
+
+    //@}
+};
+
+/** provides reading of API traces.
+ */
+class ApiTraceReader {
+
+  // types:
+  public:
+    /// kinds of records
+    enum Record {
+      RecTex, ///< texture (see getTexWidth(), getTexHeight(), getTexImg())
+      RecFrame, ///< frame (see getFrame())
+      RecEnd, ///< end of file
+      RecError ///< broken file (see getError())
+    };
+
+  // variables:
+  private:
+    /// input file
+    std::ifstream _fIn;
+    /// width of frame buffers
+    uint _width;
+    /// height of frame buffers
+    uint _height;
+    /// pixel format of color buffer
+    uint _format;
+    /// width of last read texture
+    uint _texWidth;
+    /// height of last read texture
+    uint _texHeight;
+    /// texels of last read texture
+    std::vector<uint32> _texImg;
+    /// commands of last read frame
+    CommandBuffer _cmdBuf;
+    /// message of last error
+    std::string _error;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// constructor.
+    ApiTraceReader();
+
+    /// destructor.
+    ~ApiTraceReader() = default;
+
+    // disabled:
+    ApiTraceReader(const ApiTraceReader&) = delete;
+    ApiTraceReader& operator=(const ApiTraceReader&) = delete;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /** opens a file and reads the header.
+     *
+     * @param file path of file
+     * @return true ... file opened\n
+     *         false ... file not readable or no API trace (see getError())
+     */
+    bool open(const std::string &file);
+
+    /// returns width of frame buffers (as recorded).
+    uint getWidth() const { return _width; }
+
+    /// returns height of frame buffers (as recorded).
+    uint getHeight() const { return _height; }
+
+    /// returns pixel format of color buffer (as recorded).
+    uint getFormat() const { return _format; }
+
+    /** reads the next record.
+     *
+     * @return kind of record read
+     */
+    Record read();
+
+    /// returns width of texture (after RecTex).
+    uint getTexWidth() const { return _texWidth; }
+
+    /// returns height of texture (after RecTex).
+    uint getTexHeight() const { return _texHeight; }
+
+    /// returns texels of texture (after RecTex).
+    const uint32* getTexImg() const { return _texImg.data(); }
+
+    /** returns commands of frame (after RecFrame).
+     *
+     * The commands may be moved out of the reader.
+     *
+     * @return commands of frame
+     */
+    CommandBuffer& getFrame() { return _cmdBuf; }
+
+    /// returns message of last error.
+    const std::string& getError() const { return _error; }
+
+    //@}
+  private:
+    /// @name Internal Stuff
+    //@{
+
+    /// sets error message and returns RecError.
+    Record error(const std::string &error)
+    {
+      _error = error; return RecError;
+    }
+
+    //@}
+};
+
+#endif // API_TRACE_H
@@ -0,0 +1,287 @@
+/** @file
+ * interface of class CommandBuffer
+ */
+
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+// standard C++ header:
+#include <vector>
+
+// own header:
+#include "linmath.h"
+#include "util.h"
+
+/** provides a class to record rendering commands for later replay.
+ *
+ * A command buffer provides the state changing and drawing methods of
+ * RenderContext but doesn't render anything.
+ * Instead, the calls are recorded and may be replayed later with
+ * RenderContext::execute().
+ *
+ * A command buffer doesn't share any data with other instances or with
+ * the render context.
+ * Hence, distinct command buffers may be filled by distinct threads
+ * concurrently (e.g. to distribute scene traversal and culling over
+ * multiple cores) while the replay happens on one thread in a defined
+ * order.
+ */
+class CommandBuffer {
+
+  // types:
+  public:
+
+    /// command codes
+    enum OpCode {
+      OpSetProjMat, ///< set projection matrix (16 values)
+      OpSetViewMat, ///< set view matrix (16 values)
+      OpSetCamMat, ///< set camera matrix (16 values)
+      OpSetModelMat, ///< set model matrix (16 values)
+      OpEnable, ///< enable/disable mode (arg: mode * 2 + flag)
+      OpSetAmbient, ///< set ambient light factor (1 value)
+      OpSetNormal, ///< set current normal (3 values)
+      OpSetColor, ///< set current color (4 values)
+      OpSetTexCoord, ///< set current texture coordinate (2 values)
+      OpDrawVertex, ///< draw vertex (3 values)
+      OpSetTex, ///< set current texture (arg: texture index)
+      OpSetClearColor, ///< set clear color (4 values)
+      OpClear, ///< clear frame buffer(s) (arg: 1 ... RGBA, 2 ... depth)
+      OpSetViewport ///< set size of viewport (2 values: width, height)
+    };
+
+    /// recorded command
+    struct Command {
+      OpCode op; ///< command code
+      /** argument of command
+       *
+       * For commands with floating point values, this is the index of
+       * the first value in values().
+       */
+      uint arg;
+      /// constructor.
+      Command(OpCode op, uint arg): op(op), arg(arg) { }
+    };
+
+  // variables:
+  private:
+    /// recorded commands
+    std::vector<Command> _cmds;
+    /// floating point values of recorded commands
+    std::vector<float> _values;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// default constructor.
+    CommandBuffer() = default;
+    /// destructor.
+    ~CommandBuffer() = default;
+    /// move constructor.
+    CommandBuffer(CommandBuffer&&) = default;
+    /// move assignment.
+    CommandBuffer& operator=(CommandBuffer&&) = default;
+
+    // disabled:
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    //@}
+  public:
+    /// @name Recording
+    //@{
+
+    /** removes all recorded commands.
+     *
+     * The allocated storage is kept for re-use in next recording.
+     */
+    void reset() { _cmds.clear(); _values.clear(); }
+
+    /** reserves storage for an expected number of commands.
+     *
+     * @param nCmds number of commands
+     * @param nValues number of floating point values
+     */
+    void reserve(size_t nCmds, size_t nValues)
+    {
+      _cmds.reserve(nCmds); _values.reserve(nValues);
+    }
+
+    /** records setting of projection matrix.
+     *
+     * @param mat the new projection matrix
+     */
+    void setProjMat(const Mat4x4f &mat) { add(OpSetProjMat, mat); }
+
+    /** records setting of view matrix.
+     *
+     * @param mat the new view matrix
+     */
+    void setViewMat(const Mat4x4f &mat) { add(OpSetViewMat, mat); }
+
+    /** records setting of camera matrix.
+     *
+     * @param mat the new camera matrix
+     */
+    void setCamMat(const Mat4x4f &mat) { add(OpSetCamMat, mat); }
+
+    /** records setting of model matrix.
+     *
+     * @param mat the new model matrix
+     */
+    void setModelMat(const Mat4x4f &mat) { add(OpSetModelMat, mat); }
+
+    /** records enabling/disabling of a mode.
+     *
+     * @param mode the mode to change (a RenderContext::Mode)
+     * @param enable flag: true ... enable, false ... disable
+     */
+    void enable(uint mode, bool enable = true)
+    {
+      _cmds.emplace_back(OpEnable, mode * 2 + (uint)enable);
+    }
+    /** records disabling of a mode.
+     *
+     * @param mode the mode to disable (a RenderContext::Mode)
+     */
+    void disable(uint mode) { enable(mode, false); }
+
+    /** records setting of ambient light factor.
+     *
+     * @param ambient new ambient light factor
+     */
+    void setAmbient(float ambient)
+    {
+      add(OpSetAmbient); _values.push_back(ambient);
+    }
+
+    /** records setting of current normal.
+     *
+     * @param value the normal to set
+     */
+    void setNormal(const Vec3f &value) { add(OpSetNormal, value); }
+
+    /** records setting of current color.
+     *
+     * @param value the color to set
+     */
+    void setColor(const Vec4f &value) { add(OpSetColor, value); }
+
+    /** records setting of current texture coordinate.
+     *
+     * @param value the texture coordinate to set
+     */
+    void setTexCoord(const Vec2f &value)
+    {
+      add(OpSetTexCoord); _values.push_back(value.x);
+      _values.push_back(value.y);
+    }
+
+    /** records drawing of a vertex.
+     *
+     * @param coord the vertex coordinates
+     */
+    void drawVertex(const Vec3f &coord) { add(OpDrawVertex, coord); }
+
+    /** records setting of current texture.
+     *
+     * @param i texture index (as returned by RenderContext::loadTex())
+     */
+    void setTex(uint i) { _cmds.emplace_back(OpSetTex, i); }
+
+    /** records setting of clear color.
+     *
+     * @param color clear color
+     */
+    void setClearColor(const Vec4f &color) { add(OpSetClearColor, color); }
+
+    /** records clearing of frame buffer(s).
+     *
+     * @param rgba flag: true ... clear color buffer
+     * @param depth flag: true ... clear depth buffer
+     */
+    void clear(bool rgba, bool depth)
+    {
+      _cmds.emplace_back(OpClear, (uint)rgba | (uint)depth << 1);
+    }
+
+    /** records setting of viewport size.
+     *
+     * @param width width of viewport (in pixels)
+     * @param height height of viewport (in pixels)
+     */
+    void setViewport(uint width, uint height)
+    {
+      add(OpSetViewport); _values.push_back((float)width);
+      _values.push_back((float)height);
+    }
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /** returns whether command buffer is empty.
+     *
+     * @return true ... no commands recorded\n
+     *         false ... otherwise
+     */
+    bool empty() const { return _cmds.empty(); }
+
+    /** returns number of recorded commands.
+     *
+     * @return number of recorded commands
+     */
+    size_t size() const { return _cmds.size(); }
+
+    /** returns recorded commands.
+     *
+     * @return start address of recorded commands
+     */
+    const Command* cmds() const { return _cmds.data(); }
+
+    /** returns floating point values of recorded commands.
+     *
+     * @return start address of floating point values
+     */
+    const float* values() const { return _values.data(); }
+
+    //@}
+  private:
+    /// @name Internal Stuff
+    //@{
+
+    /** adds a command with floating point values following.
+     *
+     * @param op command code
+     */
+    void add(OpCode op) { _cmds.emplace_back(op, (uint)_values.size()); }
+
+    /// adds a command with a 3d vector.
+    void add(OpCode op, const Vec3f &vec)
+    {
+      add(op);
+      _values.push_back(vec.x); _values.push_back(vec.y);
+      _values.push_back(vec.z);
+    }
+
+    /// adds a command with a 4d vector.
+    void add(OpCode op, const Vec4f &vec)
+    {
+      add(op);
+      _values.push_back(vec.x); _values.push_back(vec.y);
+      _values.push_back(vec.z); _values.push_back(vec.w);
+    }
+
+    /// adds a command with a 4x4 matrix.
+    void add(OpCode op, const Mat4x4f &mat)
+    {
+      add(op);
+      _values.insert(_values.end(), mat.comp, mat.comp + 16);
+    }
+
+    //@}
+};
+
+#endif // COMMAND_BUFFER_H
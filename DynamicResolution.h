@@ -0,0 +1,127 @@
+/** @file
+ * interface of class DynamicResolution
+ */
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// standard C++ header:
+#include <algorithm>
+#include <cmath>
+
+// own header:
+#include "util.h"
+
+/** provides a controller of the render scale to meet a frame time budget.
+ *
+ * The controller is fed with the measured duration of every frame and
+ * returns the render scale for the next frame
+ * (see RenderContext::setRenderScale()).
+ *
+ * The frame time is smoothed with an exponential moving average.
+ * If the average exceeds the budget, the scale is lowered immediately.
+ * As the render time is roughly proportional to the number of pixels,
+ * the scale is multiplied by the square root of budget / average.
+ * If the average stays below a certain ratio of the budget (headroom)
+ * for a number of frames (cool-down), the scale is raised slowly.
+ * Thus, the scale doesn't oscillate between two values.
+ *
+ * The scale is quantized to steps of 1/32 to prevent resizing of frame
+ * buffers for tiny changes.
+ */
+class DynamicResolution {
+
+  // variables:
+  private:
+    /// frame time budget (in s)
+    double _dtBudget;
+    /// minimal render scale
+    float _scaleMin;
+    /// ratio of budget below which the scale is raised
+    double _headroom;
+    /// number of frames with headroom before the scale is raised
+    uint _nCoolDown;
+    /// current render scale
+    float _scale;
+    /// smoothed frame time (in s, 0 ... none yet)
+    double _dtAvg;
+    /// number of frames since last change of scale
+    uint _nFrames;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /** constructor.
+     *
+     * @param dtBudget frame time budget (in s)
+     * @param scaleMin minimal render scale
+     * @param headroom ratio of budget below which the scale is raised
+     * @param nCoolDown number of frames with headroom before the scale
+     *        is raised
+     */
+    explicit DynamicResolution(
+      double dtBudget = 1.0 / 30.0, float scaleMin = 0.25f,
+      double headroom = 0.8, uint nCoolDown = 10):
+      _dtBudget(dtBudget), _scaleMin(scaleMin),
+      _headroom(headroom), _nCoolDown(nCoolDown),
+      _scale(1.0f), _dtAvg(0.0), _nFrames(0)
+    { }
+
+    /// destructor.
+    ~DynamicResolution() = default;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /// returns frame time budget (in s).
+    double getBudget() const { return _dtBudget; }
+
+    /** sets frame time budget.
+     *
+     * @param dtBudget frame time budget (in s)
+     */
+    void setBudget(double dtBudget) { _dtBudget = dtBudget; }
+
+    /// returns current render scale.
+    float getScale() const { return _scale; }
+
+    /// resets the controller to full scale.
+    void reset() { _scale = 1.0f; _dtAvg = 0.0; _nFrames = 0; }
+
+    /** updates the render scale with the duration of a frame.
+     *
+     * @param dt duration of last frame (in s)
+     * @return render scale for next frame
+     */
+    float update(double dt)
+    {
+      _dtAvg = _dtAvg > 0.0 ? 0.8 * _dtAvg + 0.2 * dt : dt;
+      ++_nFrames;
+      float scale = _scale;
+      if (_dtAvg > _dtBudget) { // too slow: lower the scale at once
+        scale *= (float)std::sqrt(_dtBudget / _dtAvg);
+      } else if (_dtAvg < _headroom * _dtBudget && _nFrames > _nCoolDown) {
+        // headroom: raise the scale by at most 10 %
+        scale *= (float)std::min(std::sqrt(_dtBudget / _dtAvg), 1.1);
+      }
+      scale = std::min(std::max(scale, _scaleMin), 1.0f);
+      // quantize (rounding towards the direction of change)
+      scale = scale < _scale
+        ? std::floor(32.0f * scale) / 32.0f : std::ceil(32.0f * scale) / 32.0f;
+      scale = std::min(std::max(scale, _scaleMin), 1.0f);
+      if (scale != _scale) {
+        // expected frame time is proportional to number of pixels
+        _dtAvg *= (scale * scale) / (_scale * _scale);
+        _scale = scale; _nFrames = 0;
+      }
+      return _scale;
+    }
+
+    //@}
+};
+
+#endif // DYNAMIC_RESOLUTION_H
@@ -0,0 +1,187 @@
+/** @file
+ * interface of class Histogram
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+// standard C++ header:
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// own header:
+#include "util.h"
+
+/** provides a lock-free histogram of integral values (e.g. durations in
+ * ns) with bounded relative error (like an HDR histogram).
+ *
+ * The values are grouped in buckets by powers of 2.
+ * Each power of 2 is split into linear sub-buckets.
+ * Thus, the relative error of any reported value is below
+ * 2 / NSubBuckets while the whole range of 64 bit values is covered with
+ * about a thousand counters.
+ *
+ * Values may be added concurrently by any number of threads.
+ */
+class Histogram {
+
+  // types:
+  public:
+    enum {
+      SubBits = 5, ///< number of bits for sub-buckets
+      NSubBuckets = 1 << SubBits, ///< number of sub-buckets
+      /// number of buckets
+      NBuckets = (64 - SubBits) * (NSubBuckets / 2) + NSubBuckets
+    };
+
+  // variables:
+  private:
+    /// counters of buckets
+    std::atomic<uint64_t> _counts[NBuckets];
+    /// number of added values
+    std::atomic<uint64_t> _n;
+    /// sum of added values
+    std::atomic<uint64_t> _sum;
+    /// max. of added values
+    std::atomic<uint64_t> _max;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// constructor (with empty histogram).
+    Histogram() { reset(); }
+
+    /// destructor.
+    ~Histogram() = default;
+
+    // disabled:
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /** resets the histogram.
+     *
+     * @note
+     * Values added concurrently might get lost.
+     */
+    void reset()
+    {
+      for (std::atomic<uint64_t> &count : _counts) count = 0;
+      _n = 0; _sum = 0; _max = 0;
+    }
+
+    /** adds a value.
+     *
+     * @param value the value to add
+     */
+    void add(uint64_t value)
+    {
+      _counts[getIBucket(value)].fetch_add(1, std::memory_order_relaxed);
+      _n.fetch_add(1, std::memory_order_relaxed);
+      _sum.fetch_add(value, std::memory_order_relaxed);
+      uint64_t max = _max.load(std::memory_order_relaxed);
+      while (value > max
+        && !_max.compare_exchange_weak(max, value,
+          std::memory_order_relaxed));
+    }
+
+    /** returns number of added values.
+     *
+     * @return number of values
+     */
+    uint64_t getCount() const { return _n.load(std::memory_order_relaxed); }
+
+    /** returns max. of added values.
+     *
+     * @return max. value (0 if empty)
+     */
+    uint64_t getMax() const { return _max.load(std::memory_order_relaxed); }
+
+    /** returns mean of added values.
+     *
+     * @return mean value (0 if empty)
+     */
+    double getMean() const
+    {
+      const uint64_t n = getCount();
+      return n ? (double)_sum.load(std::memory_order_relaxed) / n : 0.0;
+    }
+
+    /** returns a percentile of added values.
+     *
+     * @param p the percentile in [0, 1] (e.g. 0.99 for p99)
+     * @return (upper bound of bucket of) value at percentile\n
+     *         0 if empty
+     */
+    uint64_t getPercentile(double p) const
+    {
+      const uint64_t n = getCount();
+      if (!n) return 0;
+      const uint64_t rank = std::max((uint64_t)(p * n + 0.5), (uint64_t)1);
+      uint64_t sum = 0;
+      for (uint i = 0; i < NBuckets; ++i) {
+        sum += _counts[i].load(std::memory_order_relaxed);
+        if (sum >= rank) return std::min(getBucketMax(i), getMax());
+      }
+      return getMax();
+    }
+
+    //@}
+  private:
+    /// @name Internal Stuff
+    //@{
+
+    /// returns index of bucket for a value.
+    static uint getIBucket(uint64_t value)
+    {
+      if (value < NSubBuckets) return (uint)value;
+      const uint shift = getMSB(value) - SubBits + 1;
+      return shift * (NSubBuckets / 2) + (uint)(value >> shift);
+    }
+
+    /// returns the max. value of a bucket.
+    static uint64_t getBucketMax(uint i)
+    {
+      if (i < NSubBuckets) return i;
+      const uint shift = i / (NSubBuckets / 2) - 1;
+      const uint64_t sub = i - shift * (NSubBuckets / 2);
+      return ((sub + 1) << shift) - 1;
+    }
+
+    /// returns the index of most significant bit set (value > 0).
+    static uint getMSB(uint64_t value)
+    {
+#if defined(__GNUC__)
+      return 63 - (uint)__builtin_clzll(value);
+#else // portable
+      uint i = 0;
+      while (value >>= 1) ++i;
+      return i;
+#endif // __GNUC__
+    }
+
+    //@}
+};
+
+/** returns the value at a percentile of sorted values (nearest rank as in
+ * Histogram::getPercentile()).
+ *
+ * @param values sorted values (not empty)
+ * @param p the percentile in [0, 1] (e.g. 0.99 for p99)
+ * @return value at percentile
+ */
+inline double getPercentile(const std::vector<double> &values, double p)
+{
+  const size_t i = std::max((size_t)(p * values.size() + 0.5), (size_t)1);
+  return values[std::min(i, values.size()) - 1];
+}
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,144 @@
+#include "JobSystem.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace {
+
+// the job system of the current worker thread (if any)
+thread_local const JobSystem *pJobSysThread = nullptr;
+// the queue index of the current worker thread
+thread_local uint iQueueThread = 0;
+
+// pins a thread to a certain core
+void pinThread(std::thread &thread, uint iCore)
+{
+#if defined(__linux__)
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet); CPU_SET(iCore, &cpuSet);
+  pthread_setaffinity_np(thread.native_handle(), sizeof cpuSet, &cpuSet);
+#elif defined(_WIN32)
+  SetThreadAffinityMask((HANDLE)thread.native_handle(),
+    (DWORD_PTR)1 << iCore);
+#else // not supported
+  (void)thread; (void)iCore;
+#endif
+}
+
+} // namespace
+
+JobSystem::JobSystem(uint nThreads, bool pin):
+  _pin(false), _nQueues(0), _nJobs(0), _exit(false), _nSleeping(0)
+{
+  start(nThreads, pin);
+}
+
+JobSystem::~JobSystem()
+{
+  stop();
+}
+
+uint JobSystem::getDefaultThreads()
+{
+  const uint nCores = std::thread::hardware_concurrency();
+  return nCores > 1 ? nCores - 1 : 0;
+}
+
+void JobSystem::setThreads(uint nThreads, bool pin)
+{
+  if (nThreads == getThreads() && pin == _pin) return;
+  stop(); start(nThreads, pin);
+}
+
+void JobSystem::submit(const Job &job)
+{
+  Queue &queue = _queues[getIQueue()];
+  // count first (a thief might take the job before it's counted)
+  _nJobs.fetch_add(1, std::memory_order_seq_cst);
+  { std::lock_guard<std::mutex> lock(queue.lock);
+    queue.jobs.push_back(job);
+  }
+  if (_nSleeping.load(std::memory_order_seq_cst)) {
+    std::lock_guard<std::mutex> lock(_lockSleep);
+    _awake.notify_one();
+  }
+}
+
+bool JobSystem::runOne()
+{
+  if (!_nJobs.load(std::memory_order_relaxed)) return false;
+  const uint iQueue = getIQueue();
+  Job job;
+  // try own queue first (LIFO), then steal from other queues (FIFO)
+  bool found = pop(_queues[iQueue], true, job);
+  for (uint i = 1; !found && i < _nQueues; ++i) {
+    found = pop(_queues[(iQueue + i) % _nQueues], false, job);
+  }
+  if (!found) return false;
+  _nJobs.fetch_sub(1, std::memory_order_relaxed);
+  job.func(job.pCtx, job.arg0, job.arg1);
+  return true;
+}
+
+bool JobSystem::pop(Queue &queue, bool back, Job &job)
+{
+  std::lock_guard<std::mutex> lock(queue.lock);
+  if (queue.jobs.empty()) return false;
+  if (back) { job = queue.jobs.back(); queue.jobs.pop_back(); }
+  else { job = queue.jobs.front(); queue.jobs.pop_front(); }
+  return true;
+}
+
+void JobSystem::start(uint nThreads, bool pin)
+{
+  assert(_threads.empty());
+  _pin = pin;
+  _nQueues = nThreads + 1;
+  _queues.reset(new Queue[_nQueues]);
+  _exit = false;
+  const uint nCores = std::thread::hardware_concurrency();
+  for (uint i = 0; i < nThreads; ++i) {
+    _threads.emplace_back(&JobSystem::work, this, i);
+    // leave core 0 to the main thread
+    if (_pin && nCores) pinThread(_threads.back(), (i + 1) % nCores);
+  }
+}
+
+void JobSystem::stop()
+{
+  { std::lock_guard<std::mutex> lock(_lockSleep);
+    _exit = true;
+    _awake.notify_all();
+  }
+  for (std::thread &thread : _threads) thread.join();
+  _threads.clear();
+  // finish jobs left behind (e.g. background jobs submitted meanwhile)
+  while (runOne());
+  assert(!_nJobs);
+}
+
+void JobSystem::work(uint iThread)
+{
+  pJobSysThread = this; iQueueThread = iThread;
+  for (;;) {
+    if (runOne()) continue;
+    // nothing to do -> sleep until new jobs are submitted
+    std::unique_lock<std::mutex> lock(_lockSleep);
+    _nSleeping.fetch_add(1, std::memory_order_seq_cst);
+    while (!_nJobs.load(std::memory_order_seq_cst) && !_exit) {
+      _awake.wait(lock);
+    }
+    _nSleeping.fetch_sub(1, std::memory_order_relaxed);
+    if (_exit) break;
+  }
+}
+
+uint JobSystem::getIQueue() const
+{
+  return pJobSysThread == this ? iQueueThread : _nQueues - 1;
+}
@@ -0,0 +1,240 @@
+/** @file
+ * interface of class JobSystem
+ */
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+// standard C++ header:
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// own header:
+#include "util.h"
+
+/** provides a work-stealing job scheduler with a fixed set of threads.
+ *
+ * Each worker thread has its own queue of jobs.
+ * A worker takes jobs from the back of its own queue (LIFO).
+ * If its queue is empty it steals jobs from the front of the other
+ * queues (FIFO).
+ * Jobs submitted by threads which are not workers (e.g. the GUI thread)
+ * are stored in an additional queue.
+ *
+ * Threads waiting for jobs to complete (e.g. in parallelFor()) help
+ * executing pending jobs meanwhile.
+ * Hence, the job system works even without any worker thread.
+ */
+class JobSystem {
+
+  // types:
+  public:
+
+    /// job (function with context and two arguments)
+    struct Job {
+      /// function to call
+      void (*func)(void *pCtx, size_t arg0, size_t arg1);
+      void *pCtx; ///< context passed to function
+      size_t arg0; ///< 1st argument passed to function
+      size_t arg1; ///< 2nd argument passed to function
+    };
+
+  private:
+
+    /// queue of jobs
+    struct Queue {
+      std::mutex lock; ///< mutex to guard jobs
+      std::deque<Job> jobs; ///< queued jobs
+    };
+
+    /// common data of jobs of a parallelFor()
+    struct Task {
+      JobSystem *pJobSys; ///< job system to split range into
+      size_t grain; ///< max. size of range processed in one job
+      std::atomic<size_t> nLeft; ///< number of elements not yet done
+      const void *pFunc; ///< function to call for a range
+    };
+
+  // variables:
+  private:
+    /// worker threads
+    std::vector<std::thread> _threads;
+    /// flag: true ... worker threads are pinned to cores
+    bool _pin;
+    /// queues (one per worker thread + one for other threads)
+    std::unique_ptr<Queue[]> _queues;
+    /// number of queues
+    uint _nQueues;
+    /// number of queued jobs
+    std::atomic<size_t> _nJobs;
+    /// flag: true ... worker threads shall exit
+    std::atomic<bool> _exit;
+    /// number of worker threads sleeping
+    std::atomic<uint> _nSleeping;
+    /// mutex for sleeping worker threads
+    std::mutex _lockSleep;
+    /// condition variable for sleeping worker threads
+    std::condition_variable _awake;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /** constructor.
+     *
+     * @param nThreads number of worker threads
+     * @param pin flag: true ... pin each worker thread to a core
+     */
+    explicit JobSystem(
+      uint nThreads = getDefaultThreads(), bool pin = false);
+
+    /// destructor.
+    ~JobSystem();
+
+    // disabled:
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /** returns the default number of worker threads.
+     *
+     * @return number of cores - 1 (as the calling thread helps as well)
+     */
+    static uint getDefaultThreads();
+
+    /** returns number of worker threads.
+     *
+     * @return number of worker threads
+     */
+    uint getThreads() const { return (uint)_threads.size(); }
+
+    /** returns whether worker threads are pinned to cores.
+     *
+     * @return true ... worker threads pinned\n
+     *         false ... otherwise
+     */
+    bool isPinned() const { return _pin; }
+
+    /** changes the number of worker threads.
+     *
+     * @note
+     * Pending jobs are finished before (by the calling thread if needed).
+     *
+     * @param nThreads number of worker threads
+     * @param pin flag: true ... pin each worker thread to a core
+     */
+    void setThreads(uint nThreads, bool pin = false);
+
+    /** submits a job.
+     *
+     * The job is executed by any thread of job system at any time later
+     * (or by a thread calling runOne()).
+     *
+     * @param job the job to submit
+     */
+    void submit(const Job &job);
+
+    /** executes one pending job (if there is any).
+     *
+     * @return true ... a job has been executed\n
+     *         false ... no pending job found
+     */
+    bool runOne();
+
+    /** calls a function for all elements of a range in parallel.
+     *
+     * The range is split into sub-ranges recursively until the
+     * sub-ranges have not more than @a grain elements.
+     * The function is called for each of the sub-ranges.
+     * The calling thread helps until all sub-ranges are done.
+     *
+     * @param begin first element of range
+     * @param end element after last element of range
+     * @param grain max. number of elements processed in one call
+     * @param func function to call with (begin, end) of a sub-range
+     */
+    template <typename FUNC>
+    void parallelFor(size_t begin, size_t end, size_t grain, const FUNC &func)
+    {
+      if (end <= begin) return;
+      if (grain == 0) grain = 1;
+      if (_threads.empty() || end - begin <= grain) {
+        func(begin, end); return;
+      }
+      Task task;
+      task.pJobSys = this; task.grain = grain;
+      task.nLeft = end - begin; task.pFunc = &func;
+      runRange<FUNC>(&task, begin, end);
+      while (task.nLeft.load(std::memory_order_acquire)) {
+        if (!runOne()) std::this_thread::yield();
+      }
+    }
+
+    //@}
+  private:
+    /// @name Internal Stuff
+    //@{
+
+    /// starts the worker threads.
+    void start(uint nThreads, bool pin);
+
+    /// stops the worker threads.
+    void stop();
+
+    /** runs a worker thread.
+     *
+     * @param iThread index of worker thread
+     */
+    void work(uint iThread);
+
+    /** returns the queue index for the calling thread.
+     *
+     * @return index of own queue (for worker threads)\n
+     *         index of queue for other threads (otherwise)
+     */
+    uint getIQueue() const;
+
+    /** takes a job from a queue.
+     *
+     * @param queue the queue to take the job from
+     * @param back flag: true ... take from back, false ... from front
+     * @param job the job taken
+     * @return true ... job taken\n
+     *         false ... queue empty
+     */
+    static bool pop(Queue &queue, bool back, Job &job);
+
+    /** processes a range of a parallelFor().
+     *
+     * The range is split until it's not larger than grain.
+     * The split off parts are submitted as new jobs.
+     */
+    template <typename FUNC>
+    static void runRange(void *pCtx, size_t begin, size_t end)
+    {
+      Task &task = *(Task*)pCtx;
+      while (end - begin > task.grain) {
+        const size_t mid = begin + (end - begin) / 2;
+        const Job job = { &runRange<FUNC>, pCtx, mid, end };
+        task.pJobSys->submit(job);
+        end = mid;
+      }
+      (*(const FUNC*)task.pFunc)(begin, end);
+      task.nLeft.fetch_sub(end - begin, std::memory_order_release);
+    }
+
+    //@}
+};
+
+#endif // JOB_SYSTEM_H
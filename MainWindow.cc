@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <thread>
 
 #include <QtWidgets>
 
@@ -8,18 +11,20 @@
 MainWindow::MainWindow(
   uint width, uint height, QWidget *pQParent):
   QWidget(pQParent),
-  context3d(width, height),
+  context3d(width, height, RenderContext::ARGB32Premultiplied),
   _xCam(0.0f), _yCam(0.0f), _zCam(2.5f),
   _hCam(0.0f), _pCam(0.0f), _rCam(0.0f),
   _lockCam(false),
   _fov(30.0f), _dNear(0.01f), _dFar(100.0f),
   _headLight(true),
   _dtSum(0.0), _nFPS(0), _iFPS(0),
-  _resSphere(4),
+  _pMesh(nullptr), _resSphere(4), _resSphereMesh(4),
+  _errorSphere(0), _nTrisAdaptive(0),
   _qSliderAmbient(Qt::Horizontal),
   _qView3d(context3d),
-  _angle(0), _stepAngle(5),
-  _iImg(0)
+  _angle(0.0f), _speedAngle(100.0f), _dtAnimMin(16),
+  _iImg(0),
+  _recSession(false), _replaySession(false), _iFrameSession(0)
 {
   // prepare texture
   { // load image (using Qt image loader plug-in)
@@ -32,22 +37,24 @@ MainWindow::MainWindow(
     // convert blue (picked in GIMP) to alpha
     std::vector<uint32> imgA(img, img + width * height);
     colorToAlpha(width, height, imgA.data(),
-      rgbaToColor(0xffb17a4f).xyz(), 100.0f);
+      rgbaToColor(0xffb17a4f).xyz(), 100.0f, &context3d.getJobSystem());
     // merge original and processed image to weaken the alpha effect
-    mergeColors(width, height, img, img, imgA.data(), 0.5f, 0.5f);
+    mergeColors(width, height, img, img, imgA.data(), 0.5f, 0.5f,
+      &context3d.getJobSystem());
 #if 0 // test:
     // save image to file (for check in GIMP)
     qImg.save("Earth-alpha.png");
 #endif // 0
-    // load image as texture
+    // load image as texture (render thread is idle before 1st request)
     uint idTex = context3d.loadTex(
       qImg.width(), qImg.height(), (const uint32*)qImg.bits());
     assert(idTex > 0);
     // bind image
-    context3d.setTex(idTex);
+    _qView3d.getState().iTex = idTex;
   }
-  // init render context
-  context3d.setClearColor(Vec4f(0.5f, 0.75f, 1.0f, 1.0f));
+  // init render state
+  RenderContext::State &state = _qView3d.getState();
+  state.rgbaClear = context3d.colorToPixel(Vec4f(0.5f, 0.75f, 1.0f, 1.0f));
   updateCamMat(false); updateProjMat(false);
   // build GUI
   _qTxtDuration.setReadOnly(true);
@@ -88,13 +95,61 @@ MainWindow::MainWindow(
   _qTxtTrisVtcs.setReadOnly(true);
   _qForm.addRow(QString::fromUtf8("Geometry:"), &_qTxtTrisVtcs);
   _qForm.addRow(QString::fromUtf8("Duration:"), &_qTxtDuration);
+#if RENDER_STATS
+  _qForm.addRow(QString::fromUtf8("Pipeline:"), &_qLblStats);
+#endif // RENDER_STATS
+#if RENDER_PROFILE
+  _qTglProfile.setChecked(false);
+  _qTglProfile.setToolTip(
+    QString::fromUtf8("Trace is written to noGL3d-trace.json when off."));
+  _qForm.addRow(QString::fromUtf8("Profiling:"), &_qTglProfile);
+  _qLblProfile.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  _qForm.addRow(QString::fromUtf8("Stages:"), &_qLblProfile);
+#endif // RENDER_PROFILE
+  _qTglApiTrace.setChecked(false);
+  _qTglApiTrace.setToolTip(
+    QString::fromUtf8("Frames are recorded to noGL3d.trace while on."));
+  _qForm.addRow(QString::fromUtf8("API Trace:"), &_qTglApiTrace);
+  _qTglRecSession.setText(QString::fromUtf8("Record"));
+  _qTglRecSession.setToolTip(
+    QString::fromUtf8("Session is written to noGL3d.session when off."));
+  _qHBoxSession.addWidget(&_qTglRecSession);
+  _qBtnReplaySession.setText(QString::fromUtf8("Replay"));
+  _qBtnReplaySession.setToolTip(
+    QString::fromUtf8(
+      "Replays noGL3d.session and writes timings to noGL3d-session.csv."));
+  _qHBoxSession.addWidget(&_qBtnReplaySession);
+  _qHBoxSession.addWidget(&_qLblSession, 1);
+  _qForm.addRow(QString::fromUtf8("Session:"), &_qHBoxSession);
   _qForm.addRow(new QLabel(QString::fromUtf8("<b>Settings:</b>")));
-  _qSpinBoxResSphere.setRange(0, 4);
+  _qSpinBoxResSphere.setRange(0, Session::ResSphereMax);
   _qSpinBoxResSphere.setValue(_resSphere);
   _qForm.addRow(QString::fromUtf8("Res. of Sphere:"), &_qSpinBoxResSphere);
+  _qSpinBoxErrorSphere.setRange(0, 16);
+  _qSpinBoxErrorSphere.setValue(_errorSphere);
+  _qSpinBoxErrorSphere.setSuffix(QString::fromUtf8(" px"));
+  _qSpinBoxErrorSphere.setSpecialValueText(QString::fromUtf8("off"));
+  _qSpinBoxErrorSphere.setToolTip(QString::fromUtf8(
+    "Sphere is tessellated per frame up to this error on screen\n"
+    "(with Res. of Sphere as max. depth)."));
+  _qForm.addRow(QString::fromUtf8("Adaptive:"), &_qSpinBoxErrorSphere);
+  const int nCores = std::max((int)std::thread::hardware_concurrency(), 1);
+  _qSpinBoxThreads.setRange(0, nCores);
+  _qSpinBoxThreads.setValue(state.nThreads);
+  _qForm.addRow(QString::fromUtf8("Worker Threads:"), &_qSpinBoxThreads);
+  _qTglPinThreads.setChecked(state.pinThreads);
+  _qForm.addRow(QString::fromUtf8("Pin Threads:"), &_qTglPinThreads);
+  _qSpinBoxRasterBands.setRange(0, 4 * nCores);
+  _qSpinBoxRasterBands.setValue(state.nRasterBands);
+  _qForm.addRow(QString::fromUtf8("Raster Bands:"), &_qSpinBoxRasterBands);
+  _qSpinBoxBudget.setRange(0, 1000);
+  _qSpinBoxBudget.setSuffix(QString::fromUtf8(" ms"));
+  _qSpinBoxBudget.setSpecialValueText(QString::fromUtf8("off"));
+  _qSpinBoxBudget.setToolTip(QString::fromUtf8(
+    "Render resolution is lowered while frames take longer."));
+  _qForm.addRow(QString::fromUtf8("Frame Budget:"), &_qSpinBoxBudget);
 #define CHECK_BOX(MODE, TEXT) \
-  _qTgl##MODE.setChecked( \
-    context3d.isEnabled(RenderContext::MODE)); \
+  _qTgl##MODE.setChecked(state.isEnabled(RenderContext::MODE)); \
   _qForm.addRow(QString::fromUtf8(TEXT), &_qTgl##MODE)
   CHECK_BOX(FrontSide, "Show front sides:");
   CHECK_BOX(BackSide, "Show back sides:");
@@ -105,14 +160,27 @@ MainWindow::MainWindow(
   CHECK_BOX(Texturing, "Textures:");
   CHECK_BOX(Lighting, "Lighting:");
 #undef CHECK_BOX
+  _qTglHeatmap.setChecked(state.isEnabled(RenderContext::Heatmap));
+  _qHBoxHeatmap.addWidget(&_qTglHeatmap);
+  _qCmbHeatKind.addItem(QString::fromUtf8("Writes"));
+  _qCmbHeatKind.addItem(QString::fromUtf8("Depth Failed"));
+  _qCmbHeatKind.addItem(QString::fromUtf8("Blended"));
+  _qCmbHeatKind.addItem(QString::fromUtf8("Fragments"));
+  _qCmbHeatKind.setCurrentIndex(RenderContext::HeatFragments);
+  _qHBoxHeatmap.addWidget(&_qCmbHeatKind, 1);
+  _qBtnSaveHeatmap.setText(QString::fromUtf8("Save"));
+  _qBtnSaveHeatmap.setToolTip(
+    QString::fromUtf8("Saves presented image to noGL3d-heatmap.png."));
+  _qHBoxHeatmap.addWidget(&_qBtnSaveHeatmap);
+  _qForm.addRow(QString::fromUtf8("Heatmap:"), &_qHBoxHeatmap);
   _qSpinBoxAmbient.setRange(0.0, 1.0);
   _qSpinBoxAmbient.setSingleStep(0.1);
-  _qSpinBoxAmbient.setValue(context3d.getAmbient());
+  _qSpinBoxAmbient.setValue(state.ambient);
   _qVBoxAmbient.addWidget(&_qSpinBoxAmbient);
   _qSliderAmbient.setRange(0, 100);
   _qSliderAmbient.setSingleStep(1);
   _qSliderAmbient.setPageStep(10);
-  _qSliderAmbient.setValue(context3d.getAmbient() * 100.0f);
+  _qSliderAmbient.setValue(state.ambient * 100.0f);
   _qVBoxAmbient.addWidget(&_qSliderAmbient);
   _qForm.addRow(QString::fromUtf8("Ambient:"), &_qVBoxAmbient);
   _qTglAnim.setChecked(false);
@@ -120,7 +188,7 @@ MainWindow::MainWindow(
   _qHBox.addLayout(&_qForm);
   _qHBox.addWidget(&_qView3d);
   setLayout(&_qHBox);
-  _qTimerAnim.setInterval(50); // ms
+  _qTimerAnim.setSingleShot(true); // re-started when frame is done
   // install signal handlers
   context3d.setRenderCallback(
     [&](RenderContext &context) { cbRender(context); });
@@ -164,15 +232,40 @@ MainWindow::MainWindow(
   connect(&_qSpinBoxResSphere,
     (void(QSpinBox::*)(int))&QSpinBox::valueChanged,
     [&](int resSphere) {
-      _resSphere = (uint)resSphere;
-      _mesh.vtcs.clear(); // force re-build
-      context3d.render();
+      _resSphere = (uint)resSphere; // mesh is re-built in cbRender()
+      _qView3d.requestRender();
     });
+  connect(&_qSpinBoxErrorSphere,
+    (void(QSpinBox::*)(int))&QSpinBox::valueChanged,
+    [&](int error) {
+      _errorSphere = (uint)error; // mesh is re-built in cbRender()
+      _qView3d.requestRender();
+    });
+  connect(&_qSpinBoxThreads,
+    (void(QSpinBox::*)(int))&QSpinBox::valueChanged,
+    [&](int nThreads) {
+      _qView3d.getState().nThreads = (uint)nThreads;
+      _qView3d.requestRender();
+    });
+  connect(&_qTglPinThreads, &QCheckBox::toggled,
+    [&](bool pin) {
+      _qView3d.getState().pinThreads = pin;
+      _qView3d.requestRender();
+    });
+  connect(&_qSpinBoxRasterBands,
+    (void(QSpinBox::*)(int))&QSpinBox::valueChanged,
+    [&](int nBands) {
+      _qView3d.getState().nRasterBands = (uint)nBands;
+      _qView3d.requestRender();
+    });
+  connect(&_qSpinBoxBudget,
+    (void(QSpinBox::*)(int))&QSpinBox::valueChanged,
+    [&](int dt) { _qView3d.setFrameBudget(0.001 * dt); });
 #define CHECK_BOX(MODE) \
   connect(&_qTgl##MODE, &QCheckBox::toggled, \
     [&](bool enable) { \
-      context3d.enable(RenderContext::MODE, enable); \
-      context3d.render(); \
+      _qView3d.getState().enable(RenderContext::MODE, enable); \
+      _qView3d.requestRender(); \
     })
   CHECK_BOX(FrontSide);
   CHECK_BOX(BackSide);
@@ -182,37 +275,151 @@ MainWindow::MainWindow(
   CHECK_BOX(Blending);
   CHECK_BOX(Texturing);
   CHECK_BOX(Lighting);
+  CHECK_BOX(Heatmap);
 #undef CHECK_BOX
+  connect(&_qCmbHeatKind,
+    (void(QComboBox::*)(int))&QComboBox::currentIndexChanged,
+    [&](int kind) {
+      _qView3d.setHeatKind((RenderContext::HeatKind)kind);
+    });
+  connect(&_qBtnSaveHeatmap, &QPushButton::clicked,
+    [&](bool) {
+      if (!_qView3d.getImage().save(QString::fromUtf8("noGL3d-heatmap.png"))) {
+        qWarning("Cannot write noGL3d-heatmap.png!");
+      }
+    });
   connect(&_qSpinBoxAmbient,
     (void(QDoubleSpinBox::*)(double))&QDoubleSpinBox::valueChanged,
     [&](double ambient) {
-      context3d.setAmbient(ambient);
-      _qSliderAmbient.setValue(100 * context3d.getAmbient());
-      context3d.render();
+      float &ambientState = _qView3d.getState().ambient;
+      ambientState = clamp((float)ambient, 0.0f, 1.0f);
+      _qSliderAmbient.setValue(100 * ambientState);
+      _qView3d.requestRender();
     });
   connect(&_qSliderAmbient, &QSlider::valueChanged,
     [&](int ambient) {
-      context3d.setAmbient(0.01f * ambient);
-      _qSpinBoxAmbient.setValue(context3d.getAmbient());
-      context3d.render();
+      float &ambientState = _qView3d.getState().ambient;
+      ambientState = clamp(0.01f * ambient, 0.0f, 1.0f);
+      _qSpinBoxAmbient.setValue(ambientState);
+      _qView3d.requestRender();
+    });
+#if RENDER_PROFILE
+  connect(&_qTglProfile, &QCheckBox::toggled,
+    [&](bool enable) {
+      Profiler &profiler = context3d.getProfiler();
+      if (enable) {
+        std::string error;
+        if (!profiler.enablePerf(true, &error)) {
+          qWarning("HW counters not available: %s", error.c_str());
+        }
+        profiler.reset(); profiler.startTrace(); profiler.enable();
+        _qView3d.requestRender();
+      } else {
+        profiler.enable(false); profiler.enablePerf(false);
+        profiler.stopTrace();
+        if (!profiler.writeTrace("noGL3d-trace.json")) {
+          qWarning("Cannot write noGL3d-trace.json!");
+        }
+      }
+    });
+#endif // RENDER_PROFILE
+  connect(&_qTglApiTrace, &QCheckBox::toggled,
+    [&](bool enable) {
+      _qView3d.waitRender(); // render thread must not record meanwhile
+      if (enable) {
+        if (!context3d.startApiTrace("noGL3d.trace")) {
+          qWarning("Cannot write noGL3d.trace!");
+        }
+        _qView3d.requestRender();
+      } else if (!context3d.stopApiTrace()) {
+        qWarning("Cannot write noGL3d.trace!");
+      }
+    });
+  connect(&_qTglRecSession, &QCheckBox::toggled,
+    [&](bool enable) {
+      _qView3d.waitRender(); // render thread must not record meanwhile
+      if (enable) {
+        if (_replaySession) { _qTglRecSession.setChecked(false); return; }
+        _session.clear();
+        _tRecSession = std::chrono::steady_clock::now();
+        _recSession = true;
+        _qView3d.requestRender();
+      } else if (_recSession) {
+        _recSession = false;
+        if (!_session.save("noGL3d.session")) {
+          qWarning("Cannot write noGL3d.session!");
+        }
+        _qLblSession.setText(
+          QString("%1 frames recorded").arg((uint)_session.size()));
+      }
+    });
+  connect(&_qBtnReplaySession, &QPushButton::clicked,
+    [&](bool) {
+      if (_recSession || _replaySession) return;
+      _qView3d.waitRender(); // render thread must not access session
+      if (!_session.load("noGL3d.session")) {
+        qWarning("Cannot read noGL3d.session: %s",
+          _session.getError().c_str());
+        return;
+      }
+      if (!_session.size()) return;
+      _qTglAnim.setChecked(false); // would disturb the replay
+      _dtsSession.clear();
+      _iFrameSession = 0; _replaySession = true;
+      replaySessionFrame();
     });
   connect(&_qTglAnim, &QCheckBox::toggled,
     [&](bool enable) {
-      enable ? _qTimerAnim.start() : _qTimerAnim.stop();
+      if (enable) { _qTimeAnim.start(); _qTimerAnim.start(0); }
+      else _qTimerAnim.stop();
     });
   _qView3d.sigMatCamChanged.push_back(
     [&]() { updateCamMatWidgets(); });
+  _qView3d.sigViewportChanged.push_back(
+    [&]() { updateProjMat(false); }); // widget requests the frame
+  _qView3d.sigFrameDone.push_back(
+    [&]() {
+      if (!_replaySession) return;
+      if (++_iFrameSession < _session.size()) replaySessionFrame();
+      else { // replay done
+        _qView3d.waitRender(); // render thread must not access timings
+        _replaySession = false;
+        if (!_session.saveTimings("noGL3d-session.csv", _dtsSession)) {
+          qWarning("Cannot write noGL3d-session.csv!");
+        }
+        std::vector<double> dts = _dtsSession;
+        std::sort(dts.begin(), dts.end());
+        double sum = 0.0;
+        for (double dt : dts) sum += dt;
+        _qLblSession.setText(
+          QString("%1 frames: p50 %2, max %3, mean %4 ms")
+          .arg((uint)dts.size())
+          .arg(1000.0 * dts[dts.size() / 2], 0, 'f', 3)
+          .arg(1000.0 * dts.back(), 0, 'f', 3)
+          .arg(1000.0 * sum / dts.size(), 0, 'f', 3));
+        updateCamMatWidgets();
+      }
+    });
+  _qView3d.sigFrameDone.push_back(
+    [&]() {
+      if (!_qTglAnim.isChecked() || _qTimerAnim.isActive()) return;
+      // pace animation: next step not before the frame is done
+      const qint64 dt = _qTimeAnim.elapsed();
+      _qTimerAnim.start(dt < _dtAnimMin ? (int)(_dtAnimMin - dt) : 0);
+    });
   connect(&_qTimerAnim, &QTimer::timeout,
     [&]() {
-      (_angle += _stepAngle) %= 360;
-      context3d.getModelMat()
-        = Mat4x4f(InitRotY, degToRad((float)_angle));
-      context3d.render();
+      // advance by elapsed time (i.e. skip frames if rendering is slow)
+      const float dt = 0.001f * _qTimeAnim.restart();
+      _angle = std::fmod(_angle + _speedAngle * dt, 360.0f);
+      _qView3d.getState().matModel
+        = Mat4x4f(InitRotY, degToRad(_angle));
+      _qView3d.requestRender();
 #if 0 // record image sequence
-      if (_iImg < 36 && _angle % 10 == 0) {
+      if (_iImg < 36 && (uint)_angle % 10 == 0) {
         const QImage qImg((uchar*)context3d.getRGBA(),
           context3d.getViewportWidth(), context3d.getViewportHeight(),
-          QImage::Format_RGBA8888);
+          QImage::Format_ARGB32_Premultiplied);
         QString file
           = QString("snap-NoGL3d-%1.png").arg(_iImg, 2, 10, QChar('0'));
         qDebug() << "Save:" << file;
@@ -222,6 +429,13 @@ MainWindow::MainWindow(
     });
 }
 
+MainWindow::~MainWindow()
+{
+  // The render callback uses members declared after _qView3d which are
+  // destroyed before it. Hence, the render thread has to stop first.
+  _qView3d.stopRender();
+}
+
 void MainWindow::updateCamMat(bool render)
 {
   if (_lockCam) return;
@@ -229,31 +443,33 @@ void MainWindow::updateCamMat(bool render)
   Mat4x4f mat = makeEuler(RotYXZ,
     degToRad(_hCam), degToRad(_pCam), degToRad(_rCam));
   mat._03 = _xCam; mat._13 = _yCam; mat._23 = _zCam;
-  context3d.setCamMat(mat);
-  if (render) context3d.render();
+  _qView3d.getState().matCam = mat;
+  if (render) _qView3d.requestRender();
 }
 
 void MainWindow::updateProjMat(bool render)
 {
-  context3d.getProjMat()
+  _qView3d.getState().matProj
     = makePersp(degToRad(30.0f),
-      (float)context3d.getViewportWidth() / context3d.getViewportHeight(),
+      (float)_qView3d.getState().widthVP / _qView3d.getState().heightVP,
       _dNear, _dFar);
-  if (render) context3d.render();
+  if (render) _qView3d.requestRender();
 }
 
 void MainWindow::loadTex(const QString &file)
 {
   const QImage qImg = QImage(file).convertToFormat(QImage::Format_RGBA8888);
+  _qView3d.waitRender(); // render thread must not access textures
   uint idTex = context3d.loadTex(
     qImg.width(), qImg.height(), (const uint32*)qImg.bits());
-  context3d.setTex(idTex);
+  _qView3d.getState().iTex = idTex;
+  _qView3d.requestRender();
 }
 
 void MainWindow::showEvent(QShowEvent *pQEvent)
 {
   QWidget::showEvent(pQEvent);
-  context3d.render();
+  _qView3d.requestRender();
 }
 
 typedef std::chrono::high_resolution_clock Clock;
@@ -266,35 +482,87 @@ inline long long duration(const Time &from, const Time &to)
 
 void MainWindow::cbRender(RenderContext &context)
 {
+  // Attention! This is called in render thread.
   // build sphere if not yet done
-  if (_mesh.vtcs.empty()) {
-#if 1 // regular:
-    makeSphereMesh(_mesh, _resSphere);
+  const uint resSphere = _resSphere;
+  const uint errorSphere = _errorSphere;
+  if (!_pMesh || resSphere != _resSphereMesh
+    || (_pMesh == &_meshAdaptive) != (errorSphere > 0)) {
+    const MeshT<VertexCNT> *pMesh = &_meshAdaptive; // built per frame
+#if 1 // regular: (built levels are kept in cache)
+    if (!errorSphere) {
+      // build in background while the previous mesh is still rendered
+      // (except for 1st frame and replayed sessions)
+      pMesh = !_pMesh || _replaySession
+        ? &_spheres.get(resSphere, &context.getJobSystem())
+        : _spheres.request(resSphere, &context.getJobSystem(),
+          [this]() {
+            QMetaObject::invokeMethod(this,
+              [this]() { _qView3d.requestRender(); },
+              Qt::QueuedConnection);
+          });
+    }
 #else // used for debugging
-    _mesh.vtcs.emplace_back(
+    static MeshT<VertexCNT> mesh;
+    mesh.vtcs.emplace_back(
       Vec3f(0.0f, 1.0f, -0.5f), Vec3f(0.0f, 0.0f, 1.0f), Vec2f(0.0f, 0.0f));
-    _mesh.vtcs.emplace_back(
+    mesh.vtcs.emplace_back(
       Vec3f(-1.0f, 0.0f, -0.5f), Vec3f(0.0f, 0.0f, 1.0f), Vec2f(0.0f, 0.0f));
-    _mesh.vtcs.emplace_back(
+    mesh.vtcs.emplace_back(
       Vec3f(0.0f, -1.0f, -0.5f), Vec3f(0.0f, 0.0f, 1.0f), Vec2f(0.0f, 0.0f));
+    pMesh = &mesh;
 #endif // 1
-    _qTxtTrisVtcs.setText(
-      QString("%1 Tris, %2 Vtcs").arg(
-        QString::number(_mesh.vtcs.size() / 3),
-        QString::number(_mesh.vtcs.size())));
+    if (pMesh) { // swap in new mesh
+      _pMesh = pMesh; _resSphereMesh = resSphere;
+      if (errorSphere) _nTrisAdaptive = 0;
+      else {
+        const QString text = QString("%1 Tris, %2 Vtcs").arg(
+          QString::number(getNTris(*_pMesh)),
+          QString::number(_pMesh->vtcs.size()));
+        QMetaObject::invokeMethod(this,
+          [this, text]() { _qTxtTrisVtcs.setText(text); },
+          Qt::QueuedConnection);
+      }
+    }
+  }
+  // record session
+  if (_recSession) {
+    const RenderContext::State state = context.getState();
+    Session::Frame frame;
+    frame.t = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - _tRecSession).count();
+    frame.resSphere = _resSphereMesh;
+    frame.mode = state.mode; frame.ambient = state.ambient;
+    frame.matProj = state.matProj; frame.matCam = state.matCam;
+    frame.matModel = state.matModel;
+    _session.add(frame);
   }
   // start stop-watch
   const Time tStart = Clock::now();
+  // tessellate sphere for current view (part of frame time)
+  if (errorSphere) {
+    const SphereTessellation tess(
+      context.getProjMat(), context.getViewMat(), context.getModelMat(),
+      context.getRenderWidth(), context.getRenderHeight(),
+      (float)errorSphere * context.getRenderScale(), _resSphereMesh,
+      !context.isEnabled(RenderContext::BackSide));
+    makeSphereMeshAdaptive(_meshAdaptive, tess);
+    const size_t nTris = getNTris(_meshAdaptive);
+    if (nTris != _nTrisAdaptive) {
+      _nTrisAdaptive = nTris;
+      const QString text = QString("%1 Tris (adaptive)").arg(
+        QString::number(nTris));
+      QMetaObject::invokeMethod(this,
+        [this, text]() { _qTxtTrisVtcs.setText(text); },
+        Qt::QueuedConnection);
+    }
+  }
   // clear buffers
   context.clear(true, true);
   // render sphere
   context.setColor(Vec4f(1.0f, 1.0f, 1.0f, 1.0f));
-  for (size_t i = 0, n = _mesh.vtcs.size(); i < n; ++i) {
-    const VertexCNT &vtx = _mesh.vtcs[i];
-    context.setNormal(vtx.normal);
-    context.setTexCoord(vtx.texCoord);
-    context.drawVertex(vtx.coord);
-  }
+  drawMesh(context, *_pMesh);
+  context.finish(); // wait for raster jobs (in pipelined mode)
   // stop stop-watch
   const Time tEnd = Clock::now();
   const double dt = 1E-6 * duration(tStart, tEnd);
@@ -304,19 +572,57 @@ void MainWindow::cbRender(RenderContext &context)
     _iFPS = (_iFPS + 1) % NFPS;
   }
   _dtSum += dt;
+  if (_replaySession) _dtsSession.push_back(dt);
   const uint fps = _nFPS / _dtSum;
-  _qTxtDuration.setText(
-    QString("%1 s (%2 fps)").arg(
-    QString::number(dt, 'f', 6), QString::number(fps)));
-  // update 3d view
-  _qView3d.update();
+  QString text = QString("%1 s (%2 fps)").arg(
+    QString::number(dt, 'f', 6), QString::number(fps));
+  if (context.getRenderScale() < 1.0f) { // show lowered resolution
+    text += QString(" @ %1x%2").arg(
+      context.getRenderWidth()).arg(context.getRenderHeight());
+  }
+  QMetaObject::invokeMethod(this,
+    [this, text]() { _qTxtDuration.setText(text); },
+    Qt::QueuedConnection);
+#if RENDER_STATS
+  const RenderContext::Stats stats = context.getStats();
+  auto num = [](uint64_t n) { return QString::number((qulonglong)n); };
+  const QString textStats
+    = QString(
+      "%1 Vtcs, %2 Tris\n"
+      "%3 culled, %4 clipped, %5 split\n"
+      "%6 Tris rasterized\n"
+      "%7 Frags, %8 depth failed\n"
+      "%9 blended")
+    .arg(num(stats.nVtcs)).arg(num(stats.nTris))
+    .arg(num(stats.nTrisCulled)).arg(num(stats.nTrisClipped))
+    .arg(num(stats.nTrisSplit))
+    .arg(num(stats.nTrisRasterized))
+    .arg(num(stats.nFragments)).arg(num(stats.nFragsDepthFailed))
+    .arg(num(stats.nFragsBlended));
+  QMetaObject::invokeMethod(this,
+    [this, textStats]() { _qLblStats.setText(textStats); },
+    Qt::QueuedConnection);
+#endif // RENDER_STATS
+#if RENDER_PROFILE
+  if (context.getProfiler().isEnabled()) {
+    const Profiler &profiler = context.getProfiler();
+    const QString textProfile
+      = QString::fromStdString(profiler.getSummary()
+        + profiler.getPerfSummary(&RenderContext::getRasterizeName))
+      .trimmed();
+    QMetaObject::invokeMethod(this,
+      [this, textProfile]() { _qLblProfile.setText(textProfile); },
+      Qt::QueuedConnection);
+  }
+#endif // RENDER_PROFILE
+  // The 3d view is updated by the render thread.
 }
 
 void MainWindow::updateCamMatWidgets()
 {
   if (_lockCam) return;
   Lock lock(_lockCam);
-  const Mat4x4f &matCam = context3d.getCamMat();
+  const Mat4x4f &matCam = _qView3d.getState().matCam;
   // set x, y, z
   _qTxtCamX.setValue(_xCam = matCam._03);
   _qTxtCamY.setValue(_yCam = matCam._13);
@@ -325,4 +631,15 @@ void MainWindow::updateCamMatWidgets()
   _qTxtCamH.setValue(_hCam *= 180.0f / (float)Pi);
   _qTxtCamP.setValue(_pCam *= 180.0f / (float)Pi);
   _qTxtCamR.setValue(_rCam *= 180.0f / (float)Pi);
+}
+
+void MainWindow::replaySessionFrame()
+{
+  const Session::Frame &frame = _session.getFrames()[_iFrameSession];
+  RenderContext::State &state = _qView3d.getState();
+  state.matProj = frame.matProj; state.matCam = frame.matCam;
+  state.matModel = frame.matModel;
+  state.mode = frame.mode; state.ambient = frame.ambient;
+  _resSphere = frame.resSphere; // mesh is re-built in cbRender()
+  _qView3d.requestRender();
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #ifndef MAIN_WINDOW_H
 #define MAIN_WINDOW_H
 
+#include <atomic>
+
 #include <QBoxLayout>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QElapsedTimer>
 #include <QFormLayout>
+#include <QLabel>
+#include <QPushButton>
 #include <QSlider>
 #include <QSpinBox>
 #include <QWidget>
@@ -11,6 +17,8 @@
 
 #include "Mesh.h"
 #include "RenderWidget.h"
+#include "Scene.h"
+#include "Session.h"
 #include "Sphere.h"
 
 class MainWindow: public QWidget {
@@ -26,8 +34,14 @@ class MainWindow: public QWidget {
     enum { NFPS = 100 };
     double _dtFPS[NFPS], _dtSum;
     uint _nFPS, _iFPS;
-    MeshT<VertexCNT> _mesh;
-    uint _resSphere;
+    SphereMeshCacheT<MeshT<VertexCNT>> _spheres; // used in render thread
+    const MeshT<VertexCNT> *_pMesh; // used in render thread
+    std::atomic<uint> _resSphere; // changed in GUI thread
+    uint _resSphereMesh; // used in render thread
+    // max. projected error of adaptive sphere (in pixels, 0 ... off)
+    std::atomic<uint> _errorSphere; // changed in GUI thread
+    MeshT<VertexCNT> _meshAdaptive; // used in render thread
+    size_t _nTrisAdaptive; // used in render thread
     QHBoxLayout _qHBox;
     QFormLayout _qForm;
     QDoubleSpinBox _qTxtCamX, _qTxtCamY, _qTxtCamZ;
@@ -35,7 +49,20 @@ class MainWindow: public QWidget {
     QDoubleSpinBox _qTxtFOV;
     QLineEdit _qTxtDNear, _qTxtDFar;
     QLineEdit _qTxtDuration;
+    QLabel _qLblStats;
+    QCheckBox _qTglProfile;
+    QLabel _qLblProfile;
+    QCheckBox _qTglApiTrace;
+    QHBoxLayout _qHBoxSession;
+    QCheckBox _qTglRecSession;
+    QPushButton _qBtnReplaySession;
+    QLabel _qLblSession;
     QSpinBox _qSpinBoxResSphere;
+    QSpinBox _qSpinBoxErrorSphere;
+    QSpinBox _qSpinBoxThreads;
+    QCheckBox _qTglPinThreads;
+    QSpinBox _qSpinBoxRasterBands;
+    QSpinBox _qSpinBoxBudget;
     QLineEdit _qTxtTrisVtcs;
     QCheckBox _qTglFrontSide;
     QCheckBox _qTglBackSide;
@@ -45,19 +72,31 @@ class MainWindow: public QWidget {
     QCheckBox _qTglBlending;
     QCheckBox _qTglTexturing;
     QCheckBox _qTglLighting;
+    QHBoxLayout _qHBoxHeatmap;
+    QCheckBox _qTglHeatmap;
+    QComboBox _qCmbHeatKind;
+    QPushButton _qBtnSaveHeatmap;
     QVBoxLayout _qVBoxAmbient;
     QDoubleSpinBox _qSpinBoxAmbient;
     QSlider _qSliderAmbient;
     QCheckBox _qTglAnim;
     RenderWidget _qView3d;
     std::function<void(RenderContext&)> _cbRender;
-    uint _angle, _stepAngle;
+    float _angle, _speedAngle; // in degrees, degrees per s
+    uint _dtAnimMin; // min. time between animation frames (in ms)
     QTimer _qTimerAnim;
+    QElapsedTimer _qTimeAnim;
     uint _iImg;
+    // recorded or replayed session (accessed in render thread while active)
+    Session _session;
+    std::atomic<bool> _recSession, _replaySession;
+    std::chrono::steady_clock::time_point _tRecSession;
+    uint _iFrameSession; // replayed frame (in GUI thread)
+    std::vector<double> _dtsSession; // replay timings (in render thread)
   public:
     MainWindow(
       uint width, uint height, QWidget *pQParent = nullptr);
-    virtual ~MainWindow() = default;
+    virtual ~MainWindow();
     MainWindow(const MainWindow&) = delete;
     MainWindow& operator=(const MainWindow&) = delete;
 
@@ -76,6 +115,8 @@ class MainWindow: public QWidget {
     void cbRender(RenderContext &context);
 
     void updateCamMatWidgets();
+
+    void replaySessionFrame();
 };
 
 #endif // MAIN_WINDOW_H
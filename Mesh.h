@@ -1,11 +1,176 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 
 #include "linmath.h"
 #include "util.h"
 
+/* quantized coordinate (16 bit signed integer per component)
+ *
+ * It is decoded with the CoordQuant of its mesh.
+ */
+struct CoordQ16 {
+  std::int16_t x, y, z;
+};
+
+/* normal encoded with octahedral mapping (16 bit signed normalized
+ * integer per component)
+ *
+ * The unit sphere is projected onto the octahedron |x| + |y| + |z| = 1.
+ * Its lower half (z < 0) is folded over the upper half, i.e. the normal
+ * is given by x and y in the square [-1, 1]².
+ */
+struct NormalOct16 {
+  std::int16_t x, y;
+};
+
+/* texture coordinate (16 bit unsigned normalized integer per component)
+ *
+ * It covers [0, 1]² only, i.e. coordinates outside (e.g. of repeated
+ * textures) are clamped to the border (see quantizeMesh()).
+ */
+struct TexCoordQ16 {
+  std::uint16_t u, v;
+};
+
+// color (8 bit unsigned normalized integer per component)
+struct ColorRGBA8 {
+  std::uint8_t r, g, b, a;
+};
+
+// encodes a value in [-1, 1] as 16 bit signed normalized integer
+inline std::int16_t encodeSNorm16(float value)
+{
+  return (std::int16_t)std::lround(clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+// decodes a 16 bit signed normalized integer
+inline float decodeSNorm16(std::int16_t value)
+{
+  return value < -32767 ? -1.0f : value * (1.0f / 32767.0f);
+}
+
+// encodes a value in [0, 1] as unsigned normalized integer with n bits
+template <typename UINT, uint N = 8 * sizeof (UINT)>
+UINT encodeUNorm(float value)
+{
+  return (UINT)std::lround(clamp(value, 0.0f, 1.0f) * ((1u << N) - 1));
+}
+
+// decodes an unsigned normalized integer with n bits
+template <uint N, typename UINT>
+float decodeUNorm(UINT value)
+{
+  return value * (1.0f / ((1u << N) - 1));
+}
+
+// encodes a unit vector with octahedral mapping
+inline NormalOct16 encodeNormal(const Vec3f &normal)
+{
+  const float l1 = std::fabs(normal.x) + std::fabs(normal.y)
+    + std::fabs(normal.z);
+  if (l1 == 0.0f) return NormalOct16{ 0, 0 };
+  float x = normal.x / l1, y = normal.y / l1;
+  if (normal.z < 0.0f) { // fold lower half over upper half
+    const float x0 = x;
+    x = (1.0f - std::fabs(y)) * (x0 >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - std::fabs(x0)) * (y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return NormalOct16{ encodeSNorm16(x), encodeSNorm16(y) };
+}
+
+/* decodes attributes of vertices.
+ *
+ * The float types are returned as they are.
+ * (CoordQ16 is returned as is in float, see CoordQuant.)
+ */
+inline const Vec2f& decode(const Vec2f &value) { return value; }
+inline const Vec3f& decode(const Vec3f &value) { return value; }
+inline const Vec4f& decode(const Vec4f &value) { return value; }
+
+inline Vec3f decode(const CoordQ16 &coord)
+{
+  return Vec3f(coord.x, coord.y, coord.z);
+}
+
+inline Vec3f decode(const NormalOct16 &normal)
+{
+  float x = decodeSNorm16(normal.x), y = decodeSNorm16(normal.y);
+  const float z = 1.0f - std::fabs(x) - std::fabs(y);
+  if (z < 0.0f) { // unfold lower half
+    const float x0 = x;
+    x = (1.0f - std::fabs(y)) * (x0 >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - std::fabs(x0)) * (y >= 0.0f ? 1.0f : -1.0f);
+  }
+  const float l = std::sqrt(x * x + y * y + z * z);
+  return Vec3f(x / l, y / l, z / l);
+}
+
+inline Vec2f decode(const TexCoordQ16 &texCoord)
+{
+  return Vec2f(decodeUNorm<16>(texCoord.u), decodeUNorm<16>(texCoord.v));
+}
+
+inline Vec4f decode(const ColorRGBA8 &color)
+{
+  return Vec4f(decodeUNorm<8>(color.r), decodeUNorm<8>(color.g),
+    decodeUNorm<8>(color.b), decodeUNorm<8>(color.a));
+}
+
+/* quantization of the coordinates of a mesh:
+ * coord = offset + scale * quantized coord
+ *
+ * The default covers the cube [-1, 1]³ (e.g. for spheres).
+ */
+struct CoordQuant {
+  Vec3f scale;
+  Vec3f offset;
+
+  CoordQuant():
+    scale(1.0f / 32767.0f, 1.0f / 32767.0f, 1.0f / 32767.0f),
+    offset(Null)
+  { }
+  // quantization for the bounding box [min, max]
+  CoordQuant(const Vec3f &min, const Vec3f &max):
+    scale(
+      std::max(max.x - min.x, 1e-30f) / 65534.0f,
+      std::max(max.y - min.y, 1e-30f) / 65534.0f,
+      std::max(max.z - min.z, 1e-30f) / 65534.0f),
+    offset(0.5f * (min + max))
+  { }
+
+  CoordQ16 encode(const Vec3f &coord) const
+  {
+    return CoordQ16{
+      (std::int16_t)clamp(std::lround((coord.x - offset.x) / scale.x),
+        -32767l, 32767l),
+      (std::int16_t)clamp(std::lround((coord.y - offset.y) / scale.y),
+        -32767l, 32767l),
+      (std::int16_t)clamp(std::lround((coord.z - offset.z) / scale.z),
+        -32767l, 32767l)
+    };
+  }
+
+  Vec3f decode(const CoordQ16 &coord) const
+  {
+    return Vec3f(
+      offset.x + scale.x * coord.x, offset.y + scale.y * coord.y,
+      offset.z + scale.z * coord.z);
+  }
+
+  // returns matrix which decodes coordinates (to fuse with transformation)
+  Mat4x4f getDecodeMat() const
+  {
+    return Mat4x4f(InitTrans, offset)
+      * Mat4x4f(InitScale, scale.x, scale.y, scale.z);
+  }
+};
+
 struct VertexC {
   typedef Vec3f Coord;
   typedef void Normal;
@@ -48,19 +213,74 @@ struct VertexCNCT {
   typedef Vec4f Color;
   typedef Vec2f TexCoord;
 
+  // (color first as Vec4f is 16 byte aligned, i.e. no padding)
+  Color color;
+  Coord coord;
+  Normal normal;
+  TexCoord texCoord;
+};
+
+/* compact vertices with quantized attributes
+ * (VertexQCNT: 14 bytes instead of 32 bytes of VertexCNT)
+ */
+struct VertexQC {
+  typedef CoordQ16 Coord;
+  typedef void Normal;
+  typedef void Color;
+  typedef void TexCoord;
+
+  Coord coord;
+};
+
+struct VertexQCN {
+  typedef CoordQ16 Coord;
+  typedef NormalOct16 Normal;
+  typedef void Color;
+  typedef void TexCoord;
+
+  Coord coord;
+  Normal normal;
+};
+
+struct VertexQCNT {
+  typedef CoordQ16 Coord;
+  typedef NormalOct16 Normal;
+  typedef void Color;
+  typedef TexCoordQ16 TexCoord;
+
+  Coord coord;
+  Normal normal;
+  TexCoord texCoord;
+};
+
+struct VertexQCNCT {
+  typedef CoordQ16 Coord;
+  typedef NormalOct16 Normal;
+  typedef ColorRGBA8 Color;
+  typedef TexCoordQ16 TexCoord;
+
   Coord coord;
   Normal normal;
   Color color;
   TexCoord texCoord;
 };
 
-template <typename VERTEX>
+template <typename VERTEX, typename COORD = typename VERTEX::Coord>
 struct storeCoord {
-  storeCoord(VERTEX &vtx, const Vec3f &coord)
+  storeCoord(VERTEX &vtx, const Vec3f &coord,
+    const CoordQuant& = CoordQuant())
   {
     vtx.coord = coord;
   }
 };
+template <typename VERTEX>
+struct storeCoord<VERTEX, CoordQ16> {
+  storeCoord(VERTEX &vtx, const Vec3f &coord,
+    const CoordQuant &quant = CoordQuant())
+  {
+    vtx.coord = quant.encode(coord);
+  }
+};
 
 template <typename VERTEX, typename NORMAL = typename VERTEX::Normal>
 struct storeNormal {
@@ -70,6 +290,13 @@ struct storeNormal {
   }
 };
 template <typename VERTEX>
+struct storeNormal<VERTEX, NormalOct16> {
+  storeNormal(VERTEX &vtx, const Vec3f &normal)
+  {
+    vtx.normal = encodeNormal(normal);
+  }
+};
+template <typename VERTEX>
 struct storeNormal<VERTEX, void> {
   storeNormal(VERTEX&, const Vec3f&) { }
 };
@@ -82,6 +309,16 @@ struct storeColor {
   }
 };
 template <typename VERTEX>
+struct storeColor<VERTEX, ColorRGBA8> {
+  storeColor(VERTEX &vtx, const Vec4f &color)
+  {
+    vtx.color = ColorRGBA8{
+      encodeUNorm<std::uint8_t>(color.x), encodeUNorm<std::uint8_t>(color.y),
+      encodeUNorm<std::uint8_t>(color.z), encodeUNorm<std::uint8_t>(color.w)
+    };
+  }
+};
+template <typename VERTEX>
 struct storeColor<VERTEX, void> {
   storeColor(VERTEX&, const Vec4f&) { }
 };
@@ -94,10 +331,127 @@ struct storeTexCoord {
   }
 };
 template <typename VERTEX>
+struct storeTexCoord<VERTEX, TexCoordQ16> {
+  storeTexCoord(VERTEX &vtx, const Vec2f &texCoord)
+  {
+    vtx.texCoord = TexCoordQ16{
+      encodeUNorm<std::uint16_t>(texCoord.x),
+      encodeUNorm<std::uint16_t>(texCoord.y)
+    };
+  }
+};
+template <typename VERTEX>
 struct storeTexCoord<VERTEX, void> {
   storeTexCoord(VERTEX&, const Vec2f&) { }
 };
 
+/* loads an attribute of a vertex (decoding as needed)
+ * (nothing if the vertex has none, i.e. the value is kept)
+ */
+template <typename VERTEX, typename NORMAL = typename VERTEX::Normal>
+struct loadNormal {
+  loadNormal(const VERTEX &vtx, Vec3f &normal)
+  {
+    normal = decode(vtx.normal);
+  }
+};
+template <typename VERTEX>
+struct loadNormal<VERTEX, void> {
+  loadNormal(const VERTEX&, Vec3f&) { }
+};
+
+template <typename VERTEX, typename COLOR = typename VERTEX::Color>
+struct loadColor {
+  loadColor(const VERTEX &vtx, Vec4f &color)
+  {
+    color = decode(vtx.color);
+  }
+};
+template <typename VERTEX>
+struct loadColor<VERTEX, void> {
+  loadColor(const VERTEX&, Vec4f&) { }
+};
+
+template <typename VERTEX, typename TEXCOORD = typename VERTEX::TexCoord>
+struct loadTexCoord {
+  loadTexCoord(const VERTEX &vtx, Vec2f &texCoord)
+  {
+    texCoord = decode(vtx.texCoord);
+  }
+};
+template <typename VERTEX>
+struct loadTexCoord<VERTEX, void> {
+  loadTexCoord(const VERTEX&, Vec2f&) { }
+};
+
+/* checks whether the texture coordinate of a vertex fits into TexCoordQ16
+ * (i.e. is in [0, 1]², with a tolerance of half a quantization step)
+ * (true if the vertex has none)
+ */
+template <typename VERTEX>
+bool isTexCoordUNorm(const VERTEX &vtx)
+{
+  const float eps = 0.5f / 65535.0f;
+  Vec2f texCoord(0.5f, 0.5f); loadTexCoord<VERTEX>(vtx, texCoord);
+  return texCoord.x >= -eps && texCoord.x <= 1.0f + eps
+    && texCoord.y >= -eps && texCoord.y <= 1.0f + eps;
+}
+
+/* copies an attribute between vertices of different types
+ * (decoding and encoding as needed, nothing if the target has none)
+ */
+template <typename VERTEX, typename NORMAL = typename VERTEX::Normal>
+struct copyNormal {
+  template <typename VERTEXSRC>
+  copyNormal(VERTEX &vtx, const VERTEXSRC &vtxSrc)
+  {
+    storeNormal<VERTEX>(vtx, decode(vtxSrc.normal));
+  }
+};
+template <typename VERTEX>
+struct copyNormal<VERTEX, void> {
+  template <typename VERTEXSRC>
+  copyNormal(VERTEX&, const VERTEXSRC&) { }
+};
+
+template <typename VERTEX, typename COLOR = typename VERTEX::Color>
+struct copyColor {
+  template <typename VERTEXSRC>
+  copyColor(VERTEX &vtx, const VERTEXSRC &vtxSrc)
+  {
+    storeColor<VERTEX>(vtx, decode(vtxSrc.color));
+  }
+};
+template <typename VERTEX>
+struct copyColor<VERTEX, void> {
+  template <typename VERTEXSRC>
+  copyColor(VERTEX&, const VERTEXSRC&) { }
+};
+
+template <typename VERTEX, typename TEXCOORD = typename VERTEX::TexCoord>
+struct copyTexCoord {
+  template <typename VERTEXSRC>
+  copyTexCoord(VERTEX &vtx, const VERTEXSRC &vtxSrc)
+  {
+    storeTexCoord<VERTEX>(vtx, decode(vtxSrc.texCoord));
+  }
+};
+template <typename VERTEX>
+struct copyTexCoord<VERTEX, void> {
+  template <typename VERTEXSRC>
+  copyTexCoord(VERTEX&, const VERTEXSRC&) { }
+};
+
+/* provides the quantization of coordinates for meshes with quantized
+ * coordinates (and nothing for float coordinates)
+ */
+template <typename COORD>
+struct MeshQuantT { };
+template <>
+struct MeshQuantT<CoordQ16> {
+  CoordQuant quant;
+};
+
 /* stores a mesh of triangles.
  *
  * The mesh may be indexed or non-indexed.
@@ -107,7 +461,7 @@ struct storeTexCoord<VERTEX, void> {
  * Indexed meshes may share vertices reducing the total memory of storage.
  */
 template <typename VERTEX, typename INDEX = uint>
-struct MeshT {
+struct MeshT: MeshQuantT<typename VERTEX::Coord> {
   typedef VERTEX Vertex;
   typedef INDEX Index;
   // vertices
@@ -116,11 +470,196 @@ struct MeshT {
 };
 
 template <typename VERTEX>
-struct MeshT<VERTEX, void> {
+struct MeshT<VERTEX, void>: MeshQuantT<typename VERTEX::Coord> {
   typedef VERTEX Vertex;
   typedef void Index;
   // vertices
   std::vector<Vertex> vtcs;
 };
 
+/* tag of the vertex type of meshes with a structure of arrays
+ * (see MeshT<VertexSoA, INDEX>)
+ *
+ * The attributes are the ones of VertexCNT (but not stored per vertex).
+ */
+struct VertexSoA {
+  typedef Vec3f Coord;
+  typedef Vec3f Normal;
+  typedef void Color;
+  typedef Vec2f TexCoord;
+};
+
+/* stores a mesh of triangles as structure of arrays (SoA), i.e. with a
+ * separate array (stream) per component of the vertex attributes.
+ *
+ * This is the layout for the batch kernels transformPoints() and
+ * lightNormals() which process 8 or 16 vertices at once (with AVX2 or
+ * AVX-512).
+ * The normals and texture coordinates are optional, i.e. their streams
+ * may be left empty.
+ * The mesh may be indexed or non-indexed (as the other MeshTs).
+ */
+template <typename INDEX>
+struct MeshT<VertexSoA, INDEX> {
+  typedef VertexSoA Vertex;
+  typedef INDEX Index;
+  // coordinates of vertices
+  std::vector<float> x, y, z;
+  // normals of vertices (or empty)
+  std::vector<float> nx, ny, nz;
+  // texture coordinates of vertices (or empty)
+  std::vector<float> u, v;
+  std::vector<uint> idcs;
+
+  // returns number of vertices
+  size_t size() const { return x.size(); }
+  // returns whether the vertices provide normals
+  bool hasNormals() const { return !nx.empty(); }
+  // returns whether the vertices provide texture coordinates
+  bool hasTexCoords() const { return !u.empty(); }
+};
+
+typedef MeshT<VertexSoA> MeshSoA;
+
+// returns number of triangles of a mesh (indexed or non-indexed)
+template <typename VERTEX, typename INDEX>
+size_t getNTris(const MeshT<VERTEX, INDEX> &mesh)
+{
+  return (mesh.idcs.empty() ? mesh.vtcs.size() : mesh.idcs.size()) / 3;
+}
+
+// returns number of triangles of a non-indexed mesh
+template <typename VERTEX>
+size_t getNTris(const MeshT<VERTEX, void> &mesh)
+{
+  return mesh.vtcs.size() / 3;
+}
+
+// returns number of triangles of a mesh with a structure of arrays
+template <typename INDEX>
+size_t getNTris(const MeshT<VertexSoA, INDEX> &mesh)
+{
+  return (mesh.idcs.empty() ? mesh.size() : mesh.idcs.size()) / 3;
+}
+
+// returns index of i-th vertex of triangles of a mesh with a structure of
+// arrays
+template <typename INDEX>
+size_t getTriVtxIdx(const MeshT<VertexSoA, INDEX> &mesh, size_t i)
+{
+  return mesh.idcs.empty() ? i : mesh.idcs[i];
+}
+
+// returns i-th vertex of triangles of a mesh (indexed or non-indexed)
+template <typename VERTEX, typename INDEX>
+const VERTEX& getTriVtx(const MeshT<VERTEX, INDEX> &mesh, size_t i)
+{
+  return mesh.vtcs[mesh.idcs.empty() ? i : mesh.idcs[i]];
+}
+
+// returns i-th vertex of triangles of a non-indexed mesh
+template <typename VERTEX>
+const VERTEX& getTriVtx(const MeshT<VERTEX, void> &mesh, size_t i)
+{
+  return mesh.vtcs[i];
+}
+
+// returns coordinate of a vertex of a mesh with float coordinates
+inline const Vec3f& decodeCoord(const MeshQuantT<Vec3f>&, const Vec3f &coord)
+{
+  return coord;
+}
+
+// returns decoded coordinate of a vertex of a mesh
+inline Vec3f decodeCoord(
+  const MeshQuantT<CoordQ16> &mesh, const CoordQ16 &coord)
+{
+  return mesh.quant.decode(coord);
+}
+
+// returns a transformation for a mesh with float coordinates
+inline const Mat4x4f& fuseCoordDecode(
+  const Mat4x4f &mat, const MeshQuantT<Vec3f>&)
+{
+  return mat;
+}
+
+/* returns a transformation combined with the decoding of the coordinates
+ * of a mesh (to transform the quantized coordinates as they are)
+ */
+inline Mat4x4f fuseCoordDecode(
+  const Mat4x4f &mat, const MeshQuantT<CoordQ16> &mesh)
+{
+  return mat * mesh.quant.getDecodeMat();
+}
+
+/* converts an indexed mesh of float coordinates to a mesh of quantized
+ * coordinates (with the quantization fitted to the bounding box).
+ *
+ * The attributes are decoded and encoded as needed.
+ * Texture coordinates stored as TexCoordQ16 have to be in [0, 1]²
+ * (asserted) as there is no quantization range for them.
+ */
+template <typename VERTEX, typename INDEX, typename VERTEXSRC>
+void quantizeMesh(
+  const MeshT<VERTEXSRC, INDEX> &meshSrc, MeshT<VERTEX, INDEX> &mesh)
+{
+  Vec3f min(Null), max(Null);
+  if (!meshSrc.vtcs.empty()) min = max = meshSrc.vtcs[0].coord;
+  for (const VERTEXSRC &vtxSrc : meshSrc.vtcs) {
+    const Vec3f &coord = vtxSrc.coord;
+    min = Vec3f(std::min(min.x, coord.x), std::min(min.y, coord.y),
+      std::min(min.z, coord.z));
+    max = Vec3f(std::max(max.x, coord.x), std::max(max.y, coord.y),
+      std::max(max.z, coord.z));
+  }
+  mesh.quant = CoordQuant(min, max);
+  mesh.vtcs.resize(meshSrc.vtcs.size());
+  for (size_t i = 0; i < mesh.vtcs.size(); ++i) {
+    const VERTEXSRC &vtxSrc = meshSrc.vtcs[i];
+    VERTEX &vtx = mesh.vtcs[i];
+    assert((!std::is_same<typename VERTEX::TexCoord, TexCoordQ16>::value
+      || isTexCoordUNorm(vtxSrc)));
+    storeCoord<VERTEX>(vtx, vtxSrc.coord, mesh.quant);
+    copyNormal<VERTEX>(vtx, vtxSrc);
+    copyColor<VERTEX>(vtx, vtxSrc);
+    copyTexCoord<VERTEX>(vtx, vtxSrc);
+  }
+  mesh.idcs = meshSrc.idcs;
+}
+
+/* converts a mesh to a mesh with a structure of arrays.
+ *
+ * Quantized attributes are decoded.
+ * The streams of normals and texture coordinates are filled only if the
+ * source vertices provide them. Colors are dropped (as there are no
+ * streams for them).
+ */
+template <typename VERTEX, typename INDEX>
+void convertToSoA(
+  const MeshT<VERTEX, INDEX> &meshSrc, MeshT<VertexSoA, INDEX> &mesh)
+{
+  const bool normals = !std::is_void<typename VERTEX::Normal>::value;
+  const bool texCoords = !std::is_void<typename VERTEX::TexCoord>::value;
+  const size_t n = meshSrc.vtcs.size();
+  mesh.x.resize(n); mesh.y.resize(n); mesh.z.resize(n);
+  mesh.nx.resize(normals ? n : 0); mesh.ny.resize(normals ? n : 0);
+  mesh.nz.resize(normals ? n : 0);
+  mesh.u.resize(texCoords ? n : 0); mesh.v.resize(texCoords ? n : 0);
+  for (size_t i = 0; i < n; ++i) {
+    const VERTEX &vtx = meshSrc.vtcs[i];
+    const Vec3f coord = decodeCoord(meshSrc, vtx.coord);
+    mesh.x[i] = coord.x; mesh.y[i] = coord.y; mesh.z[i] = coord.z;
+    if (normals) {
+      Vec3f normal(Null); loadNormal<VERTEX>(vtx, normal);
+      mesh.nx[i] = normal.x; mesh.ny[i] = normal.y; mesh.nz[i] = normal.z;
+    }
+    if (texCoords) {
+      Vec2f texCoord(Null); loadTexCoord<VERTEX>(vtx, texCoord);
+      mesh.u[i] = texCoord.x; mesh.v[i] = texCoord.y;
+    }
+  }
+  mesh.idcs = meshSrc.idcs;
+}
+
 #endif // MESH_H
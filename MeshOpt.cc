@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "MeshOpt.h"
+
+namespace {
+
+// max. size of cache for optimizeVertexCache()
+const uint CacheSizeMax = 64;
+
+// marker for "no index"
+const uint None = (uint)-1;
+
+/* returns the score of a vertex (see optimizeVertexCache()).
+ *
+ * posCache ... position in LRU cache (-1 ... not in cache)
+ * nTrisLeft ... number of triangles left which use the vertex
+ * cacheSize ... number of entries of cache
+ */
+float getVtxScore(int posCache, uint nTrisLeft, uint cacheSize)
+{
+  if (!nTrisLeft) return -1.0f; // vertex not used anymore
+  float score = 0.0f;
+  if (posCache >= 0) {
+    // The vertices of the last triangle get a fixed score.
+    // (Otherwise, the next triangle would be chosen to reuse 2 of them
+    // which results in strips instead of fans.)
+    score = posCache < 3
+      ? 0.75f
+      : std::pow(1.0f - (float)(posCache - 3) / (cacheSize - 3), 1.5f);
+  }
+  // bonus for few triangles left (to finish vertices early)
+  return score + 2.0f / std::sqrt((float)nTrisLeft);
+}
+
+// simulates a FIFO cache of transformed vertices
+struct CacheFIFO {
+  uint size; // number of entries
+  std::vector<size_t> stamps; // time stamp of vertices put into cache
+  size_t time; // current time (incremented with every cache miss)
+
+  CacheFIFO(size_t nVtcs, uint size):
+    size(size), stamps(nVtcs, 0), time(size + 1)
+  { }
+
+  // empties the cache
+  void reset() { time += size + 1; }
+
+  // returns number of cache misses for a triangle (and updates cache)
+  uint add(const uint *idcs)
+  {
+    uint nMisses = 0;
+    for (uint i = 0; i < 3; ++i) {
+      size_t &stamp = stamps[idcs[i]];
+      if (time - stamp > size) { stamp = time++; ++nMisses; }
+    }
+    return nMisses;
+  }
+};
+
+} // namespace
+
+float getACMR(const std::vector<uint> &idcs, size_t nVtcs, uint cacheSize)
+{
+  const size_t nTris = idcs.size() / 3;
+  if (!nTris) return 0.0f;
+  CacheFIFO cache(nVtcs, cacheSize);
+  size_t nMisses = 0;
+  for (size_t i = 0; i < nTris; ++i) nMisses += cache.add(&idcs[3 * i]);
+  return (float)nMisses / nTris;
+}
+
+void optimizeVertexCache(
+  std::vector<uint> &idcs, size_t nVtcs, uint cacheSize)
+{
+  const size_t nTris = idcs.size() / 3;
+  if (!nTris) return;
+  cacheSize = clamp(cacheSize, 4u, CacheSizeMax);
+  // triangles per vertex (in one array with a range per vertex where
+  // the triangles left are kept in front)
+  std::vector<uint> nTrisLeft(nVtcs, 0);
+  for (uint i : idcs) ++nTrisLeft[i];
+  std::vector<size_t> iTrisVtx(nVtcs + 1, 0);
+  for (size_t i = 0; i < nVtcs; ++i) {
+    iTrisVtx[i + 1] = iTrisVtx[i] + nTrisLeft[i];
+  }
+  std::vector<uint> trisVtx(idcs.size());
+  { std::vector<size_t> iTrisFill(iTrisVtx.begin(), iTrisVtx.end() - 1);
+    for (size_t i = 0; i < idcs.size(); ++i) {
+      trisVtx[iTrisFill[idcs[i]]++] = (uint)(i / 3);
+    }
+  }
+  // initial scores
+  std::vector<int> posCache(nVtcs, -1);
+  std::vector<float> scoresVtx(nVtcs);
+  for (size_t i = 0; i < nVtcs; ++i) {
+    scoresVtx[i] = getVtxScore(-1, nTrisLeft[i], cacheSize);
+  }
+  std::vector<float> scoresTri(nTris);
+  for (size_t i = 0; i < nTris; ++i) {
+    scoresTri[i] = scoresVtx[idcs[3 * i + 0]] + scoresVtx[idcs[3 * i + 1]]
+      + scoresVtx[idcs[3 * i + 2]];
+  }
+  std::vector<bool> done(nTris, false);
+  uint iTriBest
+    = (uint)(std::max_element(scoresTri.begin(), scoresTri.end())
+      - scoresTri.begin());
+  size_t iTriNext = 0; // to find a new start if no candidate is left
+  // LRU cache (with room for the vertices of one more triangle)
+  uint cache[CacheSizeMax + 3], cacheNew[CacheSizeMax + 3];
+  uint nCache = 0;
+  std::vector<uint> idcsNew; idcsNew.reserve(idcs.size());
+  for (size_t n = 0; n < nTris; ++n) {
+    if (iTriBest == None) { // no candidate in cache: take next one left
+      while (done[iTriNext]) ++iTriNext;
+      iTriBest = (uint)iTriNext;
+    }
+    // emit triangle
+    const uint *const tri = &idcs[3 * iTriBest];
+    done[iTriBest] = true;
+    idcsNew.insert(idcsNew.end(), tri, tri + 3);
+    // remove triangle from its vertices
+    for (uint i = 0; i < 3; ++i) {
+      const uint iVtx = tri[i];
+      uint *const tris = &trisVtx[iTrisVtx[iVtx]];
+      uint &nLeft = nTrisLeft[iVtx];
+      std::swap(*std::find(tris, tris + nLeft, iTriBest), tris[nLeft - 1]);
+      --nLeft;
+    }
+    // put vertices of triangle in front of cache
+    uint nCacheNew = 0;
+    for (uint i = 0; i < 3; ++i) cacheNew[nCacheNew++] = tri[i];
+    for (uint i = 0; i < nCache; ++i) {
+      const uint iVtx = cache[i];
+      if (iVtx != tri[0] && iVtx != tri[1] && iVtx != tri[2]) {
+        cacheNew[nCacheNew++] = iVtx;
+      }
+    }
+    // update scores of vertices (in cache and dropped)
+    for (uint i = 0; i < nCacheNew; ++i) {
+      const uint iVtx = cacheNew[i];
+      posCache[iVtx] = i < cacheSize ? (int)i : -1;
+      scoresVtx[iVtx]
+        = getVtxScore(posCache[iVtx], nTrisLeft[iVtx], cacheSize);
+    }
+    nCache = std::min(nCacheNew, cacheSize);
+    std::copy(cacheNew, cacheNew + nCache, cache);
+    // update scores of triangles left of cached vertices and find best
+    iTriBest = None; float scoreBest = -1.0f;
+    for (uint i = 0; i < nCache; ++i) {
+      const uint iVtx = cache[i];
+      const uint *const tris = &trisVtx[iTrisVtx[iVtx]];
+      for (uint j = 0; j < nTrisLeft[iVtx]; ++j) {
+        const uint iTri = tris[j];
+        const float score = scoresVtx[idcs[3 * iTri + 0]]
+          + scoresVtx[idcs[3 * iTri + 1]] + scoresVtx[idcs[3 * iTri + 2]];
+        scoresTri[iTri] = score;
+        if (score > scoreBest) { scoreBest = score; iTriBest = iTri; }
+      }
+    }
+  }
+  idcs.swap(idcsNew);
+}
+
+void optimizeOverdraw(
+  std::vector<uint> &idcs, const std::vector<Vec3f> &coords,
+  uint cacheSize, float threshold)
+{
+  const size_t nTris = idcs.size() / 3;
+  if (!nTris) return;
+  // hard boundaries of clusters: where all vertices miss the cache
+  std::vector<size_t> iTrisHard;
+  { CacheFIFO cache(coords.size(), cacheSize);
+    for (size_t i = 0; i < nTris; ++i) {
+      if (cache.add(&idcs[3 * i]) == 3) iTrisHard.push_back(i);
+    }
+    iTrisHard.push_back(nTris);
+  }
+  // soft boundaries of clusters: where the ACMR of a split cluster is
+  // near to the ACMR of the whole cluster
+  std::vector<size_t> iTrisCluster;
+  { CacheFIFO cache(coords.size(), cacheSize);
+    for (size_t i = 0; i + 1 < iTrisHard.size(); ++i) {
+      const size_t iTri0 = iTrisHard[i], iTri1 = iTrisHard[i + 1];
+      cache.reset();
+      size_t nMisses = 0;
+      for (size_t iTri = iTri0; iTri < iTri1; ++iTri) {
+        nMisses += cache.add(&idcs[3 * iTri]);
+      }
+      const float acmrMax = threshold * nMisses / (iTri1 - iTri0);
+      cache.reset();
+      iTrisCluster.push_back(iTri0);
+      nMisses = 0;
+      for (size_t iTri = iTri0, n = 1; iTri < iTri1; ++iTri, ++n) {
+        nMisses += cache.add(&idcs[3 * iTri]);
+        if (iTri + 1 < iTri1 && nMisses <= acmrMax * n) {
+          iTrisCluster.push_back(iTri + 1);
+          cache.reset(); nMisses = 0; n = 0;
+        }
+      }
+    }
+    iTrisCluster.push_back(nTris);
+  }
+  // sort key of clusters: how much they face outwards from the center
+  const size_t nClusters = iTrisCluster.size() - 1;
+  std::vector<Vec3f> normals(nClusters, Vec3f(Null));
+  std::vector<Vec3f> centers(nClusters, Vec3f(Null));
+  std::vector<float> areas(nClusters, 0.0f);
+  Vec3f center(Null); float area = 0.0f;
+  for (size_t i = 0; i < nClusters; ++i) {
+    for (size_t iTri = iTrisCluster[i]; iTri < iTrisCluster[i + 1]; ++iTri) {
+      const Vec3f &p0 = coords[idcs[3 * iTri + 0]];
+      const Vec3f &p1 = coords[idcs[3 * iTri + 1]];
+      const Vec3f &p2 = coords[idcs[3 * iTri + 2]];
+      const Vec3f normal = cross(p1 - p0, p2 - p0); // length: 2 * area
+      const float areaTri = length(normal);
+      normals[i] = normals[i] + normal;
+      centers[i] = centers[i] + areaTri / 3.0f * (p0 + p1 + p2);
+      areas[i] += areaTri;
+    }
+    center = center + centers[i]; area += areas[i];
+  }
+  if (area > 0.0f) center = (1.0f / area) * center;
+  std::vector<float> keys(nClusters);
+  for (size_t i = 0; i < nClusters; ++i) {
+    const Vec3f centerCluster
+      = areas[i] > 0.0f ? (1.0f / areas[i]) * centers[i] : center;
+    keys[i] = dot(centerCluster - center, normalize(normals[i], NoThrow));
+  }
+  std::vector<uint> order(nClusters);
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(),
+    [&](uint i1, uint i2) { return keys[i1] > keys[i2]; });
+  // re-order triangles
+  std::vector<uint> idcsNew; idcsNew.reserve(idcs.size());
+  for (uint i : order) {
+    idcsNew.insert(idcsNew.end(), idcs.begin() + 3 * iTrisCluster[i],
+      idcs.begin() + 3 * iTrisCluster[i + 1]);
+  }
+  idcs.swap(idcsNew);
+}
+
+std::vector<uint> optimizeVertexFetch(std::vector<uint> &idcs, size_t nVtcs)
+{
+  std::vector<uint> remap(nVtcs, None);
+  std::vector<uint> order; order.reserve(nVtcs);
+  for (uint &i : idcs) {
+    if (remap[i] == None) {
+      remap[i] = (uint)order.size(); order.push_back(i);
+    }
+    i = remap[i];
+  }
+  // unused vertices
+  for (size_t i = 0; i < nVtcs; ++i) {
+    if (remap[i] == None) order.push_back((uint)i);
+  }
+  return order;
+}
@@ -0,0 +1,108 @@
+/** @file
+ * functions to optimize the order of triangles and vertices of meshes
+ */
+
+#ifndef MESH_OPT_H
+#define MESH_OPT_H
+
+// standard C++ header:
+#include <vector>
+
+// own header:
+#include "linmath.h"
+#include "Mesh.h"
+#include "util.h"
+
+/* The optimizations work on indexed meshes and change only the order of
+ * triangles (keeping the order of vertices in each triangle) and the
+ * order of vertices. The triangles themselves are not changed.
+ *
+ * Typical use (as in optimizeMesh()):
+ * 1. optimizeVertexCache() ... orders triangles to reuse transformed
+ *    vertices (of a post-transform cache)
+ * 2. optimizeOverdraw() ... orders clusters of triangles which face
+ *    outwards first to reject more fragments by depth test
+ * 3. optimizeVertexFetch() ... orders vertices by their first use
+ */
+
+/** returns the average cache miss ratio (ACMR) of indices.
+ *
+ * A FIFO cache of transformed vertices is simulated.
+ * The ACMR is the number of cache misses per triangle
+ * (3 ... no reuse at all, approx. 0.5 ... optimal for large meshes).
+ *
+ * @param idcs the indices (3 per triangle)
+ * @param nVtcs number of vertices
+ * @param cacheSize number of entries of simulated cache
+ * @return cache misses per triangle
+ */
+float getACMR(const std::vector<uint> &idcs, size_t nVtcs, uint cacheSize);
+
+/** orders triangles for locality in a post-transform vertex cache.
+ *
+ * This is the algorithm of T. Forsyth ("Linear-Speed Vertex Cache
+ * Optimisation"): The next triangle is the one with the highest score
+ * of its vertices where vertices score for being recently used and for
+ * having few triangles left.
+ *
+ * @param idcs the indices (3 per triangle) to re-order
+ * @param nVtcs number of vertices
+ * @param cacheSize number of entries of the cache to optimize for
+ */
+void optimizeVertexCache(
+  std::vector<uint> &idcs, size_t nVtcs, uint cacheSize = 16);
+
+/** orders clusters of triangles to reduce overdraw.
+ *
+ * This follows "Tipsify" (P. Sander et al., "Fast Triangle Reordering
+ * for Vertex Locality and Reduced Overdraw"): The triangles (ordered
+ * for the vertex cache before) are split into clusters where the cache
+ * is flushed anyway or where the ACMR doesn't suffer much
+ * (@a threshold). Clusters are sorted by how much they face outwards
+ * from the center of the mesh. Thus, for mostly convex meshes, near
+ * triangles tend to be rendered before far ones from any view.
+ *
+ * @param idcs the indices (3 per triangle) to re-order
+ * @param coords coordinates of vertices
+ * @param cacheSize number of entries of the cache to optimize for
+ * @param threshold max. ratio of ACMR after splitting into clusters
+ */
+void optimizeOverdraw(
+  std::vector<uint> &idcs, const std::vector<Vec3f> &coords,
+  uint cacheSize = 16, float threshold = 1.05f);
+
+/** computes an order of vertices by their first use in indices.
+ *
+ * The indices are re-mapped to the new order.
+ * Unused vertices are moved to the end.
+ *
+ * @param idcs the indices to re-map
+ * @param nVtcs number of vertices
+ * @return old index for each new index of vertex
+ */
+std::vector<uint> optimizeVertexFetch(std::vector<uint> &idcs, size_t nVtcs);
+
+/** optimizes the order of triangles and vertices of an indexed mesh
+ * (for vertex cache, overdraw, and vertex fetch).
+ *
+ * @param mesh the indexed mesh to optimize
+ * @param cacheSize number of entries of the cache to optimize for
+ */
+template <typename VERTEX, typename INDEX>
+void optimizeMesh(MeshT<VERTEX, INDEX> &mesh, uint cacheSize = 16)
+{
+  if (mesh.idcs.empty()) return; // not indexed
+  optimizeVertexCache(mesh.idcs, mesh.vtcs.size(), cacheSize);
+  std::vector<Vec3f> coords(mesh.vtcs.size());
+  for (size_t i = 0; i < coords.size(); ++i) {
+    coords[i] = mesh.vtcs[i].coord;
+  }
+  optimizeOverdraw(mesh.idcs, coords, cacheSize);
+  const std::vector<uint> order
+    = optimizeVertexFetch(mesh.idcs, mesh.vtcs.size());
+  std::vector<VERTEX> vtcs; vtcs.reserve(order.size());
+  for (uint i : order) vtcs.push_back(mesh.vtcs[i]);
+  mesh.vtcs.swap(vtcs);
+}
+
+#endif // MESH_OPT_H
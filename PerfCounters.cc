@@ -0,0 +1,178 @@
+#include <cerrno>
+#include <cstring>
+
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+
+// group of counters of one thread (opened on first use)
+class Group {
+  private:
+    // file descriptors of counters (-1 ... not supported)
+    int _fds[PerfCounters::NCounters];
+    // file descriptor of group leader (-1 ... not available)
+    int _fdLeader;
+    // number of opened counters
+    uint _n;
+    // counters in order of opening (which is the order in read buffer)
+    uint _iCounters[PerfCounters::NCounters];
+    // error message (if not available)
+    std::string _error;
+
+  public:
+    Group();
+    ~Group();
+    Group(const Group&) = delete;
+    Group& operator=(const Group&) = delete;
+
+    bool isAvailable() const { return _fdLeader >= 0; }
+
+    const std::string& getError() const { return _error; }
+
+    bool isSupported(uint i) const { return _fds[i] >= 0; }
+
+    bool read(PerfCounters::Values &values) const;
+};
+
+// opens one counter
+int openCounter(uint32_t type, uint64_t config, int fdLeader)
+{
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = type; attr.config = config;
+  attr.exclude_kernel = 1; attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP
+    | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, fdLeader, 0);
+}
+
+Group::Group(): _fdLeader(-1), _n(0)
+{
+  static const struct { uint32_t type; uint64_t config; } events[] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_DTLB
+      | PERF_COUNT_HW_CACHE_OP_READ << 8
+      | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 }
+  };
+  static_assert(
+    sizeof events / sizeof *events == PerfCounters::NCounters,
+    "events don't match PerfCounters::Counter");
+  for (uint i = 0; i < PerfCounters::NCounters; ++i) {
+    const int fd = openCounter(events[i].type, events[i].config, _fdLeader);
+    _fds[i] = fd;
+    if (fd < 0) {
+      if (_error.empty()) {
+        _error = std::string("perf_event_open(")
+          + PerfCounters::getName((PerfCounters::Counter)i) + "): "
+          + std::strerror(errno);
+      }
+      continue;
+    }
+    if (_fdLeader < 0) _fdLeader = fd;
+    _iCounters[_n++] = i;
+  }
+  if (_fdLeader >= 0) _error.clear();
+}
+
+Group::~Group()
+{
+  for (int fd : _fds) if (fd >= 0) close(fd);
+}
+
+bool Group::read(PerfCounters::Values &values) const
+{
+  if (_fdLeader < 0) return false;
+  // layout: nr, time_enabled, time_running, value[nr]
+  uint64_t buffer[3 + PerfCounters::NCounters];
+  const ssize_t size = ::read(_fdLeader, buffer, sizeof buffer);
+  if (size < (ssize_t)(3 * sizeof (uint64_t)) || buffer[0] != _n) {
+    return false;
+  }
+  values.tEnabled = buffer[1]; values.tRunning = buffer[2];
+  for (uint64_t &value : values.values) value = 0;
+  for (uint i = 0; i < _n; ++i) values.values[_iCounters[i]] = buffer[3 + i];
+  return true;
+}
+
+// the group of counters of the current thread
+Group& getGroup()
+{
+  thread_local Group group;
+  return group;
+}
+
+#endif // __linux__
+
+} // namespace
+
+const char* PerfCounters::getName(Counter counter)
+{
+  switch (counter) {
+    case Cycles: return "cycles";
+    case Instructions: return "instructions";
+    case CacheMisses: return "cache-misses";
+    case BranchMisses: return "branch-misses";
+    case TLBMisses: return "dTLB-misses";
+    default: return "";
+  }
+}
+
+bool PerfCounters::isAvailable(std::string *pError)
+{
+#if defined(__linux__)
+  const Group &group = getGroup();
+  if (pError) *pError = group.getError();
+  return group.isAvailable();
+#else // not supported
+  if (pError) *pError = "Performance counters not supported on this OS.";
+  return false;
+#endif // __linux__
+}
+
+bool PerfCounters::isSupported(Counter counter)
+{
+#if defined(__linux__)
+  return getGroup().isSupported(counter);
+#else // not supported
+  (void)counter;
+  return false;
+#endif // __linux__
+}
+
+bool PerfCounters::read(Values &values)
+{
+#if defined(__linux__)
+  return getGroup().read(values);
+#else // not supported
+  (void)values;
+  return false;
+#endif // __linux__
+}
+
+bool PerfCounters::diff(
+  const Values &values0, const Values &values1, Values &delta)
+{
+  delta.tEnabled = values1.tEnabled - values0.tEnabled;
+  delta.tRunning = values1.tRunning - values0.tRunning;
+  if (!delta.tRunning) return false;
+  const double scale = delta.tEnabled > delta.tRunning
+    ? (double)delta.tEnabled / delta.tRunning : 1.0;
+  for (uint i = 0; i < NCounters; ++i) {
+    const uint64_t value = values1.values[i] - values0.values[i];
+    delta.values[i] = scale > 1.0 ? (uint64_t)(value * scale) : value;
+  }
+  return true;
+}
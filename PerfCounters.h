@@ -0,0 +1,97 @@
+/** @file
+ * interface of class PerfCounters
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// standard C++ header:
+#include <cstdint>
+#include <string>
+
+// own header:
+#include "util.h"
+
+/** provides access to hardware performance counters of calling thread.
+ *
+ * On Linux, a group of counters is opened per thread with
+ * perf_event_open() on first use (user space only).
+ * The counters of a group are read atomically with one system call.
+ *
+ * If the counters are not available (e.g. other OS, missing permission
+ * due to perf_event_paranoid, or a VM without PMU), read() simply fails.
+ * Single counters which are not supported are reported as 0
+ * (see isSupported()).
+ */
+class PerfCounters {
+
+  // types:
+  public:
+    /// hardware counters
+    enum Counter {
+      Cycles, ///< CPU cycles
+      Instructions, ///< retired instructions
+      CacheMisses, ///< last level cache misses
+      BranchMisses, ///< mispredicted branches
+      TLBMisses, ///< data TLB read misses
+      NCounters ///< number of counters
+    };
+
+    /// values of counters
+    struct Values {
+      uint64_t values[NCounters]; ///< values of counters
+      uint64_t tEnabled; ///< time the group was enabled (in ns)
+      uint64_t tRunning; ///< time the group was counting (in ns)
+    };
+
+  // methods:
+  public:
+    PerfCounters() = delete;
+
+    /** returns name of a counter.
+     *
+     * @param counter the counter
+     * @return name of counter
+     */
+    static const char* getName(Counter counter);
+
+    /** checks whether the counters are available in calling thread.
+     *
+     * @param pError storage for an error message (or nullptr)
+     * @return true ... counters available\n
+     *         false ... otherwise
+     */
+    static bool isAvailable(std::string *pError = nullptr);
+
+    /** checks whether a certain counter is supported in calling thread.
+     *
+     * @param counter the counter
+     * @return true ... counter supported\n
+     *         false ... otherwise (reported as 0)
+     */
+    static bool isSupported(Counter counter);
+
+    /** reads the counters of calling thread.
+     *
+     * @param values storage for values
+     * @return true ... values read\n
+     *         false ... counters not available
+     */
+    static bool read(Values &values);
+
+    /** computes the difference of counter values.
+     *
+     * If the counters were multiplexed with other events, the differences
+     * are scaled by the ratio of enabled to running time.
+     *
+     * @param values0 values at start
+     * @param values1 values at end
+     * @param delta storage for differences
+     * @return true ... differences computed\n
+     *         false ... group was not counting in between
+     */
+    static bool diff(
+      const Values &values0, const Values &values1, Values &delta);
+};
+
+#endif // PERF_COUNTERS_H
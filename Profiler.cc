@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "Profiler.h"
+
+namespace {
+
+// converts a duration to ns
+uint64_t toNS(Profiler::Clock::duration dt)
+{
+  const int64_t ns
+    = std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count();
+  return ns > 0 ? (uint64_t)ns : 0;
+}
+
+// resets accumulated hardware counters
+template <typename PERF_SUMS>
+void resetPerf(PERF_SUMS &perfSums)
+{
+  for (std::atomic<uint64_t> &value : perfSums.values) value = 0;
+}
+
+// formats a time in ns as µs (as expected in Chrome trace)
+std::string toUS(uint64_t ns)
+{
+  char buffer[32];
+  std::snprintf(buffer, sizeof buffer, "%llu.%03u",
+    (unsigned long long)(ns / 1000), (uint)(ns % 1000));
+  return buffer;
+}
+
+} // namespace
+
+Profiler::Profiler():
+  _enabled(false), _perf(false), _tracing(false), _nEventsMax(0)
+{
+  for (std::atomic<uint64_t> &sum : _sumsFrame) sum = 0;
+  reset();
+}
+
+const char* Profiler::getName(Stage stage)
+{
+  switch (stage) {
+    case Frame: return "Frame";
+    case Clear: return "Clear";
+    case RasterJob: return "RasterJob";
+    case Finish: return "Finish";
+    case Present: return "Present";
+    case Transform: return "Transform";
+    case Clip: return "Clip";
+    case Setup: return "Setup";
+    case Raster: return "Raster";
+    default: return "";
+  }
+}
+
+void Profiler::reset()
+{
+  for (Histogram &histo : _histos) histo.reset();
+  for (PerfSums &perfSums : _perfStages) resetPerf(perfSums);
+  for (PerfSums &perfSums : _perfCombos) resetPerf(perfSums);
+  resetPerf(_perfFrame); resetPerf(_perfFrameLast);
+}
+
+bool Profiler::enablePerf(bool enable, std::string *pError)
+{
+  if (pError) pError->clear();
+  if (enable && !PerfCounters::isAvailable(pError)) enable = false;
+  _perf = enable;
+  return enable;
+}
+
+void Profiler::addPerf(
+  Stage stage, uint combo,
+  const PerfCounters::Values &values0, const PerfCounters::Values &values1)
+{
+  PerfCounters::Values delta;
+  if (!PerfCounters::diff(values0, values1, delta)) return;
+  for (uint i = 0; i < PerfCounters::NCounters; ++i) {
+    const uint64_t value = delta.values[i];
+    _perfStages[stage].values[i].fetch_add(value, std::memory_order_relaxed);
+    if (combo < NCombos) {
+      _perfCombos[combo].values[i]
+        .fetch_add(value, std::memory_order_relaxed);
+    }
+    if (stage == Frame) {
+      _perfFrame.values[i].fetch_add(value, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Profiler::add(
+  Stage stage, Clock::time_point tStart, Clock::time_point tEnd)
+{
+  const uint64_t dt = toNS(tEnd - tStart);
+  _histos[stage].add(dt);
+  if (stage >= Transform) {
+    _sumsFrame[stage - Transform].fetch_add(dt, std::memory_order_relaxed);
+    return;
+  }
+  if (!_tracing.load(std::memory_order_relaxed)) return;
+  std::lock_guard<std::mutex> lock(_lockTrace);
+  if (!_tracing || _events.size() >= _nEventsMax) return;
+  Event event;
+  event.t = toNS(tStart - _tStartTrace); event.dt = dt;
+  event.stage = stage; event.tid = getTid();
+  _events.push_back(event);
+}
+
+void Profiler::endFrame()
+{
+  Event event, eventPerf;
+  for (uint i = 0; i < NStages - Transform; ++i) {
+    event.sums[i] = _sumsFrame[i].exchange(0, std::memory_order_relaxed);
+  }
+  for (uint i = 0; i < PerfCounters::NCounters; ++i) {
+    eventPerf.perf[i] = _perfFrame.values[i].exchange(0);
+    _perfFrameLast.values[i] = eventPerf.perf[i];
+  }
+  if (!_tracing.load(std::memory_order_relaxed)) return;
+  std::lock_guard<std::mutex> lock(_lockTrace);
+  if (!_tracing || _events.size() + 1 >= _nEventsMax) return;
+  event.t = toNS(Clock::now() - _tStartTrace); event.dt = 0;
+  event.stage = NStages; event.tid = getTid();
+  _events.push_back(event);
+  if (!isPerfEnabled()) return;
+  eventPerf.t = event.t; eventPerf.dt = 0;
+  eventPerf.stage = NStages + 1; eventPerf.tid = event.tid;
+  _events.push_back(eventPerf);
+}
+
+void Profiler::startTrace(size_t nEventsMax)
+{
+  std::lock_guard<std::mutex> lock(_lockTrace);
+  _events.clear(); _tids.clear();
+  _events.reserve(std::min(nEventsMax, (size_t)1 << 16));
+  _nEventsMax = nEventsMax;
+  _tStartTrace = Clock::now();
+  _tracing = true;
+}
+
+bool Profiler::writeTrace(const std::string &file) const
+{
+  std::ofstream fOut(file);
+  if (!fOut) return false;
+  std::lock_guard<std::mutex> lock(_lockTrace);
+  fOut << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  fOut << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+    "\"args\":{\"name\":\"noGL3d\"}}";
+  for (uint tid = 0; tid < _tids.size(); ++tid) {
+    fOut << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+      << "\"tid\":" << tid << ",\"args\":{\"name\":\"Thread " << tid
+      << "\"}}";
+  }
+  for (const Event &event : _events) {
+    fOut << ",\n";
+    if (event.stage < NStages) {
+      fOut << "{\"name\":\"" << getName((Stage)event.stage) << "\","
+        << "\"cat\":\"render\",\"ph\":\"X\",\"pid\":1,"
+        << "\"tid\":" << event.tid << ","
+        << "\"ts\":" << toUS(event.t) << ",\"dur\":" << toUS(event.dt)
+        << "}";
+    } else if (event.stage == NStages) {
+      fOut << "{\"name\":\"Stages\",\"cat\":\"render\",\"ph\":\"C\","
+        << "\"pid\":1,\"tid\":" << event.tid << ","
+        << "\"ts\":" << toUS(event.t) << ",\"args\":{";
+      for (uint i = 0; i < NStages - Transform; ++i) {
+        fOut << (i ? "," : "")
+          << "\"" << getName((Stage)(Transform + i)) << " (us)\":"
+          << toUS(event.sums[i]);
+      }
+      fOut << "}}";
+    } else {
+      fOut << "{\"name\":\"HW Counters\",\"cat\":\"render\",\"ph\":\"C\","
+        << "\"pid\":1,\"tid\":" << event.tid << ","
+        << "\"ts\":" << toUS(event.t) << ",\"args\":{";
+      for (uint i = 0; i < PerfCounters::NCounters; ++i) {
+        fOut << (i ? "," : "")
+          << "\"" << PerfCounters::getName((PerfCounters::Counter)i)
+          << "\":" << event.perf[i];
+      }
+      fOut << "}}";
+    }
+  }
+  fOut << "\n]}\n";
+  return (bool)fOut;
+}
+
+std::string Profiler::getSummary() const
+{
+  std::string text;
+  char buffer[128];
+  for (uint i = 0; i < NStages; ++i) {
+    const Histogram &histo = _histos[i];
+    if (!histo.getCount()) continue;
+    std::snprintf(buffer, sizeof buffer,
+      "%-9s p50 %.3f, p95 %.3f, p99 %.3f, max %.3f ms\n",
+      getName((Stage)i),
+      histo.getPercentile(0.50) * 1e-6, histo.getPercentile(0.95) * 1e-6,
+      histo.getPercentile(0.99) * 1e-6, histo.getMax() * 1e-6);
+    text += buffer;
+  }
+  return text;
+}
+
+std::string Profiler::getPerfSummary(
+  const std::function<std::string(uint)> &getComboName) const
+{
+  // formats one line of counters
+  auto format = [](const std::string &name, const PerfSums &perfSums) {
+    uint64_t values[PerfCounters::NCounters];
+    for (uint i = 0; i < PerfCounters::NCounters; ++i) {
+      values[i] = perfSums.values[i].load();
+    }
+    const double nInstr = (double)values[PerfCounters::Instructions];
+    const double perKI = nInstr > 0.0 ? 1000.0 / nInstr : 0.0;
+    char buffer[256];
+    std::snprintf(buffer, sizeof buffer,
+      "%-9s %9.3f Mcyc, IPC %.2f, misses/kInstr: cache %.2f,"
+      " branch %.2f, dTLB %.2f\n",
+      name.c_str(), values[PerfCounters::Cycles] * 1e-6,
+      values[PerfCounters::Cycles]
+      ? nInstr / values[PerfCounters::Cycles] : 0.0,
+      values[PerfCounters::CacheMisses] * perKI,
+      values[PerfCounters::BranchMisses] * perKI,
+      values[PerfCounters::TLBMisses] * perKI);
+    return std::string(buffer);
+  };
+  // checks whether any counter was sampled
+  auto isEmpty = [](const PerfSums &perfSums) {
+    for (const std::atomic<uint64_t> &value : perfSums.values) {
+      if (value.load()) return false;
+    }
+    return true;
+  };
+  std::string text;
+  for (uint i = 0; i < NStages; ++i) {
+    if (isEmpty(_perfStages[i])) continue;
+    text += format(getName((Stage)i), _perfStages[i]);
+  }
+  for (uint i = 0; i < NCombos; ++i) {
+    if (isEmpty(_perfCombos[i])) continue;
+    text += format(
+      getComboName ? getComboName(i) : "#" + std::to_string(i),
+      _perfCombos[i]);
+  }
+  return text;
+}
+
+uint Profiler::getTid()
+{
+  const std::thread::id id = std::this_thread::get_id();
+  const std::vector<std::thread::id>::iterator iter
+    = std::find(_tids.begin(), _tids.end(), id);
+  if (iter != _tids.end()) return (uint)(iter - _tids.begin());
+  _tids.push_back(id);
+  return (uint)(_tids.size() - 1);
+}
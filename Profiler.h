@@ -0,0 +1,392 @@
+/** @file
+ * interface of class Profiler
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// standard C++ header:
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// own header:
+#include "Histogram.h"
+#include "PerfCounters.h"
+#include "util.h"
+
+/** compile-time switch for profiling of render stages (see Profiler)
+ *
+ * 0 ... timers compiled out
+ */
+#ifndef RENDER_PROFILE
+#define RENDER_PROFILE 1
+#endif // RENDER_PROFILE
+
+/** provides timing of render stages.
+ *
+ * The durations measured for each stage are collected in lock-free
+ * histograms (to retrieve percentiles).
+ *
+ * Optionally, the durations are recorded as trace which can be written
+ * in Chrome Trace Event format (to be opened in chrome://tracing or
+ * https://ui.perfetto.dev).
+ * Thereby, coarse stages (which happen a few times per frame) are
+ * recorded as individual events.
+ * Fine stages (which happen per vertex or triangle) are summed up per
+ * frame and recorded as counters (to show which stage spiked in a frame).
+ *
+ * Additionally, hardware performance counters can be sampled per stage
+ * (see enablePerf()).
+ * They are accumulated per stage, per frame, and per state combination
+ * (passed to Timer by the caller, e.g. the rasterizer flavor).
+ *
+ * The profiling is disabled initially.
+ * If disabled, the timers cost only the check of a flag.
+ * All methods are thread-safe.
+ */
+class Profiler {
+
+  // types:
+  public:
+    /// render stages
+    enum Stage {
+      // coarse stages
+      Frame, ///< whole frame (RenderContext::render())
+      Clear, ///< clearing of frame buffers
+      RasterJob, ///< raster job (in pipelined mode)
+      Finish, ///< waiting for raster jobs (in pipelined mode)
+      Present, ///< presentation of rendered image
+      // fine stages
+      Transform, ///< transformation, face culling, and lighting
+      Clip, ///< clipping of triangles (incl. screen space transformation)
+      Setup, ///< setup of triangles for rasterizing
+      Raster, ///< rasterizing of triangles
+      NStages ///< number of stages
+    };
+
+    enum {
+      NCombos = 64, ///< max. number of state combinations
+      NoCombo = NCombos ///< no state combination
+    };
+
+    /// clock used for timing
+    typedef std::chrono::steady_clock Clock;
+
+    /** measures duration of a stage (while in scope).
+     *
+     * Use next() to switch seamlessly to another stage.
+     * If enabled, the hardware counters are sampled as well.
+     */
+    class Timer {
+#if RENDER_PROFILE
+      private:
+        Profiler *_pProfiler; ///< profiler (nullptr ... disabled)
+        Stage _stage; ///< stage to measure
+        uint _combo; ///< state combination (or NoCombo)
+        Clock::time_point _tStart; ///< start time
+        bool _perf; ///< flag: true ... hardware counters sampled
+        PerfCounters::Values _perfStart; ///< counters at start
+      public:
+        /// constructor (starting timer if profiling is enabled).
+        Timer(Profiler &profiler, Stage stage, uint combo = NoCombo):
+          _pProfiler(profiler.isEnabled() ? &profiler : nullptr),
+          _stage(stage), _combo(combo), _perf(false)
+        {
+          if (!_pProfiler) return;
+          _perf
+            = _pProfiler->isPerfEnabled() && PerfCounters::read(_perfStart);
+          _tStart = Clock::now();
+        }
+        /// destructor (recording duration).
+        ~Timer() { stop(); }
+        /// records duration of current stage and starts another stage.
+        void next(Stage stage)
+        {
+          if (!_pProfiler) return;
+          const Clock::time_point t = Clock::now();
+          _pProfiler->add(_stage, _tStart, t);
+          if (_perf) samplePerf();
+          _stage = stage; _tStart = t;
+        }
+        /// records duration (if not yet done).
+        void stop()
+        {
+          if (!_pProfiler) return;
+          _pProfiler->add(_stage, _tStart, Clock::now());
+          if (_perf) samplePerf();
+          _pProfiler = nullptr;
+        }
+      private:
+        /// records hardware counters of current stage and restarts them.
+        void samplePerf()
+        {
+          PerfCounters::Values values;
+          if (!PerfCounters::read(values)) return;
+          _pProfiler->addPerf(_stage, _combo, _perfStart, values);
+          _perfStart = values;
+        }
+#else // (RENDER_PROFILE) compiled out
+      public:
+        Timer(Profiler&, Stage, uint = NoCombo) { }
+        void next(Stage) { }
+        void stop() { }
+#endif // RENDER_PROFILE
+      // disabled:
+      public:
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+    };
+
+  private:
+    /// trace event
+    struct Event {
+      uint64_t t; ///< start time (in ns since start of trace)
+      uint64_t dt; ///< duration (in ns) or frame counter
+      uint stage; ///< stage (NStages ... counters of fine stages)
+      uint tid; ///< index of thread
+      union {
+        /// sums of fine stages (for counters only, in ns)
+        uint64_t sums[NStages - Transform];
+        /// hardware counters of frame (for counters only)
+        uint64_t perf[PerfCounters::NCounters];
+      };
+    };
+
+    /// accumulated hardware counters
+    struct PerfSums {
+      std::atomic<uint64_t> values[PerfCounters::NCounters];
+    };
+
+  // variables:
+  private:
+    /// flag: true ... profiling enabled
+    std::atomic<bool> _enabled;
+    /// histograms of stages (durations in ns)
+    Histogram _histos[NStages];
+    /// sums of fine stages in current frame (in ns)
+    std::atomic<uint64_t> _sumsFrame[NStages - Transform];
+    /// flag: true ... sampling of hardware counters enabled
+    std::atomic<bool> _perf;
+    /// hardware counters per stage
+    PerfSums _perfStages[NStages];
+    /// hardware counters per state combination
+    PerfSums _perfCombos[NCombos];
+    /// hardware counters of current frame
+    PerfSums _perfFrame;
+    /// hardware counters of last finished frame
+    PerfSums _perfFrameLast;
+    /// flag: true ... tracing enabled
+    std::atomic<bool> _tracing;
+    /// mutex to guard trace
+    mutable std::mutex _lockTrace;
+    /// start time of trace
+    Clock::time_point _tStartTrace;
+    /// recorded trace events
+    std::vector<Event> _events;
+    /// max. number of trace events
+    size_t _nEventsMax;
+    /// thread IDs (index is used as tid in trace)
+    std::vector<std::thread::id> _tids;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// constructor.
+    Profiler();
+
+    /// destructor.
+    ~Profiler() = default;
+
+    // disabled:
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /** returns name of a stage.
+     *
+     * @param stage the stage
+     * @return name of stage
+     */
+    static const char* getName(Stage stage);
+
+    /** returns whether profiling is enabled.
+     *
+     * @return true ... profiling enabled\n
+     *         false ... otherwise
+     */
+    bool isEnabled() const
+    {
+      return _enabled.load(std::memory_order_relaxed);
+    }
+    /** enables profiling.
+     *
+     * @param enable flag: true ... enable, false ... disable
+     */
+    void enable(bool enable = true) { _enabled = enable; }
+
+    /** returns the histogram of a stage.
+     *
+     * @param stage the stage
+     * @return histogram of durations (in ns)
+     */
+    const Histogram& getHistogram(Stage stage) const
+    {
+      return _histos[stage];
+    }
+
+    /** resets all histograms (and hardware counters).
+     */
+    void reset();
+
+    /** records a measured duration of a stage.
+     *
+     * @param stage the stage
+     * @param tStart start time
+     * @param tEnd end time
+     */
+    void add(Stage stage, Clock::time_point tStart, Clock::time_point tEnd);
+
+    /** enables sampling of hardware counters.
+     *
+     * The availability is checked in the calling thread.
+     * If the counters are not available in another thread, they are
+     * silently not sampled there.
+     *
+     * @param enable flag: true ... enable, false ... disable
+     * @param pError storage for an error message (or nullptr)
+     * @return true ... enabled\n
+     *         false ... disabled (or counters not available)
+     */
+    bool enablePerf(bool enable = true, std::string *pError = nullptr);
+
+    /** returns whether sampling of hardware counters is enabled.
+     *
+     * @return true ... enabled\n
+     *         false ... otherwise
+     */
+    bool isPerfEnabled() const
+    {
+      return _perf.load(std::memory_order_relaxed);
+    }
+
+    /** records the sampled hardware counters of a stage.
+     *
+     * @param stage the stage
+     * @param combo the state combination (or NoCombo)
+     * @param values0 counters at start
+     * @param values1 counters at end
+     */
+    void addPerf(
+      Stage stage, uint combo,
+      const PerfCounters::Values &values0,
+      const PerfCounters::Values &values1);
+
+    /** returns the accumulated value of a hardware counter of a stage.
+     *
+     * @param stage the stage
+     * @param counter the counter
+     * @return accumulated value since reset()
+     */
+    uint64_t getPerf(Stage stage, PerfCounters::Counter counter) const
+    {
+      return _perfStages[stage].values[counter].load();
+    }
+
+    /** returns the accumulated value of a hardware counter of a state
+     * combination.
+     *
+     * @param combo the state combination
+     * @param counter the counter
+     * @return accumulated value since reset()
+     */
+    uint64_t getPerfCombo(uint combo, PerfCounters::Counter counter) const
+    {
+      return _perfCombos[combo].values[counter].load();
+    }
+
+    /** returns the value of a hardware counter of the last frame.
+     *
+     * @note
+     * Only the thread which called RenderContext::render() is covered.
+     *
+     * @param counter the counter
+     * @return value in last finished frame
+     */
+    uint64_t getPerfFrame(PerfCounters::Counter counter) const
+    {
+      return _perfFrameLast.values[counter].load();
+    }
+
+    /** finishes a frame.
+     *
+     * If tracing, the sums of fine stages and the hardware counters of
+     * the frame are recorded as counters.
+     */
+    void endFrame();
+
+    /** starts tracing (discarding any previous trace).
+     *
+     * @param nEventsMax max. number of events to record\n
+     *        (Further events are dropped.)
+     */
+    void startTrace(size_t nEventsMax = 1 << 20);
+
+    /** stops tracing (keeping the recorded trace).
+     */
+    void stopTrace() { _tracing = false; }
+
+    /** returns whether tracing is enabled.
+     *
+     * @return true ... tracing\n
+     *         false ... otherwise
+     */
+    bool isTracing() const { return _tracing.load(); }
+
+    /** writes the recorded trace in Chrome Trace Event format (JSON).
+     *
+     * @param file path of file
+     * @return true ... trace written\n
+     *         false ... file not writable
+     */
+    bool writeTrace(const std::string &file) const;
+
+    /** returns a summary of histograms (p50, p95, p99, max. per stage).
+     *
+     * @return summary as text (one line per stage, durations in ms)
+     */
+    std::string getSummary() const;
+
+    /** returns a summary of hardware counters per stage and per state
+     * combination.
+     *
+     * @param getComboName callback to get name of a state combination
+     *        (or nullptr to show indices)
+     * @return summary as text (one line per stage or combination)
+     */
+    std::string getPerfSummary(
+      const std::function<std::string(uint)> &getComboName = nullptr) const;
+
+    //@}
+  private:
+    /// @name Internal Stuff
+    //@{
+
+    /// returns index of calling thread (for trace).
+    uint getTid();
+
+    //@}
+};
+
+#endif // PROFILER_H
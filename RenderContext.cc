@@ -1,8 +1,19 @@
 #include <algorithm>
+#include <cstring>
 
+#include "ApiTrace.h"
+#include "color.h"
+#include "CommandBuffer.h"
 #include "Plane.h"
 #include "RenderContext.h"
 
+// counts in pipeline statistics (if enabled)
+#if RENDER_STATS
+#define COUNT(EXPR) (EXPR)
+#else
+#define COUNT(EXPR) (void)0
+#endif // RENDER_STATS
+
 namespace {
 
 // component-wise multiplication (borrowed from GLSL)
@@ -33,15 +44,131 @@ Vec4T<VALUE> clamp(const Vec4T<VALUE> &value, VALUE min, VALUE max)
 
 static uint32 black = 0x00000000;
 
+// resizes a frame buffer (growing its capacity geometrically)
+template <typename VALUE>
+void resizeFB(std::vector<VALUE> &buf, size_t size, const VALUE &value)
+{
+  if (size > buf.capacity()) {
+    buf.reserve(std::max(size, buf.capacity() + buf.capacity() / 2));
+  }
+  buf.resize(size, value);
+}
+
+// returns matrix to map NDC to frame buffer coordinates
+Mat4x4f makeScreenMat(uint width, uint height)
+{
+  return Mat4x4f(InitScale, 0.5f * width, -0.5f * height, 1.0f)
+    * Mat4x4f(InitTrans, Vec3f(1.0f, -1.0f, 0.0f));
+}
+
 } // namespace
 
-RenderContext::RenderContext(uint width, uint height):
+const RenderContext::Rasterize RenderContext::_rasterizes[] = {
+  &RenderContext::rasterize<
+    NoDepth, false, false, false, false>,
+  &RenderContext::rasterize<
+    DepthWrite, false, false, false, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, false, false, false>,
+  &RenderContext::rasterize<
+    NoDepth, true, false, false, false>,
+  &RenderContext::rasterize<
+    DepthWrite, true, false, false, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, false, false, false>,
+  &RenderContext::rasterize<
+    NoDepth, false, true, false, false>,
+  &RenderContext::rasterize<
+    DepthWrite, false, true, false, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, true, false, false>,
+  &RenderContext::rasterize<
+    NoDepth, true, true, false, false>,
+  &RenderContext::rasterize<
+    DepthWrite, true, true, false, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, true, false, false>,
+  &RenderContext::rasterize<
+    NoDepth, false, false, true, false>,
+  &RenderContext::rasterize<
+    DepthWrite, false, false, true, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, false, true, false>,
+  &RenderContext::rasterize<
+    NoDepth, true, false, true, false>,
+  &RenderContext::rasterize<
+    DepthWrite, true, false, true, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, false, true, false>,
+  &RenderContext::rasterize<
+    NoDepth, false, true, true, false>,
+  &RenderContext::rasterize<
+    DepthWrite, false, true, true, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, true, true, false>,
+  &RenderContext::rasterize<
+    NoDepth, true, true, true, false>,
+  &RenderContext::rasterize<
+    DepthWrite, true, true, true, false>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, true, true, false>,
+  &RenderContext::rasterize<
+    NoDepth, false, false, false, true>,
+  &RenderContext::rasterize<
+    DepthWrite, false, false, false, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, false, false, true>,
+  &RenderContext::rasterize<
+    NoDepth, true, false, false, true>,
+  &RenderContext::rasterize<
+    DepthWrite, true, false, false, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, false, false, true>,
+  &RenderContext::rasterize<
+    NoDepth, false, true, false, true>,
+  &RenderContext::rasterize<
+    DepthWrite, false, true, false, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, true, false, true>,
+  &RenderContext::rasterize<
+    NoDepth, true, true, false, true>,
+  &RenderContext::rasterize<
+    DepthWrite, true, true, false, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, true, false, true>,
+  &RenderContext::rasterize<
+    NoDepth, false, false, true, true>,
+  &RenderContext::rasterize<
+    DepthWrite, false, false, true, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, false, true, true>,
+  &RenderContext::rasterize<
+    NoDepth, true, false, true, true>,
+  &RenderContext::rasterize<
+    DepthWrite, true, false, true, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, false, true, true>,
+  &RenderContext::rasterize<
+    NoDepth, false, true, true, true>,
+  &RenderContext::rasterize<
+    DepthWrite, false, true, true, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, false, true, true, true>,
+  &RenderContext::rasterize<
+    NoDepth, true, true, true, true>,
+  &RenderContext::rasterize<
+    DepthWrite, true, true, true, true>,
+  &RenderContext::rasterize<
+    DepthCheckAndWrite, true, true, true, true>
+};
+
+RenderContext::RenderContext(uint width, uint height, PixelFormat format):
   _width(width), _height(height),
+  _widthVP(width), _heightVP(height), _renderScale(1.0f),
+  _format(format),
   _rgbaClear(0x00000000), _depthClear(1.0f),
   _fb(_width * _height, _rgbaClear, _depthClear),
-  _matScreen(
-    Mat4x4f(InitScale, 0.5f * _width, -0.5f * _height, 1.0f)
-    * Mat4x4f(InitTrans, Vec3f(1.0f, -1.0f, 0.0f))),
+  _matScreen(makeScreenMat(_width, _height)),
   _matProj(Mat4x4f(InitIdent)),
   _matView(Mat4x4f(InitIdent)),
   _matCam(Mat4x4f(InitIdent)),
@@ -53,52 +180,73 @@ RenderContext::RenderContext(uint width, uint height):
   _ambient(0.2f),
   _mode(1 << FrontSide),
   _iTex(0),
-  _nVtcs(0)
+  _nVtcs(0),
+  _nRasterBands(0),
+  _nRasterJobs(0),
+  _tracingFrame(false)
 {
   _tex.emplace_back(1, 1, &black); // make _iTex[0] valid always
 }
 
-void RenderContext::setCamMat(const Mat4x4f &mat)
+RenderContext::~RenderContext()
 {
-  _matCam = mat; _matView = invert(_matCam);
+  setRasterBands(0);
+  stopApiTrace();
 }
 
-void RenderContext::setViewMat(const Mat4x4f &mat)
+void RenderContext::setViewport(uint width, uint height)
 {
-  _matView = mat; _matCam = invert(_matView);
+  _widthVP = std::max(width, 1u); _heightVP = std::max(height, 1u);
+  setRenderScale(_renderScale);
 }
 
-void RenderContext::enable(Mode mode, bool enable)
+void RenderContext::setRenderScale(float scale)
 {
-  (_mode &= ~(1 << mode)) |= ((uint)enable << mode);
+  _renderScale = std::min(std::max(scale, 0.0f), 1.0f);
+  resizeFrameBuffers(
+    std::max((uint)(_renderScale * _widthVP + 0.5f), 1u),
+    std::max((uint)(_renderScale * _heightVP + 0.5f), 1u));
 }
 
-namespace {
+void RenderContext::setCamMat(const Mat4x4f &mat)
+{
+  _matCam = mat;
+  _matView = isRigid(_matCam) ? invertRigid(_matCam) : invert(_matCam);
+}
 
-Vec4f lighting(
-  const Vec4f &color, const Vec3f &normal,
-  const Vec3f &light, const float ambient)
+void RenderContext::setViewMat(const Mat4x4f &mat)
 {
-  float f = dot(light, normal);
-  if (f < 0.0f) f = 0.0f;
-  f = ambient + (1.0f - ambient) * f;
-  return Vec4f(color.x * f, color.y * f, color.z * f, color.w);
-  // alpha is uneffected by lighting
+  _matView = mat;
+  _matCam = isRigid(_matView) ? invertRigid(_matView) : invert(_matView);
+}
+
+void RenderContext::enable(Mode mode, bool enable)
+{
+  if (mode == Heatmap && enable == _fb.heat.empty()) {
+    finish(); // raster jobs might access per-pixel counters
+    if (enable) _fb.heat.resize(_fb.rgba.size(), Heat());
+    else std::vector<Heat>().swap(_fb.heat);
+  }
+  (_mode &= ~(1 << mode)) |= ((uint)enable << mode);
 }
 
-} // namespace
 
 void RenderContext::drawVertex(const Vec3f &coord)
 {
   assert(_nVtcs < 3);
+  if (_tracingFrame) { traceState(false); _pCmdsTrace->drawVertex(coord); }
+  Profiler::Timer timer(_profiler, Profiler::Transform, getIRasterize());
+  COUNT(++_stats.nVtcs);
   { Vertex &vtx = _vtcs[_nVtcs];
     const Mat4x4f matMVP = _matProj * _matView * _matModel;
     vtx.coord = transformPoint(matMVP, coord);
     vtx.normal = transformVec(_matModel, _normal);
-    vtx.color = _color; vtx.texCoord = _texCoord;
+    vtx.color = getColorFmt(_color);
+    vtx.texCoord = _texCoord;
   }
   if (++_nVtcs == 3) {
     uint nVtcs = 3; _nVtcs = 0;
+    COUNT(++_stats.nTris);
     // face-culling / light correction
     Vec3f light = _light;
     // determine face normal
@@ -107,10 +255,10 @@ void RenderContext::drawVertex(const Vec3f &coord)
         _vtcs[1].coord - _vtcs[0].coord,
         _vtcs[1].coord - _vtcs[2].coord);
     if (normal.z > 0) { // view at back of face 
-      if (!isEnabled(BackSide)) return;
+      if (!isEnabled(BackSide)) { COUNT(++_stats.nTrisCulled); return; }
       light = -_light;
     } else { // view at front of face
-      if (!isEnabled(FrontSide)) return;
+      if (!isEnabled(FrontSide)) { COUNT(++_stats.nTrisCulled); return; }
     }
     // lighting
     if (isEnabled(Lighting)) {
@@ -121,124 +269,247 @@ void RenderContext::drawVertex(const Vec3f &coord)
       _vtcs[2].color
         = lighting(_vtcs[2].color, _vtcs[2].normal, light, _ambient);
     }
-    { // clipping
-      static const Planef clipPlanes[] = {
-        Planef(Vec3f(1.0f, 0.0f, 0.0f), 1.0f),
-        Planef(Vec3f(-1.0f, 0.0f, 0.0f), 1.0f),
-        Planef(Vec3f(0.0f, 1.0f, 0.0f), 1.0f),
-        Planef(Vec3f(0.0f, -1.0f, 0.0f), 1.0f),
-        Planef(Vec3f(0.0f, 0.0f, 1.0f), 1.0f),
-        Planef(Vec3f(0.0f, 0.0f, -1.0f), 1.0f)
-      };
-      for (const Planef &clipPlane : clipPlanes) {
-        uint nVtcsNew = nVtcs;
-        for (uint iVtx = 0; iVtx < nVtcs;) {
-          switch (clipTri(clipPlane, iVtx, nVtcsNew)) {
-            case 0: // triangle outside
-              if (nVtcsNew > nVtcs) {
-                _vtcs[iVtx + 0] = _vtcs[nVtcsNew - 3];
-                _vtcs[iVtx + 1] = _vtcs[nVtcsNew - 2];
-                _vtcs[iVtx + 2] = _vtcs[nVtcsNew - 1];
-                iVtx += 3;
-              } else {
-                _vtcs[iVtx + 0] = _vtcs[nVtcs - 3];
-                _vtcs[iVtx + 1] = _vtcs[nVtcs - 2];
-                _vtcs[iVtx + 2] = _vtcs[nVtcs - 1];
-                nVtcs -= 3;
-              }
-              nVtcsNew -= 3;
-              break;
-            case 1: // triangle inside
-              iVtx += 3;
-              break;
-            case 2: // triangle split
-              iVtx += 3;
-              nVtcsNew += 3;
-              break;
-            default: assert(("unreachable", false));
-          }
-        }
-        if ((nVtcs = nVtcsNew) == 0) break; // early out
+    timer.next(Profiler::Clip);
+    nVtcs = clip(_vtcs, nVtcs);
+    rasterizeTris(nVtcs, timer);
+  }
+}
+
+void RenderContext::drawMesh(const MeshSoA &mesh)
+{
+  assert(_nVtcs == 0);
+  const bool normals = mesh.hasNormals(), texCoords = mesh.hasTexCoords();
+  if (_tracingFrame) { // draw (and record) vertex by vertex
+    const Vec3f normal = _normal;
+    const Vec2f texCoord = _texCoord;
+    for (size_t i = 0, n = 3 * getNTris(mesh); i < n; ++i) {
+      const size_t iVtx = getTriVtxIdx(mesh, i);
+      if (normals) {
+        _normal = Vec3f(mesh.nx[iVtx], mesh.ny[iVtx], mesh.nz[iVtx]);
       }
+      if (texCoords) _texCoord = Vec2f(mesh.u[iVtx], mesh.v[iVtx]);
+      drawVertex(Vec3f(mesh.x[iVtx], mesh.y[iVtx], mesh.z[iVtx]));
     }
-    // transform coordinates into screen space
-    for (uint iVtx = 0; iVtx < nVtcs; ++iVtx) {
-      Vertex &vtx = _vtcs[iVtx];
-      vtx.coord = transformPoint(_matScreen, vtx.coord);
+    _normal = normal; _texCoord = texCoord;
+    return;
+  }
+  // colors vary per vertex with lit normals
+  if (normals && isEnabled(Lighting)) {
+    if (texCoords) drawMeshSoAT<true, true>(mesh);
+    else drawMeshSoAT<true, false>(mesh);
+  } else {
+    if (texCoords) drawMeshSoAT<false, true>(mesh);
+    else drawMeshSoAT<false, false>(mesh);
+  }
+}
+
+template <bool COLOR, bool TEX>
+void RenderContext::drawMeshSoAT(const MeshSoA &mesh)
+{
+  const uint iRasterize = getIRasterize();
+  const bool lit = isEnabled(Lighting);
+  // transform (and light) all vertices in batches
+  const size_t n = mesh.size();
+  VtcsSoA &vtcsT = _vtcsSoA;
+  { Profiler::Timer timer(_profiler, Profiler::Transform, iRasterize);
+    vtcsT.x.resize(n); vtcsT.y.resize(n); vtcsT.z.resize(n);
+    vtcsT.outcodes.resize(n);
+    transformPoints(_matProj * _matView * _matModel, n,
+      mesh.x.data(), mesh.y.data(), mesh.z.data(),
+      vtcsT.x.data(), vtcsT.y.data(), vtcsT.z.data(),
+      vtcsT.outcodes.data());
+    if (COLOR) {
+      vtcsT.fFront.resize(n); vtcsT.fBack.resize(n);
+      lightNormals(_matModel, n,
+        mesh.nx.data(), mesh.ny.data(), mesh.nz.data(), _light, _ambient,
+        vtcsT.fFront.data(), vtcsT.fBack.data());
     }
-    // call rasterize
-    typedef void(RenderContext::*Rasterize)(uint);
-    static const Rasterize rasterizes[] = {
-      &RenderContext::rasterize<
-        NoDepth, false, false, false>,
-      &RenderContext::rasterize<
-        DepthWrite, false, false, false>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, false, false, false>,
-      &RenderContext::rasterize<
-        NoDepth, true, false, false>,
-      &RenderContext::rasterize<
-        DepthWrite, true, false, false>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, true, false, false>,
-      &RenderContext::rasterize<
-        NoDepth, false, true, false>,
-      &RenderContext::rasterize<
-        DepthWrite, false, true, false>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, false, true, false>,
-      &RenderContext::rasterize<
-        NoDepth, true, true, false>,
-      &RenderContext::rasterize<
-        DepthWrite, true, true, false>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, true, true, false>,
-      &RenderContext::rasterize<
-        NoDepth, false, false, true>,
-      &RenderContext::rasterize<
-        DepthWrite, false, false, true>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, false, false, true>,
-      &RenderContext::rasterize<
-        NoDepth, true, false, true>,
-      &RenderContext::rasterize<
-        DepthWrite, true, false, true>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, true, false, true>,
-      &RenderContext::rasterize<
-        NoDepth, false, true, true>,
-      &RenderContext::rasterize<
-        DepthWrite, false, true, true>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, false, true, true>,
-      &RenderContext::rasterize<
-        NoDepth, true, true, true>,
-      &RenderContext::rasterize<
-        DepthWrite, true, true, true>,
-      &RenderContext::rasterize<
-        DepthCheckAndWrite, true, true, true>
+  }
+  // current attributes (for the ones which the vertices don't provide)
+  const Vec4f color = getColorFmt(_color);
+  const Vec3f normal = transformVec(_matModel, _normal);
+  // color of vertices without normals (of front and back side)
+  const Vec4f colorsSide[2] = {
+    lit ? lighting(color, normal, _light, _ambient) : color,
+    lit ? lighting(color, normal, -_light, _ambient) : color
+  };
+  // vertices of triangle (and of triangles resulting from clipping)
+  ClipVertexT<COLOR, TEX> vtcs[3 * (1 << 6)];
+  for (size_t i = 0, nIdcs = 3 * getNTris(mesh); i < nIdcs; i += 3) {
+    Profiler::Timer timer(_profiler, Profiler::Transform, iRasterize);
+    COUNT(_stats.nVtcs += 3);
+    COUNT(++_stats.nTris);
+    const size_t iVtcs[3] = {
+      getTriVtxIdx(mesh, i + 0), getTriVtxIdx(mesh, i + 1),
+      getTriVtxIdx(mesh, i + 2)
     };
-    enum { N = sizeof rasterizes / sizeof *rasterizes };
-    const uint tex = (_mode & 1 << Texturing) != 0;
-    const uint blend = (_mode & 1 << Blending) != 0;
-    const uint smooth = (_mode & 1 << Smooth) != 0;
-    const uint depthMode
-      = (_mode & 1 << DepthBuffer) != 0
-      ? (_mode & 1 << DepthTest) != 0
-      ? DepthCheckAndWrite : DepthWrite : NoDepth;
-    const uint i = (((tex * 2) + blend) * 2 + smooth) * 3 + depthMode;
-    assert(i < N);
-    (this->*rasterizes[i])(nVtcs);
+    for (uint j = 0; j < 3; ++j) {
+      const size_t iVtx = iVtcs[j];
+      vtcs[j].coord = Vec3f(vtcsT.x[iVtx], vtcsT.y[iVtx], vtcsT.z[iVtx]);
+    }
+    // face-culling (as in drawVertex())
+    const Vec3f normalFace
+      = cross(vtcs[1].coord - vtcs[0].coord, vtcs[1].coord - vtcs[2].coord);
+    const bool back = normalFace.z > 0;
+    if (!isEnabled(back ? BackSide : FrontSide)) {
+      COUNT(++_stats.nTrisCulled);
+      continue;
+    }
+    // trivial reject (all vertices outside of the same clip plane)
+    const uint outcodes[3] = {
+      vtcsT.outcodes[iVtcs[0]], vtcsT.outcodes[iVtcs[1]],
+      vtcsT.outcodes[iVtcs[2]]
+    };
+    if (outcodes[0] & outcodes[1] & outcodes[2]) {
+      COUNT(++_stats.nTrisClipped);
+      continue;
+    }
+    // attributes which vary per vertex
+    for (uint j = 0; j < 3; ++j) {
+      const size_t iVtx = iVtcs[j];
+      if (COLOR) {
+        const float f = (back ? vtcsT.fBack : vtcsT.fFront)[iVtx];
+        setClipColor(vtcs[j],
+          Vec4f(color.x * f, color.y * f, color.z * f, color.w));
+      }
+      if (TEX) setClipTexCoord(vtcs[j], Vec2f(mesh.u[iVtx], mesh.v[iVtx]));
+    }
+    timer.next(Profiler::Clip);
+    clipAndRasterize(vtcs, colorsSide[back], timer,
+      !(outcodes[0] | outcodes[1] | outcodes[2]));
+  }
+}
+
+template <bool COLOR, bool TEX>
+void RenderContext::clipAndRasterize(
+  ClipVertexT<COLOR, TEX> vtcs[], const Vec4f &color,
+  Profiler::Timer &timer, bool inside)
+{
+  const uint nVtcs = inside ? 3 : clip(vtcs, 3);
+  for (uint iVtx = 0; iVtx < nVtcs; ++iVtx) {
+    Vertex &vtx = _vtcs[iVtx];
+    vtx.coord = vtcs[iVtx].coord;
+    vtx.color = getClipColor(vtcs[iVtx], color);
+    vtx.texCoord = getClipTexCoord(vtcs[iVtx], _texCoord);
+  }
+  rasterizeTris(nVtcs, timer);
+}
+
+// instances for drawMesh()
+template void RenderContext::clipAndRasterize(
+  ClipVertexT<false, false>[], const Vec4f&, Profiler::Timer&, bool);
+template void RenderContext::clipAndRasterize(
+  ClipVertexT<false, true>[], const Vec4f&, Profiler::Timer&, bool);
+template void RenderContext::clipAndRasterize(
+  ClipVertexT<true, false>[], const Vec4f&, Profiler::Timer&, bool);
+template void RenderContext::clipAndRasterize(
+  ClipVertexT<true, true>[], const Vec4f&, Profiler::Timer&, bool);
+
+template <typename VTX>
+uint RenderContext::clip(VTX vtcs[], uint nVtcs)
+{
+  static const Planef clipPlanes[] = {
+    Planef(Vec3f(1.0f, 0.0f, 0.0f), 1.0f),
+    Planef(Vec3f(-1.0f, 0.0f, 0.0f), 1.0f),
+    Planef(Vec3f(0.0f, 1.0f, 0.0f), 1.0f),
+    Planef(Vec3f(0.0f, -1.0f, 0.0f), 1.0f),
+    Planef(Vec3f(0.0f, 0.0f, 1.0f), 1.0f),
+    Planef(Vec3f(0.0f, 0.0f, -1.0f), 1.0f)
+  };
+  for (const Planef &clipPlane : clipPlanes) {
+    uint nVtcsNew = nVtcs;
+    for (uint iVtx = 0; iVtx < nVtcs;) {
+      switch (clipTri(vtcs, clipPlane, iVtx, nVtcsNew)) {
+        case 0: // triangle outside
+          COUNT(++_stats.nTrisClipped);
+          if (nVtcsNew > nVtcs) {
+            vtcs[iVtx + 0] = vtcs[nVtcsNew - 3];
+            vtcs[iVtx + 1] = vtcs[nVtcsNew - 2];
+            vtcs[iVtx + 2] = vtcs[nVtcsNew - 1];
+            iVtx += 3;
+          } else {
+            vtcs[iVtx + 0] = vtcs[nVtcs - 3];
+            vtcs[iVtx + 1] = vtcs[nVtcs - 2];
+            vtcs[iVtx + 2] = vtcs[nVtcs - 1];
+            nVtcs -= 3;
+          }
+          nVtcsNew -= 3;
+          break;
+        case 1: // triangle inside
+          iVtx += 3;
+          break;
+        case 2: // triangle split
+          COUNT(++_stats.nTrisSplit);
+          iVtx += 3;
+          nVtcsNew += 3;
+          break;
+        default: assert(("unreachable", false));
+      }
+    }
+    if ((nVtcs = nVtcsNew) == 0) break; // early out
+  }
+  return nVtcs;
+}
+
+void RenderContext::rasterizeTris(uint nVtcs, Profiler::Timer &timer)
+{
+  COUNT(_stats.nTrisRasterized += nVtcs / 3);
+  // transform coordinates into screen space
+  for (uint iVtx = 0; iVtx < nVtcs; ++iVtx) {
+    Vertex &vtx = _vtcs[iVtx];
+    vtx.coord = transformPoint(_matScreen, vtx.coord);
+  }
+  timer.stop();
+  // call rasterize
+  enum { N = sizeof _rasterizes / sizeof *_rasterizes };
+  static_assert((uint)N <= Profiler::NCombos, "too many flavors");
+  const uint i = getIRasterize();
+  assert(i < N);
+  if (_pRing) { // pipelined mode: pass triangles to raster jobs
+    for (uint iVtx = 0; iVtx < nVtcs; iVtx += 3) {
+      Triangle *pTri;
+      while (!(pTri = _pRing->push())) waitRaster();
+      pTri->vtcs[0] = _vtcs[iVtx + 0];
+      pTri->vtcs[1] = _vtcs[iVtx + 1];
+      pTri->vtcs[2] = _vtcs[iVtx + 2];
+      // flat shading: all sub-triangles of clipped polygon share its color
+      if (!isEnabled(Smooth)) pTri->vtcs[0].color = _vtcs[0].color;
+      pTri->iRasterize = i; pTri->iTex = _iTex;
+      _pRing->commit();
+      // (re-)start raster jobs which went idle
+      for (uint iBand = 0; iBand < _nRasterBands; ++iBand) {
+        std::atomic<bool> &active = _rasterActive[iBand];
+        if (!active.load() && !active.exchange(true)) {
+          ++_nRasterJobs;
+          const JobSystem::Job job
+            = { &rasterizeRingJob, this, iBand, _nRasterBands };
+          _jobs.submit(job);
+        }
+      }
+    }
+  } else {
+    (this->*_rasterizes[i])(_vtcs, nVtcs, _iTex, 0, (int)_height, _stats);
   }
 }
 
 uint RenderContext::loadTex(uint width, uint height, const uint32 img[])
 {
+  finish(); // raster threads might access _tex
   // find free texture slot
   uint iTex = 0; const uint nTex = (uint)_tex.size();
   for (; iTex < nTex && !_tex[iTex].empty(); ++iTex);
   if (iTex == nTex) _tex.emplace_back();
-  return _tex[iTex].load(width, height, img) ? iTex : 0;
+  if (_pApiTrace && isPowerOf2(width) && isPowerOf2(height)) {
+    _pApiTrace->writeTex(width, height, img);
+  }
+  if (_format == RGBA8888) {
+    return _tex[iTex].load(width, height, img) ? iTex : 0;
+  }
+  // convert to order of color buffer (but keep alpha non-premultiplied
+  // as the colors are modulated and might be blended afterwards)
+  std::vector<uint32> imgFmt(img, img + width * height);
+  for (uint32 &texel : imgFmt) texel = swapRB(texel);
+  return _tex[iTex].load(width, height, imgFmt.data()) ? iTex : 0;
 }
 
 uint RenderContext::setTex(uint i)
@@ -248,13 +519,367 @@ uint RenderContext::setTex(uint i)
 
 void RenderContext::setClearColor(const Vec4f &color)
 {
-  _rgbaClear = clamp(color, 0.0f, 1.0f) * 0xffffffff;
+  _rgbaClear = colorToPixel(color);
+}
+
+Vec4f RenderContext::pixelToColor(uint32 pixel) const
+{
+  switch (_format) {
+    case RGBA8888: return rgbaToColor(pixel);
+    case ARGB32Premultiplied: {
+      Vec4f color = rgbaToColor(swapRB(pixel));
+      if (color.w > 0.0f) {
+        color.x /= color.w; color.y /= color.w; color.z /= color.w;
+      }
+      return clamp(color, 0.0f, 1.0f);
+    }
+    default: assert(("unreachable", false));
+  }
+  return Vec4f();
+}
+
+uint32 RenderContext::colorToPixel(const Vec4f &color) const
+{
+  const Vec4f colorClamped = clamp(color, 0.0f, 1.0f);
+  switch (_format) {
+    case RGBA8888: return colorClamped * 0xffffffff;
+    case ARGB32Premultiplied: return colorToARGBPremul(colorClamped);
+    default: assert(("unreachable", false));
+  }
+  return 0;
 }
 
 void RenderContext::clear(bool rgba, bool depth)
 {
-  if (rgba) std::fill(_fb.rgba.begin(), _fb.rgba.end(), _rgbaClear);
-  if (depth) std::fill(_fb.depth.begin(), _fb.depth.end(), _depthClear);
+  if (_tracingFrame) { traceState(false); _pCmdsTrace->clear(rgba, depth); }
+  finish();
+  Profiler::Timer timer(_profiler, Profiler::Clear);
+  _jobs.parallelFor(0, _fb.rgba.size(), 64 * 1024,
+    [&](size_t i0, size_t i1) {
+      if (rgba) {
+        std::fill(_fb.rgba.begin() + i0, _fb.rgba.begin() + i1, _rgbaClear);
+        if (!_fb.heat.empty()) {
+          std::fill(_fb.heat.begin() + i0, _fb.heat.begin() + i1, Heat());
+        }
+      }
+      if (depth) {
+        std::fill(
+          _fb.depth.begin() + i0, _fb.depth.begin() + i1, _depthClear);
+      }
+    });
+}
+
+void RenderContext::execute(const CommandBuffer &cmdBuf)
+{
+  const float *values = cmdBuf.values();
+  const CommandBuffer::Command *cmd = cmdBuf.cmds();
+  for (const CommandBuffer::Command *end = cmd + cmdBuf.size();
+    cmd != end; ++cmd) {
+    const float *value = values + cmd->arg;
+    switch (cmd->op) {
+      case CommandBuffer::OpSetProjMat:
+        std::copy(value, value + 16, _matProj.comp);
+        break;
+      case CommandBuffer::OpSetViewMat: {
+        Mat4x4f mat; std::copy(value, value + 16, mat.comp);
+        setViewMat(mat);
+      } break;
+      case CommandBuffer::OpSetCamMat: {
+        Mat4x4f mat; std::copy(value, value + 16, mat.comp);
+        setCamMat(mat);
+      } break;
+      case CommandBuffer::OpSetModelMat:
+        std::copy(value, value + 16, _matModel.comp);
+        break;
+      case CommandBuffer::OpEnable:
+        enable((Mode)(cmd->arg / 2), (cmd->arg & 1) != 0);
+        break;
+      case CommandBuffer::OpSetAmbient:
+        setAmbient(value[0]);
+        break;
+      case CommandBuffer::OpSetNormal:
+        _normal = Vec3f(value[0], value[1], value[2]);
+        break;
+      case CommandBuffer::OpSetColor:
+        _color = Vec4f(value[0], value[1], value[2], value[3]);
+        break;
+      case CommandBuffer::OpSetTexCoord:
+        _texCoord = Vec2f(value[0], value[1]);
+        break;
+      case CommandBuffer::OpDrawVertex:
+        drawVertex(Vec3f(value[0], value[1], value[2]));
+        break;
+      case CommandBuffer::OpSetTex:
+        setTex(cmd->arg);
+        break;
+      case CommandBuffer::OpSetClearColor:
+        setClearColor(Vec4f(value[0], value[1], value[2], value[3]));
+        break;
+      case CommandBuffer::OpClear:
+        clear((cmd->arg & 1) != 0, (cmd->arg & 2) != 0);
+        break;
+      case CommandBuffer::OpSetViewport:
+        setViewport((uint)value[0], (uint)value[1]);
+        break;
+      default: assert(("unreachable", false));
+    }
+  }
+}
+
+void RenderContext::execute(const std::vector<CommandBuffer> &cmdBufs)
+{
+  for (const CommandBuffer &cmdBuf : cmdBufs) execute(cmdBuf);
+}
+
+RenderContext::State RenderContext::getState() const
+{
+  State state;
+  state.matProj = _matProj;
+  state.matCam = _matCam;
+  state.matModel = _matModel;
+  state.mode = _mode;
+  state.ambient = _ambient;
+  state.iTex = _iTex;
+  state.rgbaClear = _rgbaClear;
+  state.nThreads = _jobs.getThreads();
+  state.pinThreads = _jobs.isPinned();
+  state.nRasterBands = _nRasterBands;
+  state.widthVP = _widthVP;
+  state.heightVP = _heightVP;
+  return state;
+}
+
+void RenderContext::setState(const State &state)
+{
+  _matProj = state.matProj;
+  setCamMat(state.matCam);
+  _matModel = state.matModel;
+  enable(Heatmap, state.isEnabled(Heatmap));
+  _mode = state.mode;
+  setAmbient(state.ambient);
+  setTex(state.iTex);
+  _rgbaClear = state.rgbaClear;
+  setThreads(state.nThreads, state.pinThreads);
+  setRasterBands(state.nRasterBands);
+  setViewport(state.widthVP, state.heightVP);
+}
+
+void RenderContext::swapRGBA(std::vector<uint32> &rgba)
+{
+  finish();
+  resizeFB(rgba, _fb.rgba.size(), _rgbaClear);
+  _fb.rgba.swap(rgba);
+}
+
+void RenderContext::setThreads(uint nThreads, bool pin)
+{
+  finish();
+  _jobs.setThreads(nThreads, pin);
+}
+
+void RenderContext::setRasterBands(uint nBands)
+{
+  if (nBands == _nRasterBands) return;
+  finish();
+  _pRing.reset(); _rasterActive.reset();
+  // keep statistics of raster jobs
+  for (uint i = 0; i < _nRasterBands; ++i) _stats += _statsBands[i].stats;
+  _statsBands.reset();
+  if ((_nRasterBands = nBands)) {
+    _pRing.reset(new RingT<Triangle>(4096, nBands));
+    _statsBands.reset(new StatsBand[nBands]);
+    _rasterActive.reset(new std::atomic<bool>[nBands]);
+    for (uint i = 0; i < nBands; ++i) _rasterActive[i] = false;
+  }
+}
+
+RenderContext::Stats RenderContext::getStats() const
+{
+  Stats stats = _stats;
+  for (uint i = 0; i < _nRasterBands; ++i) stats += _statsBands[i].stats;
+  return stats;
+}
+
+std::string RenderContext::getRasterizeName(uint i)
+{
+  static const char *const depthModes[] = { "", "DepthWrite", "DepthTest" };
+  static const char *const flags[] = {
+    "Smooth", "Blending", "Texturing", "Heatmap"
+  };
+  std::string name = depthModes[i % 3];
+  i /= 3;
+  for (const char *flag : flags) {
+    if (i & 1) name += (name.empty() ? "" : "+") + std::string(flag);
+    i >>= 1;
+  }
+  return name.empty() ? "Flat" : name;
+}
+
+uint RenderContext::getHeatmap(
+  HeatKind kind, std::vector<uint32> &img, uint max) const
+{
+  img.resize(_fb.rgba.size());
+  if (_fb.heat.empty()) {
+    std::fill(img.begin(), img.end(), colorToPixel(Vec4f(0, 0, 0, 1)));
+    return 0;
+  }
+  if (!max) {
+    for (const Heat &heat : _fb.heat) max = std::max(max, getHeat(kind, heat));
+  }
+  if (!max) max = 1;
+  // false color ramp: blue, cyan, green, yellow, red
+  static const Vec4f colors[] = {
+    Vec4f(0.0f, 0.0f, 1.0f, 1.0f), Vec4f(0.0f, 1.0f, 1.0f, 1.0f),
+    Vec4f(0.0f, 1.0f, 0.0f, 1.0f), Vec4f(1.0f, 1.0f, 0.0f, 1.0f),
+    Vec4f(1.0f, 0.0f, 0.0f, 1.0f)
+  };
+  enum { NColors = sizeof colors / sizeof *colors };
+  // pre-compute colors of all values (as there are usually only a few)
+  std::vector<uint32> pixels(max + 1);
+  pixels[0] = colorToPixel(Vec4f(0.0f, 0.0f, 0.0f, 1.0f));
+  for (uint value = 1; value <= max; ++value) {
+    const float f = max > 1 ? (float)(value - 1) / (max - 1) : 1.0f;
+    const float t = f * (NColors - 1);
+    const uint i = std::min((uint)t, (uint)NColors - 2);
+    const float f1 = t - i, f0 = 1.0f - f1;
+    pixels[value] = colorToPixel(f0 * colors[i] + f1 * colors[i + 1]);
+  }
+  for (size_t i = 0, n = img.size(); i < n; ++i) {
+    img[i] = pixels[std::min(getHeat(kind, _fb.heat[i]), max)];
+  }
+  return max;
+}
+
+void RenderContext::render()
+{
+  if (_pApiTrace) { // record frame with its complete start state
+    _pCmdsTrace->reset(); _tracingFrame = true; traceState(true);
+  }
+  { Profiler::Timer timer(_profiler, Profiler::Frame);
+    resetStats(); _cbRender(*this); finish();
+  }
+  _profiler.endFrame();
+  if (_tracingFrame) {
+    _tracingFrame = false; _pApiTrace->writeFrame(*_pCmdsTrace);
+  }
+}
+
+bool RenderContext::startApiTrace(const std::string &file)
+{
+  stopApiTrace();
+  finish(); // raster threads might access _tex
+  std::unique_ptr<ApiTraceWriter> pApiTrace(new ApiTraceWriter());
+  if (!pApiTrace->open(file, _width, _height, _format)) return false;
+  // record already loaded textures (in order of color buffer)
+  for (uint iTex = 1; iTex < (uint)_tex.size(); ++iTex) {
+    const Texture &tex = _tex[iTex];
+    std::vector<uint32> img(tex.data(),
+      tex.data() + (size_t)tex.getWidth() * tex.getHeight());
+    if (_format != RGBA8888) for (uint32 &texel : img) texel = swapRB(texel);
+    pApiTrace->writeTex(tex.getWidth(), tex.getHeight(), img.data());
+  }
+  _pApiTrace = std::move(pApiTrace);
+  _pCmdsTrace.reset(new CommandBuffer());
+  return true;
+}
+
+bool RenderContext::stopApiTrace()
+{
+  if (!_pApiTrace) return false;
+  const bool ok = _pApiTrace->close();
+  _pApiTrace.reset(); _pCmdsTrace.reset();
+  return ok;
+}
+
+void RenderContext::resetStats()
+{
+  finish();
+  _stats = Stats();
+  for (uint i = 0; i < _nRasterBands; ++i) _statsBands[i].stats = Stats();
+}
+
+void RenderContext::finish()
+{
+  if (!_pRing || (_pRing->drained() && !_nRasterJobs)) return;
+  Profiler::Timer timer(_profiler, Profiler::Finish);
+  while (!_pRing->drained() || _nRasterJobs) waitRaster();
+}
+
+void RenderContext::resizeFrameBuffers(uint width, uint height)
+{
+  if (width == _width && height == _height) return;
+  finish(); // raster jobs might access frame buffers
+  _width = width; _height = height;
+  const size_t size = (size_t)width * height;
+  resizeFB(_fb.rgba, size, _rgbaClear);
+  resizeFB(_fb.depth, size, _depthClear);
+  if (!_fb.heat.empty()) resizeFB(_fb.heat, size, Heat());
+  _matScreen = makeScreenMat(width, height);
+}
+
+void RenderContext::rasterizeRing(uint iBand, uint nBands)
+{
+  // determine band of frame buffer for this job
+  const int yMin = (int)(iBand * _height / nBands);
+  const int yMax = (int)((iBand + 1) * _height / nBands);
+  Profiler::Timer timer(_profiler, Profiler::RasterJob);
+  do {
+    while (const Triangle *pTri = _pRing->front(iBand)) {
+      // skip triangles which don't touch the band
+      const float yT = std::min(pTri->vtcs[0].coord.y,
+        std::min(pTri->vtcs[1].coord.y, pTri->vtcs[2].coord.y));
+      const float yB = std::max(pTri->vtcs[0].coord.y,
+        std::max(pTri->vtcs[1].coord.y, pTri->vtcs[2].coord.y));
+      if (rnd(yB) > yMin && rnd(yT) < yMax) {
+        (this->*_rasterizes[pTri->iRasterize])(
+          pTri->vtcs, 3, pTri->iTex, yMin, yMax, _statsBands[iBand].stats);
+      }
+      _pRing->pop(iBand);
+    }
+    _rasterActive[iBand] = false;
+    // continue if a triangle has been committed meanwhile
+  } while (_pRing->front(iBand) && !_rasterActive[iBand].exchange(true));
+  timer.stop();
+  --_nRasterJobs; // Nothing of this must be touched afterwards.
+}
+
+void RenderContext::traceState(bool all)
+{
+  CommandBuffer &cmds = *_pCmdsTrace;
+  TraceState &last = _traceLast;
+  // checks for bitwise changes
+  auto changed = [all](const void *p1, const void *p2, size_t size) {
+    return all || std::memcmp(p1, p2, size) != 0;
+  };
+  // size of frame buffers (i.e. of viewport when replayed with scale 1)
+  if (all || last.width != _width || last.height != _height) {
+    last.width = _width; last.height = _height;
+    cmds.setViewport(_width, _height);
+  }
+#define TRACE(MEMBER, VALUE, CALL) \
+  if (changed(&last.MEMBER, &VALUE, sizeof VALUE)) { \
+    last.MEMBER = VALUE; cmds.CALL(VALUE); \
+  }
+  TRACE(matProj, _matProj, setProjMat);
+  TRACE(matCam, _matCam, setCamMat);
+  TRACE(matModel, _matModel, setModelMat);
+  TRACE(ambient, _ambient, setAmbient);
+  TRACE(iTex, _iTex, setTex);
+  TRACE(normal, _normal, setNormal);
+  TRACE(color, _color, setColor);
+  TRACE(texCoord, _texCoord, setTexCoord);
+#undef TRACE
+  if (changed(&last.rgbaClear, &_rgbaClear, sizeof _rgbaClear)) {
+    last.rgbaClear = _rgbaClear;
+    cmds.setClearColor(pixelToColor(_rgbaClear));
+  }
+  for (uint i = 0; i < NModes; ++i) {
+    const uint bit = 1 << i;
+    if (all || (last.mode & bit) != (_mode & bit)) {
+      cmds.enable(i, (_mode & bit) != 0);
+    }
+  }
+  last.mode = _mode;
 }
 
 RenderContext::Vertex RenderContext::lerpVtx(
@@ -270,57 +895,100 @@ RenderContext::Vertex RenderContext::lerpVtx(
     lerp(vtx0.texCoord, vtx1.texCoord, f0, f1));
 }
 
-uint RenderContext::clipTri(const Planef &plane, uint iVtx0, uint iVtx3)
+namespace {
+
+// interpolates color of vertices in clip stage (if varying)
+void lerpClipColor(
+  ClipColorT<true> &vtx, const ClipColorT<true> &vtx0,
+  const ClipColorT<true> &vtx1, float f0, float f1, bool smooth)
+{
+  vtx.color = smooth ? lerp(vtx0.color, vtx1.color, f0, f1) : vtx0.color;
+}
+void lerpClipColor(
+  ClipColorT<false>&, const ClipColorT<false>&, const ClipColorT<false>&,
+  float, float, bool)
+{ }
+
+// interpolates texture coordinate of vertices in clip stage (if any)
+void lerpClipTexCoord(
+  ClipTexCoordT<true> &vtx, const ClipTexCoordT<true> &vtx0,
+  const ClipTexCoordT<true> &vtx1, float f0, float f1)
+{
+  vtx.texCoord = lerp(vtx0.texCoord, vtx1.texCoord, f0, f1);
+}
+void lerpClipTexCoord(
+  ClipTexCoordT<false>&, const ClipTexCoordT<false>&,
+  const ClipTexCoordT<false>&, float, float)
+{ }
+
+} // namespace
+
+template <bool COLOR, bool TEX>
+ClipVertexT<COLOR, TEX> RenderContext::lerpVtx(
+  const ClipVertexT<COLOR, TEX> &vtx0, const ClipVertexT<COLOR, TEX> &vtx1,
+  float f1)
+{
+  const float f0 = 1.0f - f1;
+  ClipVertexT<COLOR, TEX> vtx;
+  vtx.coord = lerp(vtx0.coord, vtx1.coord, f0, f1);
+  lerpClipColor(vtx, vtx0, vtx1, f0, f1, isEnabled(Smooth));
+  lerpClipTexCoord(vtx, vtx0, vtx1, f0, f1);
+  return vtx;
+}
+
+template <typename VTX>
+uint RenderContext::clipTri(
+  VTX vtcs[], const Planef &plane, uint iVtx0, uint iVtx3)
 {
-  const float d0 = -getSignDist(plane, _vtcs[iVtx0 + 0].coord);
-  const float d1 = -getSignDist(plane, _vtcs[iVtx0 + 1].coord);
-  const float d2 = -getSignDist(plane, _vtcs[iVtx0 + 2].coord);
+  const float d0 = -getSignDist(plane, vtcs[iVtx0 + 0].coord);
+  const float d1 = -getSignDist(plane, vtcs[iVtx0 + 1].coord);
+  const float d2 = -getSignDist(plane, vtcs[iVtx0 + 2].coord);
   switch ((d0 >= 0.0f) * 1 | (d1 >= 0.0f) * 2 | (d2 >= 0.0f) * 4) {
     // all vertices outside:
     case 0: return 0;
     // cases with one vertex inside:
     case 1:
-      _vtcs[iVtx0 + 1]
-        = lerpVtx(_vtcs[iVtx0 + 0], _vtcs[iVtx0 + 1], d0 / (d0 - d1));
-      _vtcs[iVtx0 + 2]
-        = lerpVtx(_vtcs[iVtx0 + 0], _vtcs[iVtx0 + 2], d0 / (d0 - d2));
+      vtcs[iVtx0 + 1]
+        = lerpVtx(vtcs[iVtx0 + 0], vtcs[iVtx0 + 1], d0 / (d0 - d1));
+      vtcs[iVtx0 + 2]
+        = lerpVtx(vtcs[iVtx0 + 0], vtcs[iVtx0 + 2], d0 / (d0 - d2));
       return 1;
     case 2:
-      _vtcs[iVtx0 + 0]
-        = lerpVtx(_vtcs[iVtx0 + 1], _vtcs[iVtx0 + 0], d1 / (d1 - d0));
-      _vtcs[iVtx0 + 2]
-        = lerpVtx(_vtcs[iVtx0 + 1], _vtcs[iVtx0 + 2], d1 / (d1 - d2));
+      vtcs[iVtx0 + 0]
+        = lerpVtx(vtcs[iVtx0 + 1], vtcs[iVtx0 + 0], d1 / (d1 - d0));
+      vtcs[iVtx0 + 2]
+        = lerpVtx(vtcs[iVtx0 + 1], vtcs[iVtx0 + 2], d1 / (d1 - d2));
       return 1;
     case 4:
-      _vtcs[iVtx0 + 0]
-        = lerpVtx(_vtcs[iVtx0 + 2], _vtcs[iVtx0 + 0], d2 / (d2 - d0));
-      _vtcs[iVtx0 + 1]
-        = lerpVtx(_vtcs[iVtx0 + 2], _vtcs[iVtx0 + 1], d2 / (d2 - d1));
+      vtcs[iVtx0 + 0]
+        = lerpVtx(vtcs[iVtx0 + 2], vtcs[iVtx0 + 0], d2 / (d2 - d0));
+      vtcs[iVtx0 + 1]
+        = lerpVtx(vtcs[iVtx0 + 2], vtcs[iVtx0 + 1], d2 / (d2 - d1));
       return 1;
     // cases with two vertices inside:
     case 1 | 2:
-      _vtcs[iVtx3 + 0]
-        = lerpVtx(_vtcs[iVtx0 + 2], _vtcs[iVtx0 + 0], d2 / (d2 - d0));
-      _vtcs[iVtx3 + 1] =  _vtcs[iVtx0 + 1];
-      _vtcs[iVtx3 + 2]
-        = lerpVtx(_vtcs[iVtx0 + 2], _vtcs[iVtx0 + 1], d2 / (d2 - d1));
-      _vtcs[iVtx0 + 2] = _vtcs[iVtx3 + 0];
+      vtcs[iVtx3 + 0]
+        = lerpVtx(vtcs[iVtx0 + 2], vtcs[iVtx0 + 0], d2 / (d2 - d0));
+      vtcs[iVtx3 + 1] =  vtcs[iVtx0 + 1];
+      vtcs[iVtx3 + 2]
+        = lerpVtx(vtcs[iVtx0 + 2], vtcs[iVtx0 + 1], d2 / (d2 - d1));
+      vtcs[iVtx0 + 2] = vtcs[iVtx3 + 0];
       return 2;
     case 1 | 4:
-      _vtcs[iVtx3 + 0] = _vtcs[iVtx0 + 0];
-      _vtcs[iVtx3 + 1]
-        = lerpVtx(_vtcs[iVtx0 + 1], _vtcs[iVtx0 + 0], d1 / (d1 - d0));
-      _vtcs[iVtx3 + 2]
-        = lerpVtx(_vtcs[iVtx0 + 1], _vtcs[iVtx0 + 2], d1 / (d1 - d2));
-      _vtcs[iVtx0 + 1] = _vtcs[iVtx3 + 2];
+      vtcs[iVtx3 + 0] = vtcs[iVtx0 + 0];
+      vtcs[iVtx3 + 1]
+        = lerpVtx(vtcs[iVtx0 + 1], vtcs[iVtx0 + 0], d1 / (d1 - d0));
+      vtcs[iVtx3 + 2]
+        = lerpVtx(vtcs[iVtx0 + 1], vtcs[iVtx0 + 2], d1 / (d1 - d2));
+      vtcs[iVtx0 + 1] = vtcs[iVtx3 + 2];
       return 2;
     case 2 | 4:
-      _vtcs[iVtx3 + 0]
-        = lerpVtx(_vtcs[iVtx0 + 0], _vtcs[iVtx0 + 2], d0 / (d0 - d2));
-      _vtcs[iVtx3 + 1]
-        = lerpVtx(_vtcs[iVtx0 + 0], _vtcs[iVtx0 + 1], d0 / (d0 - d1));
-      _vtcs[iVtx3 + 2] = _vtcs[iVtx0 + 2];
-      _vtcs[iVtx0 + 0] = _vtcs[iVtx3 + 1];
+      vtcs[iVtx3 + 0]
+        = lerpVtx(vtcs[iVtx0 + 0], vtcs[iVtx0 + 2], d0 / (d0 - d2));
+      vtcs[iVtx3 + 1]
+        = lerpVtx(vtcs[iVtx0 + 0], vtcs[iVtx0 + 1], d0 / (d0 - d1));
+      vtcs[iVtx3 + 2] = vtcs[iVtx0 + 2];
+      vtcs[iVtx0 + 0] = vtcs[iVtx3 + 1];
       return 2;
     // all vertices inside:
     case 1 | 2 | 4: return 1;
@@ -334,28 +1002,42 @@ template <
   RenderContext::DepthMode DEPTH_MODE,
   bool SMOOTH,
   bool BLEND,
-  bool TEX>
-void RenderContext::rasterize(uint nVtcs)
+  bool TEX,
+  bool HEAT>
+void RenderContext::rasterize(
+  const Vertex vtcs[], uint nVtcs, uint iTex, int yMin, int yMax,
+  Stats &stats)
 {
-  Vec4f color = _vtcs[0].color;
+#if RENDER_STATS
+  // count locally (and add to stats once at end)
+  uint64_t nFragments = 0, nFragsDepthFailed = 0, nFragsBlended = 0;
+#endif // RENDER_STATS
+  Vec4f color = vtcs[0].color;
   uint32 rgba = color * (uint32)0xffffffff;
+  // min. blend factor of alpha of foreground
+  // (premultiplied: 1, i.e. A = A_fg + (1 - A_fg) * A_bg; otherwise: 0)
+  const float alphaFgMin = _format == ARGB32Premultiplied ? 1.0f : 0.0f;
+  enum {
+    Combo = ((((HEAT * 2) + TEX) * 2 + BLEND) * 2 + SMOOTH) * 3 + DEPTH_MODE
+  };
   for (uint iVtx = 0; iVtx < nVtcs; iVtx += 3) {
+    Profiler::Timer timer(_profiler, Profiler::Setup, Combo);
     // sort vertices by y coordinates
     uint iVtcs[3] = { iVtx + 0, iVtx + 1, iVtx + 2 };
-    if (_vtcs[iVtcs[0]].coord.y > _vtcs[iVtcs[1]].coord.y) {
+    if (vtcs[iVtcs[0]].coord.y > vtcs[iVtcs[1]].coord.y) {
       std::swap(iVtcs[0], iVtcs[1]);
     }
-    if (_vtcs[iVtcs[1]].coord.y > _vtcs[iVtcs[2]].coord.y) {
+    if (vtcs[iVtcs[1]].coord.y > vtcs[iVtcs[2]].coord.y) {
       std::swap(iVtcs[1], iVtcs[2]);
     }
-    if (_vtcs[iVtcs[0]].coord.y > _vtcs[iVtcs[1]].coord.y) {
+    if (vtcs[iVtcs[0]].coord.y > vtcs[iVtcs[1]].coord.y) {
       std::swap(iVtcs[0], iVtcs[1]);
     }
     // cut triangle in upper and lower part
-    const Vertex &vtxT = _vtcs[iVtcs[0]];
-    const Vertex &vtxM = _vtcs[iVtcs[1]];
-    const Vertex &vtxB = _vtcs[iVtcs[2]];
-    if (std::abs(vtxB.coord.y - vtxT.coord.y) < 1E-10) return;
+    const Vertex &vtxT = vtcs[iVtcs[0]];
+    const Vertex &vtxM = vtcs[iVtcs[1]];
+    const Vertex &vtxB = vtcs[iVtcs[2]];
+    if (std::abs(vtxB.coord.y - vtxT.coord.y) < 1E-10) continue;
     const float f1
       = (vtxM.coord.y - vtxT.coord.y) / (vtxB.coord.y - vtxT.coord.y);
     const float f0 = 1.0f - f1;
@@ -379,14 +1061,15 @@ void RenderContext::rasterize(uint nVtcs)
       if (SMOOTH) std::swap(colorLM, colorRM);
       if (TEX) std::swap(texCoordLM, texCoordRM);
     }
-    const Texture &tex = _tex[_iTex];
+    const Texture &tex = _tex[iTex];
     const int yT = rnd(vtxT.coord.y);
     const int yM = rnd(vtxM.coord.y);
     const int yB = rnd(vtxB.coord.y);
+    timer.next(Profiler::Raster);
     // draw upper part of triangle
     if (yT < yM) {
       const float dY = vtxM.coord.y - vtxT.coord.y;
-      for (int y = std::max(yT, 0), yE = std::min(yM, (int)_height);
+      for (int y = std::max(yT, yMin), yE = std::min(yM, yMax);
         y < yE; ++y) {
         const float f1 = (y - yT) / dY, f0 = 1.0f - f1;
         const float xLY = lerp(vtxT.coord.x, xLM, f0, f1);
@@ -412,14 +1095,18 @@ void RenderContext::rasterize(uint nVtcs)
         for (int x = std::max(xL, 0), xE = std::min(xR, (int)_width);
           x < xE; ++x) {
           const size_t iX = i + x;
+          COUNT(++nFragments);
           float f1, f0;
           if (DEPTH_MODE > NoDepth || SMOOTH || TEX) {
             f1 = (x - xL) / dX; f0 = 1.0f - f1;
           }
           if (DEPTH_MODE > NoDepth) {
             const float z = lerp(zL, zR, f0, f1);
-            if (DEPTH_MODE == DepthCheckAndWrite
-              && z >= _fb.depth[iX]) continue;
+            if (DEPTH_MODE == DepthCheckAndWrite && z >= _fb.depth[iX]) {
+              COUNT(++nFragsDepthFailed);
+              if (HEAT) ++_fb.heat[iX].nDepthFailed;
+              continue;
+            }
             _fb.depth[iX] = z;
           }
           if (SMOOTH) {
@@ -430,19 +1117,23 @@ void RenderContext::rasterize(uint nVtcs)
             rgba = color * tex[texCoord];
           } else rgba = color * (uint32)0xffffffff;
           if (BLEND) {
+            COUNT(++nFragsBlended);
+            if (HEAT) ++_fb.heat[iX].nBlended;
             const float f1 = ((rgba >> 24) & 0xff) * 1.0f / 255;
             const float f0 = 1.0f - f1;
-            const Vec4f blendFg(f1, f1, f1, f1), blendBg(f0, f0, f0, f0);
+            const Vec4f blendFg(f1, f1, f1, std::max(f1, alphaFgMin));
+            const Vec4f blendBg(f0, f0, f0, f0);
             rgba = blendFg * rgba + blendBg * _fb.rgba[iX];
           } else rgba |= 0xff000000;
           _fb.rgba[iX] = rgba;
+          if (HEAT) ++_fb.heat[iX].nWrites;
         }
       }
     }
     // draw lower part of triangle
     if (yM < yB) {
       const float dY = vtxB.coord.y - vtxM.coord.y;
-      for (int y = std::max(yM, 0), yE = std::min(yB, (int)_height);
+      for (int y = std::max(yM, yMin), yE = std::min(yB, yMax);
         y < yE; ++y) {
         const float f1 = (y - yM) / dY, f0 = 1.0f - f1;
         const float xLY = lerp(xLM, vtxB.coord.x, f0, f1);
@@ -468,14 +1159,18 @@ void RenderContext::rasterize(uint nVtcs)
         for (int x = std::max(xL, 0), xE = std::min(xR, (int)_width);
           x < xE; ++x) {
           const size_t iX = i + x;
+          COUNT(++nFragments);
           float f1, f0;
           if (DEPTH_MODE > NoDepth || SMOOTH || TEX) {
             f1 = (x - xL) / dX; f0 = 1.0f - f1;
           }
           if (DEPTH_MODE > NoDepth) {
             const float z = lerp(zL, zR, f0, f1);
-            if (DEPTH_MODE == DepthCheckAndWrite
-              && z >= _fb.depth[iX]) continue;
+            if (DEPTH_MODE == DepthCheckAndWrite && z >= _fb.depth[iX]) {
+              COUNT(++nFragsDepthFailed);
+              if (HEAT) ++_fb.heat[iX].nDepthFailed;
+              continue;
+            }
             _fb.depth[iX] = z;
           }
           if (SMOOTH) {
@@ -486,14 +1181,21 @@ void RenderContext::rasterize(uint nVtcs)
             rgba = color * tex[texCoord];
           } else rgba = color * (uint32)0xffffffff;
           if (BLEND) {
+            COUNT(++nFragsBlended);
+            if (HEAT) ++_fb.heat[iX].nBlended;
             const float f1 = ((rgba >> 24) & 0xff) * 1.0f / 255;
             const float f0 = 1.0f - f1;
-            const Vec4f blendFg(f1, f1, f1, f1), blendBg(f0, f0, f0, f0);
+            const Vec4f blendFg(f1, f1, f1, std::max(f1, alphaFgMin));
+            const Vec4f blendBg(f0, f0, f0, f0);
             rgba = blendFg * rgba + blendBg * _fb.rgba[iX];
           } else rgba |= 0xff000000;
           _fb.rgba[iX] = rgba;
+          if (HEAT) ++_fb.heat[iX].nWrites;
         }
       }
     }
   }
+  COUNT(stats.nFragments += nFragments);
+  COUNT(stats.nFragsDepthFailed += nFragsDepthFailed);
+  COUNT(stats.nFragsBlended += nFragsBlended);
 }
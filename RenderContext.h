@@ -8,20 +8,120 @@
 // standard C++ header:
 #include <cstdint>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 // own header:
+#include "JobSystem.h"
 #include "linmath.h"
+#include "Mesh.h"
 #include "Plane.h"
+#include "Profiler.h"
+#include "Ring.h"
 #include "Texture.h"
 #include "util.h"
 
+/** compile-time switch for pipeline statistics (see RenderContext::Stats)
+ *
+ * 0 ... counting compiled out (RenderContext::getStats() returns 0s)
+ */
+#ifndef RENDER_STATS
+#define RENDER_STATS 1
+#endif // RENDER_STATS
+
+// forward declarations:
+class ApiTraceWriter;
+class CommandBuffer;
+
+/// color of a vertex in clip stage (if it varies per vertex)
+template <bool COLOR>
+struct ClipColorT {
+  Vec4f color; ///< vertex color
+};
+template <>
+struct ClipColorT<false> { };
+
+/// texture coordinate of a vertex in clip stage (if provided per vertex)
+template <bool TEX>
+struct ClipTexCoordT {
+  Vec2f texCoord; ///< texture coordinate
+};
+template <>
+struct ClipTexCoordT<false> { };
+
+/** vertex in clip stage of RenderContext::drawMesh()
+ *
+ * It has only the attributes which vary per vertex.
+ * (The empty bases take no storage, i.e. e.g. ClipVertexT<false, false>
+ * takes 12 bytes instead of 48 bytes of RenderContext::Vertex.)
+ *
+ * @tparam COLOR flag: true ... color varies per vertex
+ * @tparam TEX flag: true ... texture coordinate varies per vertex
+ */
+template <bool COLOR, bool TEX>
+struct ClipVertexT: ClipColorT<COLOR>, ClipTexCoordT<TEX> {
+  Vec3f coord; ///< 3d coordinate
+};
+
+/// sets color of a vertex in clip stage.
+inline void setClipColor(ClipColorT<true> &vtx, const Vec4f &color)
+{
+  vtx.color = color;
+}
+/// sets color of a vertex in clip stage (nothing if not varying).
+inline void setClipColor(ClipColorT<false>&, const Vec4f&) { }
+
+/// returns color of a vertex in clip stage.
+inline const Vec4f& getClipColor(const ClipColorT<true> &vtx, const Vec4f&)
+{
+  return vtx.color;
+}
+/// returns color of a vertex in clip stage (@a color if not varying).
+inline const Vec4f& getClipColor(
+  const ClipColorT<false>&, const Vec4f &color)
+{
+  return color;
+}
+
+/// sets texture coordinate of a vertex in clip stage.
+inline void setClipTexCoord(ClipTexCoordT<true> &vtx, const Vec2f &texCoord)
+{
+  vtx.texCoord = texCoord;
+}
+/// sets texture coordinate of a vertex in clip stage (nothing if none).
+inline void setClipTexCoord(ClipTexCoordT<false>&, const Vec2f&) { }
+
+/// returns texture coordinate of a vertex in clip stage.
+inline const Vec2f& getClipTexCoord(
+  const ClipTexCoordT<true> &vtx, const Vec2f&)
+{
+  return vtx.texCoord;
+}
+/// returns texture coordinate of a vertex in clip stage (@a texCoord if
+/// none).
+inline const Vec2f& getClipTexCoord(
+  const ClipTexCoordT<false>&, const Vec2f &texCoord)
+{
+  return texCoord;
+}
+
 /** provides a class for the 3d render context.
  *
  * This is actually the 3d rendering engine managing
  * - rendering states
  * - output buffers
  * - rasterizing of triangles into output buffers.
+ *
+ * The render context owns a job system which is used for any parallel
+ * work (e.g. clearing of frame buffers, rasterizing in pipelined mode).
+ * Other subsystems should use it as well (see getJobSystem()).
+ *
+ * Optionally, the rasterizing may be done in parallel to the geometry
+ * stage (pipelined mode, see setRasterBands()).
  */
 class RenderContext {
   
@@ -38,9 +138,100 @@ class RenderContext {
       Blending, ///< alpha blending
       Texturing, ///< texturing
       Lighting, ///< lighting
+      Heatmap, ///< count writes per pixel (debug mode, see getHeatmap())
       NModes ///< number of modes
     };
 
+    /// kinds of per-pixel counters for heatmaps (see getHeatmap())
+    enum HeatKind {
+      HeatWrites, ///< fragments written to color buffer (overdraw)
+      HeatDepthFailed, ///< fragments discarded by depth test
+      HeatBlended, ///< fragments blended with color buffer
+      HeatFragments, ///< all fragments generated (cost)
+      NHeatKinds ///< number of kinds
+    };
+
+    /// pixel formats of color buffer
+    enum PixelFormat {
+      /// R in least significant byte, A in most significant byte
+      RGBA8888,
+      /** B in least significant byte, A in most significant byte,
+       * colors premultiplied with alpha
+       * (native format of QImage::Format_ARGB32_Premultiplied)
+       */
+      ARGB32Premultiplied
+    };
+
+    /** snapshot of the rendering states which may change between frames.
+     *
+     * It's used to hand over state changes from one thread (e.g. the GUI)
+     * to another thread which does the rendering (see getState() and
+     * setState()).
+     */
+    struct State {
+      Mat4x4f matProj; ///< projection matrix
+      Mat4x4f matCam; ///< camera matrix
+      Mat4x4f matModel; ///< model matrix
+      uint mode; ///< enabled modes (bit i set ... Mode i enabled)
+      float ambient; ///< ratio of ambient light
+      uint iTex; ///< index of current texture
+      uint32 rgbaClear; ///< clear color
+      uint nThreads; ///< number of worker threads of job system
+      bool pinThreads; ///< flag: true ... pin worker threads to cores
+      uint nRasterBands; ///< number of raster bands
+      uint widthVP; ///< width of viewport
+      uint heightVP; ///< height of viewport
+
+      /// returns whether a certain mode is enabled.
+      bool isEnabled(Mode mode) const
+      {
+        return (this->mode & (1 << mode)) != 0;
+      }
+      /// enables a certain mode.
+      void enable(Mode mode, bool enable = true)
+      {
+        (this->mode &= ~(1 << mode)) |= ((uint)enable << mode);
+      }
+    };
+
+    /** pipeline statistics (similar to pipeline statistics queries of
+     * OpenGL).
+     *
+     * The counters are only available if RENDER_STATS is enabled.
+     */
+    struct Stats {
+      uint64_t nVtcs; ///< vertices passed to drawVertex()
+      uint64_t nTris; ///< triangles assembled from vertices
+      uint64_t nTrisCulled; ///< triangles discarded by face culling
+      uint64_t nTrisClipped; ///< triangles discarded by clipping
+      uint64_t nTrisSplit; ///< additional triangles created by clipping
+      uint64_t nTrisRasterized; ///< triangles passed to rasterizer
+      uint64_t nFragments; ///< fragments (pixels) generated by rasterizer
+      uint64_t nFragsDepthFailed; ///< fragments failed in depth test
+      uint64_t nFragsBlended; ///< fragments blended with frame buffer
+
+      /// constructor (with all counters 0).
+      Stats():
+        nVtcs(0), nTris(0), nTrisCulled(0), nTrisClipped(0), nTrisSplit(0),
+        nTrisRasterized(0),
+        nFragments(0), nFragsDepthFailed(0), nFragsBlended(0)
+      { }
+
+      /// adds counters of other statistics.
+      Stats& operator+=(const Stats &stats)
+      {
+        nVtcs += stats.nVtcs; nTris += stats.nTris;
+        nTrisCulled += stats.nTrisCulled;
+        nTrisClipped += stats.nTrisClipped;
+        nTrisSplit += stats.nTrisSplit;
+        nTrisRasterized += stats.nTrisRasterized;
+        nFragments += stats.nFragments;
+        nFragsDepthFailed += stats.nFragsDepthFailed;
+        nFragsBlended += stats.nFragsBlended;
+        return *this;
+      }
+    };
+
   private:
 
     /// depth mode
@@ -50,11 +241,11 @@ class RenderContext {
       DepthCheckAndWrite ///< write and test depth values
     };
 
-    /// vertex
+    /// vertex (color first as Vec4f is 16 byte aligned, i.e. no padding)
     struct Vertex {
+      Vec4f color; ///< vertex color
       Vec3f coord; ///< 3d coordinate
       Vec3f normal; ///< vertex normal
-      Vec4f color; ///< vertex color
       Vec2f texCoord; ///< texture coordinates associated to vertex
 
       /// default constructor (leaving instance uninitialized)
@@ -63,7 +254,7 @@ class RenderContext {
       Vertex(
         const Vec3f &coord, const Vec3f &normal, const Vec4f &color,
         const Vec2f &texCoord):
-        coord(coord), normal(normal), color(color), texCoord(texCoord)
+        color(color), coord(coord), normal(normal), texCoord(texCoord)
       { }
       /// copy constructor.
       Vertex(const Vertex&) = default;
@@ -73,10 +264,66 @@ class RenderContext {
       ~Vertex() = default;
     };
 
+    /// triangle passed from geometry stage to raster stage
+    struct Triangle {
+      Vertex vtcs[3]; ///< vertices (in screen space)
+      uint iRasterize; ///< index of rasterize() flavor
+      uint iTex; ///< index of texture
+    };
+
+    /// type of rasterize() flavors
+    typedef void (RenderContext::*Rasterize)(
+      const Vertex vtcs[], uint nVtcs, uint iTex, int yMin, int yMax,
+      Stats &stats);
+
+    /// per-pixel counters (in Heatmap mode)
+    struct Heat {
+      uint32 nWrites; ///< fragments written
+      uint32 nDepthFailed; ///< fragments failed in depth test
+      uint32 nBlended; ///< fragments blended
+    };
+
+    /// render state as last recorded in API trace
+    struct TraceState {
+      Mat4x4f matProj; ///< projection matrix
+      Mat4x4f matCam; ///< camera matrix
+      Mat4x4f matModel; ///< model matrix
+      uint mode; ///< enabled modes
+      float ambient; ///< ratio of ambient light
+      uint iTex; ///< index of current texture
+      Vec3f normal; ///< current normal
+      Vec4f color; ///< current color
+      Vec2f texCoord; ///< current texture coordinate
+      uint32 rgbaClear; ///< clear color
+      uint width, height; ///< size of frame buffers
+    };
+
+    /// transformed vertices of a MeshSoA (see drawMesh(const MeshSoA&))
+    struct VtcsSoA {
+      std::vector<float> x, y, z; ///< coordinates (in clip space)
+      std::vector<std::uint8_t> outcodes; ///< outcodes (see Outcode)
+      std::vector<float> fFront, fBack; ///< factors of lighting
+    };
+
+    /// statistics of a raster job (padded to own cache lines)
+    struct StatsBand {
+      Stats stats; ///< statistics
+      char pad[128 - sizeof (Stats)]; ///< padding
+    };
+
+    /// table of rasterize() flavors
+    static const Rasterize _rasterizes[];
+
   // variables:
   private:
     /// width and height of frame buffers
     uint _width, _height;
+    /// width and height of viewport (i.e. of output)
+    uint _widthVP, _heightVP;
+    /// ratio of frame buffer size to viewport size in (0, 1]
+    float _renderScale;
+    /// pixel format of color buffer
+    const PixelFormat _format;
     /// current clear color
     uint32 _rgbaClear;
     /// current clear depth value
@@ -85,6 +332,7 @@ class RenderContext {
     struct FrameBuffer {
       std::vector<uint32> rgba; ///< frame buffer for colors
       std::vector<float> depth; ///< frame buffer for depth values
+      std::vector<Heat> heat; ///< per-pixel counters (in Heatmap mode)
       /// constructor.
       FrameBuffer(uint size, uint32 rgba, float depth):
         rgba(size, rgba), depth(size, depth)
@@ -131,8 +379,34 @@ class RenderContext {
     Vertex _vtcs[3 * (1 << 6)];
     /// number of accumulated vertices
     uint _nVtcs;
+    /// transformed vertices of drawMesh(const MeshSoA&) (kept for re-use)
+    VtcsSoA _vtcsSoA;
     /// render callback
     std::function<void(RenderContext&)> _cbRender;
+    /// job system for parallel work
+    JobSystem _jobs;
+    /// number of raster bands (0 ... pipelined mode disabled)
+    uint _nRasterBands;
+    /// ring of triangles for raster jobs (in pipelined mode only)
+    std::unique_ptr<RingT<Triangle>> _pRing;
+    /// flags: true ... raster job of band is submitted or running
+    std::unique_ptr<std::atomic<bool>[]> _rasterActive;
+    /// number of submitted or running raster jobs
+    std::atomic<uint> _nRasterJobs;
+    /// pipeline statistics (of geometry stage and non-pipelined mode)
+    Stats _stats;
+    /// pipeline statistics of raster jobs (in pipelined mode only)
+    std::unique_ptr<StatsBand[]> _statsBands;
+    /// profiler for timing of render stages
+    Profiler _profiler;
+    /// writer of API trace (nullptr ... not recording)
+    std::unique_ptr<ApiTraceWriter> _pApiTrace;
+    /// commands of current frame (while recording API trace)
+    std::unique_ptr<CommandBuffer> _pCmdsTrace;
+    /// flag: true ... recording commands of current frame
+    bool _tracingFrame;
+    /// render state as last recorded in API trace
+    TraceState _traceLast;
 
   // methods:
   public:
@@ -143,11 +417,15 @@ class RenderContext {
      *
      * @param width width of frame buffers (in pixels)
      * @param height height of frame buffers (in pixels)
+     * @param format pixel format of color buffer\n
+     *        The vertex colors, textures, and the clear color are
+     *        converted to this format.
+     *        Thus, the color buffer can be presented without conversion.
      */
-    RenderContext(uint width, uint height);
+    RenderContext(uint width, uint height, PixelFormat format = RGBA8888);
 
     /// destructor.
-    ~RenderContext() = default;
+    ~RenderContext();
 
     // disabled:
     RenderContext(const RenderContext&) = delete;
@@ -162,17 +440,94 @@ class RenderContext {
      *
      * @return width of viewport (in pixels)
      */
-    uint getViewportWidth() const { return _width; }
+    uint getViewportWidth() const { return _widthVP; }
     /** returns height of viewport.
      *
      * @return height of viewport (in pixels)
      */
-    uint getViewportHeight() const { return _height; }
+    uint getViewportHeight() const { return _heightVP; }
 
-    /** @todo future extension?
+    /** sets size of viewport.
+     *
+     * The frame buffers are resized to the new size (scaled by the
+     * render scale), and the screen matrix is adjusted accordingly.
+     * The contents of frame buffers are undefined afterwards
+     * (i.e. they have to be cleared before rendering).
+     * The capacity of frame buffers is kept when shrinking and grows
+     * geometrically when enlarging. Hence, resizing a window
+     * interactively doesn't allocate memory for every step.
+     *
+     * @note
+     * Must not be called while rendering (i.e. in render callback)
+     * except before anything is drawn into the frame (as the replay of
+     * an API trace does, see execute()).
+     *
+     * @param width new width of viewport (in pixels, at least 1)
+     * @param height new height of viewport (in pixels, at least 1)
      */
     void setViewport(uint width, uint height);
 
+    /** returns width of frame buffers.
+     *
+     * This is the width of viewport scaled by the render scale.
+     *
+     * @return width of frame buffers (in pixels)
+     */
+    uint getRenderWidth() const { return _width; }
+    /** returns height of frame buffers.
+     *
+     * This is the height of viewport scaled by the render scale.
+     *
+     * @return height of frame buffers (in pixels)
+     */
+    uint getRenderHeight() const { return _height; }
+
+    /** returns render scale.
+     *
+     * @return ratio of frame buffer size to viewport size
+     */
+    float getRenderScale() const { return _renderScale; }
+
+    /** sets render scale.
+     *
+     * The frame buffers are resized to the scaled viewport size
+     * (at least 1 x 1 pixels), and the screen matrix is adjusted
+     * accordingly.
+     * The output has to be scaled up to the viewport size afterwards
+     * (e.g. with scaleBilinear()).
+     * The capacity of frame buffers is kept, i.e. changing the scale
+     * below 1 doesn't allocate memory.
+     *
+     * @note
+     * Must not be called while rendering (i.e. in render callback).
+     *
+     * @param scale ratio of frame buffer size to viewport size
+     *        (clamped to range [0, 1])
+     */
+    void setRenderScale(float scale);
+
+    /** returns pixel format of color buffer.
+     *
+     * @return pixel format of color buffer
+     */
+    PixelFormat getPixelFormat() const { return _format; }
+
+    /** converts a color to a pixel value in format of color buffer.
+     *
+     * @param color the color (components in range [0, 1])
+     * @return pixel value
+     */
+    uint32 colorToPixel(const Vec4f &color) const;
+
+    /** converts a pixel value in format of color buffer to a color.
+     *
+     * This is the inverse of colorToPixel() (up to quantization).
+     *
+     * @param pixel the pixel value
+     * @return color (components in range [0, 1])
+     */
+    Vec4f pixelToColor(uint32 pixel) const;
+
     /** returns current projection matrix.
      *
      * @return current projection matrix
@@ -318,6 +673,48 @@ class RenderContext {
      */
     void drawVertex(const Vec3f &coord);
 
+    /** draws the triangles of a mesh.
+     *
+     * The draw path is compiled for the vertex type of the mesh:
+     * Attributes which the vertices don't provide (i.e. which are void
+     * in VERTEX) are replaced by the current normal, color, and texture
+     * coordinate once per mesh.
+     * Hence, e.g. for VertexC, there is no normal transformation,
+     * the lighting is computed once per mesh (for either side),
+     * and the clip stage neither copies nor interpolates colors and
+     * texture coordinates (see ClipVertexT).
+     * All vertices are transformed with one matrix which includes the
+     * decoding of quantized coordinates (see CoordQuant).
+     * The result is the same as with drawVertex() for every vertex.
+     *
+     * @note
+     * While an API trace is recorded, drawVertex() is used instead
+     * (to record the vertices).
+     *
+     * @param mesh the mesh to draw (indexed or non-indexed)
+     */
+    template <typename VERTEX, typename INDEX>
+    void drawMesh(const MeshT<VERTEX, INDEX> &mesh);
+
+    /** draws the triangles of a mesh with a structure of arrays.
+     *
+     * The vertices are transformed and lit once per vertex (instead of
+     * once per index) in batches of 8 or 16 with AVX2 or AVX-512 (see
+     * transformPoints() and lightNormals()).
+     * Triangles with all vertices outside of the same clip plane are
+     * rejected by their outcodes, triangles with all vertices inside
+     * are not clipped at all.
+     * Missing normals and texture coordinates are replaced by the
+     * current ones (as in drawMesh() for other vertex types).
+     *
+     * @note
+     * While an API trace is recorded, drawVertex() is used instead
+     * (to record the vertices).
+     *
+     * @param mesh the mesh to draw (indexed or non-indexed)
+     */
+    void drawMesh(const MeshSoA &mesh);
+
     /** loads a texture from an image.
      *
      * @param width width of image (must be a power of 2)
@@ -358,6 +755,17 @@ class RenderContext {
      */
     void clear(bool rgba, bool depth);
 
+    /** returns a snapshot of the current rendering states.
+     *
+     * @return current rendering states
+     */
+    State getState() const;
+    /** sets all rendering states of a snapshot.
+     *
+     * @param state the rendering states to set
+     */
+    void setState(const State &state);
+
     /** sets render callback.
      *
      * @param cbRender the render callback
@@ -368,17 +776,197 @@ class RenderContext {
     }
 
     /** calls render callback.
+     *
+     * The pipeline statistics are reset before.
+     * In pipelined mode, finish() is called afterwards.
+     * If profiling is enabled, the whole call is timed as frame.
+     */
+    void render();
+
+    /** returns the pipeline statistics counted since last resetStats().
+     *
+     * @note
+     * In pipelined mode, call finish() before.
+     *
+     * @return pipeline statistics\n
+     *         (All counters are 0 if RENDER_STATS is disabled.)
+     */
+    Stats getStats() const;
+
+    /** resets the pipeline statistics.
+     *
+     * In pipelined mode, finish() is called before.
+     */
+    void resetStats();
+
+    /** returns the profiler for timing of render stages.
+     *
+     * The profiling is disabled initially.
+     *
+     * @return profiler
+     */
+    Profiler& getProfiler() { return _profiler; }
+
+    /** returns name of a rasterize() flavor.
+     *
+     * The index of the flavor is passed to the profiler as state
+     * combination (see Profiler::getPerfSummary()).
+     *
+     * @param i index of flavor
+     * @return name of flavor (e.g. "DepthTest+Smooth")
+     */
+    static std::string getRasterizeName(uint i);
+
+    /** renders a heatmap of per-pixel counters as false color image.
+     *
+     * The counters are accumulated while Heatmap mode is enabled and
+     * reset with clearing of color buffer (see clear()).
+     * Untouched pixels are black, the counted pixels are colored from blue
+     * (1) over cyan, green, and yellow to red (max.).
+     *
+     * @note
+     * In pipelined mode, call finish() before.
+     *
+     * @param kind the kind of counters
+     * @param img storage for image (in pixel format of color buffer)
+     * @param max value mapped to red (0 ... max. of counters)
+     * @return value mapped to red (0 if Heatmap mode not enabled)
+     */
+    uint getHeatmap(
+      HeatKind kind, std::vector<uint32> &img, uint max = 0) const;
+
+    /** returns a per-pixel counter.
+     *
+     * @param kind the kind of counter
+     * @param x the x coordinate of pixel
+     * @param y the y coordinate of pixel
+     * @return value of counter (0 if Heatmap mode not enabled)
+     */
+    uint getHeat(HeatKind kind, uint x, uint y) const
+    {
+      return _fb.heat.empty() ? 0 : getHeat(kind, _fb.heat[getFBI(x, y)]);
+    }
+
+    /** returns the job system of render context.
+     *
+     * @return job system
+     */
+    JobSystem& getJobSystem() { return _jobs; }
+
+    /** changes the number of worker threads of job system.
+     *
+     * @param nThreads number of worker threads
+     * @param pin flag: true ... pin each worker thread to a core
+     */
+    void setThreads(uint nThreads, bool pin = false);
+
+    /** returns number of raster bands.
+     *
+     * @return number of raster bands\n
+     *         0 ... pipelined mode disabled
+     */
+    uint getRasterBands() const { return _nRasterBands; }
+
+    /** sets number of raster bands.
+     *
+     * In pipelined mode, drawVertex() does the transformations, lighting,
+     * and clipping in the calling thread but passes the resulting
+     * triangles through a bounded ring to raster jobs.
+     * There is one raster job per horizontal band of the frame buffer.
+     * The raster jobs are executed by the job system.
+     * If the ring is full, drawVertex() waits for the raster jobs.
+     *
+     * @note
+     * In pipelined mode, finish() has to be called before the contents
+     * of frame buffer are accessed (e.g. with getRGBA()).
+     *
+     * @param nBands number of raster bands\n
+     *        0 ... disable pipelined mode
      */
-    void render() { _cbRender(*this); }
+    void setRasterBands(uint nBands);
+
+    /** waits until all pending triangles are rasterized.
+     *
+     * In non-pipelined mode, this does nothing.
+     */
+    void finish();
+
+    /** replays the commands recorded in a command buffer.
+     *
+     * @param cmdBuf the command buffer to replay
+     */
+    void execute(const CommandBuffer &cmdBuf);
+
+    /** replays the commands recorded in multiple command buffers.
+     *
+     * The command buffers are replayed in the order of their storage.
+     * Thereby, any state set in one command buffer is effective in the
+     * following ones.
+     *
+     * @param cmdBufs the command buffers to replay
+     */
+    void execute(const std::vector<CommandBuffer> &cmdBufs);
 
     /** returns the start address of RGBA frame buffer.
+     *
+     * @note
+     * In pipelined mode, call finish() before.
      *
      * @return start address of RGBA frame buffer\n
-     *         Each element stores R (red) in the least significant byte,
-     *         A (alpha) in the most significant.
+     *         Each element stores a pixel in the format returned by
+     *         getPixelFormat().
      */
     const uint32* getRGBA() const { return _fb.rgba.data(); }
 
+    /** exchanges the RGBA frame buffer with another buffer.
+     *
+     * This hands over the rendered image without copying (e.g. to
+     * present it in another thread while the next frame is rendered).
+     * The contents of the RGBA frame buffer are undefined afterwards.
+     *
+     * @note
+     * In pipelined mode, finish() is called before.
+     *
+     * @param rgba the buffer to exchange with
+     *        (resized to the size of frame buffer if necessary)
+     */
+    void swapRGBA(std::vector<uint32> &rgba);
+
+    //@}
+  public:
+    /// @name API Trace
+    //@{
+
+    /** starts recording of API calls into a trace file.
+     *
+     * All frames rendered with render() are recorded (with their complete
+     * render state and all drawVertex() and clear() calls) as well as all
+     * textures (the already loaded ones and those loaded with loadTex()).
+     * The render state includes the size of frame buffers as viewport,
+     * i.e. resizing and changes of render scale are replayed (at scale 1).
+     * The trace can be replayed with ApiTraceReader and execute()
+     * (see noGL3dReplay).
+     *
+     * @param file path of trace file
+     * @return true ... recording started\n
+     *         false ... file not writable
+     */
+    bool startApiTrace(const std::string &file);
+
+    /** stops recording of API calls.
+     *
+     * @return true ... trace completely written\n
+     *         false ... write error (or not recording)
+     */
+    bool stopApiTrace();
+
+    /** returns whether API calls are recorded.
+     *
+     * @return true ... recording\n
+     *         false ... otherwise
+     */
+    bool isApiTracing() const { return _pApiTrace != nullptr; }
+
     //@}
   private:
     /// @name Internal Stuff
@@ -395,8 +983,121 @@ class RenderContext {
     Vertex lerpVtx(
       const Vertex &vtx0, const Vertex &vtx1, float f);
 
+    /** interpolates a vertex of the clip stage of drawMesh()
+     * between two vertices according to a factor.
+     *
+     * @param vtx0 1st vertex
+     * @param vtx1 2nd vertex
+     * @param f interpolation factor in range [0, 1]
+     * @return interpolated vertex
+     */
+    template <bool COLOR, bool TEX>
+    ClipVertexT<COLOR, TEX> lerpVtx(
+      const ClipVertexT<COLOR, TEX> &vtx0,
+      const ClipVertexT<COLOR, TEX> &vtx1, float f);
+
+    /** returns a color converted to the order of the color buffer.
+     *
+     * @param color the color (RGBA)
+     * @return the color with swapped red and blue (if needed)
+     */
+    Vec4f getColorFmt(const Vec4f &color) const
+    {
+      return _format == ARGB32Premultiplied // swap red and blue
+        ? Vec4f(color.z, color.y, color.x, color.w) : color;
+    }
+
+    /** computes the lit color of a vertex.
+     *
+     * @param color the vertex color
+     * @param normal the vertex normal (in world space)
+     * @param light the light vector
+     * @param ambient ratio of ambient light
+     * @return the lit color (alpha is unaffected)
+     */
+    static Vec4f lighting(
+      const Vec4f &color, const Vec3f &normal,
+      const Vec3f &light, const float ambient)
+    {
+      float f = dot(light, normal);
+      if (f < 0.0f) f = 0.0f;
+      f = ambient + (1.0f - ambient) * f;
+      return Vec4f(color.x * f, color.y * f, color.z * f, color.w);
+    }
+
+    /** draws the triangles of a mesh (see drawMesh()).
+     *
+     * @tparam COLOR flag: true ... color varies per vertex
+     *
+     * @param mesh the mesh to draw
+     */
+    template <bool COLOR, typename VERTEX, typename INDEX>
+    void drawMeshT(const MeshT<VERTEX, INDEX> &mesh);
+
+    /** draws the triangles of a mesh with a structure of arrays (see
+     * drawMesh(const MeshSoA&)).
+     *
+     * @tparam COLOR flag: true ... color varies per vertex (lit normals)
+     * @tparam TEX flag: true ... texture coordinates provided per vertex
+     *
+     * @param mesh the mesh to draw
+     */
+    template <bool COLOR, bool TEX>
+    void drawMeshSoAT(const MeshSoA &mesh);
+
+    /** clips triangles on all 6 planes of clip space.
+     *
+     * @param vtcs the vertices of triangles to clip (with room for the
+     *        triangles resulting from splits)
+     * @param nVtcs number of vertices of triangles to clip
+     * @return number of vertices of resulting triangles
+     */
+    template <typename VTX>
+    uint clip(VTX vtcs[], uint nVtcs);
+
+    /** transforms triangles of _vtcs into screen space and rasterizes
+     * them (or passes them to raster jobs in pipelined mode).
+     *
+     * @param nVtcs number of vertices of triangles
+     * @param timer timer of current render stage (stopped before
+     *        rasterizing)
+     */
+    void rasterizeTris(uint nVtcs, Profiler::Timer &timer);
+
+    /** clips a triangle of drawMesh() and rasterizes the result.
+     *
+     * @param vtcs the vertices of the triangle (with room for the
+     *        triangles resulting from splits)
+     * @param color the color of vertices (if not varying per vertex)
+     * @param timer timer of current render stage
+     * @param inside flag: true ... triangle is inside of clip space
+     *        (i.e. clipping is skipped)
+     */
+    template <bool COLOR, bool TEX>
+    void clipAndRasterize(
+      ClipVertexT<COLOR, TEX> vtcs[], const Vec4f &color,
+      Profiler::Timer &timer, bool inside = false);
+
+    /** records render state into command buffer of API trace.
+     *
+     * @param all flag: true ... record complete state,
+     *        false ... record changes since last call only
+     */
+    void traceState(bool all);
+
+    /** resizes the frame buffers and adjusts the screen matrix.
+     *
+     * The capacity of frame buffers is kept when shrinking and grows
+     * geometrically when enlarging.
+     *
+     * @param width new width of frame buffers
+     * @param height new height of frame buffers
+     */
+    void resizeFrameBuffers(uint width, uint height);
+
     /** clips a triangle on a certain plane.
      *
+     * @param vtcs the vertices (_vtcs or of clip stage of drawMesh())
      * @param plane the plane to clip triangle on
      * @param iVtx0 start index of triangle vertices to clip
      * @param iVtx3 start index of 2nd triangle
@@ -408,7 +1109,8 @@ class RenderContext {
      *               stored at @a iVtx0\n
      *         2 ... 2 triangles stored at @a iVtx0 and @a iVtx3
      */
-    uint clipTri(const Planef &plane, uint iVtx0, uint iVtx3);
+    template <typename VTX>
+    uint clipTri(VTX vtcs[], const Planef &plane, uint iVtx0, uint iVtx3);
 
     /** returns frame buffer index for a certain row.
      *
@@ -425,24 +1127,189 @@ class RenderContext {
      */
     uint getFBI(uint x, uint y) const { return y * _width + x; }
 
+    /** returns index of rasterize() flavor for current mode.
+     *
+     * @return index in _rasterizes
+     */
+    uint getIRasterize() const
+    {
+      const uint heat = (_mode & 1 << Heatmap) != 0;
+      const uint tex = (_mode & 1 << Texturing) != 0;
+      const uint blend = (_mode & 1 << Blending) != 0;
+      const uint smooth = (_mode & 1 << Smooth) != 0;
+      const uint depthMode
+        = (_mode & 1 << DepthBuffer) != 0
+        ? (_mode & 1 << DepthTest) != 0
+        ? DepthCheckAndWrite : DepthWrite : NoDepth;
+      return ((((heat * 2) + tex) * 2 + blend) * 2 + smooth) * 3 + depthMode;
+    }
+
     /** rasterizes triangles.
      *
      * @tparam DEPTH_MODE the depth mode
      * @tparam SMOOTH flag: true ... enable color interpolation
      * @tparam BLEND flag: true ... enable alpha blending
      * @tparam TEX flag: true ... enable texture sampling
+     * @tparam HEAT flag: true ... enable per-pixel counters
      *
-     * @param nVtcs number of vertices for triangles to rasterize\n
+     * @param vtcs vertices of triangles to rasterize\n
      *        These vertices are expected to be in screen space.
+     * @param nVtcs number of vertices for triangles to rasterize
+     * @param iTex index of texture to sample
+     * @param yMin first row to rasterize
+     * @param yMax row after last row to rasterize
+     * @param stats pipeline statistics to count fragments in
      */
     template <
       DepthMode DEPTH_MODE,
       bool SMOOTH,
       bool BLEND,
-      bool TEX>
-    void rasterize(uint nVtcs);
+      bool TEX,
+      bool HEAT>
+    void rasterize(
+      const Vertex vtcs[], uint nVtcs, uint iTex, int yMin, int yMax,
+      Stats &stats);
+
+    /** returns a per-pixel counter.
+     *
+     * @param kind the kind of counter
+     * @param heat the per-pixel counters
+     * @return value of counter
+     */
+    static uint getHeat(HeatKind kind, const Heat &heat)
+    {
+      switch (kind) {
+        case HeatWrites: return heat.nWrites;
+        case HeatDepthFailed: return heat.nDepthFailed;
+        case HeatBlended: return heat.nBlended;
+        case HeatFragments: return heat.nWrites + heat.nDepthFailed;
+        default: return 0;
+      }
+    }
+
+    /** processes triangles of ring for a band (in raster job).
+     *
+     * @param iBand index of band
+     * @param nBands number of bands
+     */
+    void rasterizeRing(uint iBand, uint nBands);
+
+    /** calls rasterizeRing() (for use as job).
+     *
+     * @param pCtx the render context
+     * @param iBand index of band
+     * @param nBands number of bands
+     */
+    static void rasterizeRingJob(void *pCtx, size_t iBand, size_t nBands)
+    {
+      ((RenderContext*)pCtx)->rasterizeRing((uint)iBand, (uint)nBands);
+    }
+
+    /** helps raster jobs while waiting for them.
+     */
+    void waitRaster() { if (!_jobs.runOne()) std::this_thread::yield(); }
 
     //@}
 };
 
+template <typename VERTEX, typename INDEX>
+void RenderContext::drawMesh(const MeshT<VERTEX, INDEX> &mesh)
+{
+  assert(_nVtcs == 0);
+  if (_tracingFrame) { // draw (and record) vertex by vertex
+    const Vec3f normal = _normal;
+    const Vec4f color = _color;
+    const Vec2f texCoord = _texCoord;
+    for (size_t i = 0, n = 3 * getNTris(mesh); i < n; ++i) {
+      const VERTEX &vtx = getTriVtx(mesh, i);
+      loadNormal<VERTEX>(vtx, _normal);
+      loadColor<VERTEX>(vtx, _color);
+      loadTexCoord<VERTEX>(vtx, _texCoord);
+      drawVertex(decodeCoord(mesh, vtx.coord));
+    }
+    _normal = normal; _color = color; _texCoord = texCoord;
+    return;
+  }
+  // colors vary per vertex with vertex colors or with lit normals
+  if (!std::is_void<typename VERTEX::Color>::value
+    || (!std::is_void<typename VERTEX::Normal>::value
+      && isEnabled(Lighting))) {
+    drawMeshT<true>(mesh);
+  } else drawMeshT<false>(mesh);
+}
+
+template <bool COLOR, typename VERTEX, typename INDEX>
+void RenderContext::drawMeshT(const MeshT<VERTEX, INDEX> &mesh)
+{
+  enum {
+    Normal = !std::is_void<typename VERTEX::Normal>::value,
+    Color = !std::is_void<typename VERTEX::Color>::value,
+    Tex = !std::is_void<typename VERTEX::TexCoord>::value
+  };
+  const uint iRasterize = getIRasterize();
+  const bool lit = isEnabled(Lighting);
+  const Mat4x4f matMVP
+    = fuseCoordDecode(_matProj * _matView * _matModel, mesh);
+  // current attributes (for the ones which the vertices don't provide)
+  const Vec4f color = getColorFmt(_color);
+  const Vec3f normal = transformVec(_matModel, _normal);
+  // color of vertices without color and normal (of front and back side)
+  const Vec4f colorsSide[2] = {
+    lit ? lighting(color, normal, _light, _ambient) : color,
+    lit ? lighting(color, normal, -_light, _ambient) : color
+  };
+  // vertices of triangle (and of triangles resulting from clipping)
+  ClipVertexT<COLOR, Tex> vtcs[3 * (1 << 6)];
+  for (size_t i = 0, n = 3 * getNTris(mesh); i < n; i += 3) {
+    Profiler::Timer timer(_profiler, Profiler::Transform, iRasterize);
+#if RENDER_STATS
+    _stats.nVtcs += 3; ++_stats.nTris;
+#endif // RENDER_STATS
+    const VERTEX *const pVtcs[3] = {
+      &getTriVtx(mesh, i + 0), &getTriVtx(mesh, i + 1),
+      &getTriVtx(mesh, i + 2)
+    };
+    for (uint j = 0; j < 3; ++j) {
+      vtcs[j].coord = transformPoint(matMVP, decode(pVtcs[j]->coord));
+    }
+    // face-culling (as in drawVertex())
+    const Vec3f normalFace
+      = cross(vtcs[1].coord - vtcs[0].coord, vtcs[1].coord - vtcs[2].coord);
+    const bool back = normalFace.z > 0;
+    if (!isEnabled(back ? BackSide : FrontSide)) {
+#if RENDER_STATS
+      ++_stats.nTrisCulled;
+#endif // RENDER_STATS
+      continue;
+    }
+    // attributes which vary per vertex
+    for (uint j = 0; j < 3; ++j) {
+      if (COLOR) {
+        Vec4f colorVtx = color;
+        if (Color) {
+          loadColor<VERTEX>(*pVtcs[j], colorVtx);
+          colorVtx = getColorFmt(colorVtx);
+        }
+        if (lit) {
+          Vec3f normalVtx = normal;
+          if (Normal) {
+            loadNormal<VERTEX>(*pVtcs[j], normalVtx);
+            normalVtx = transformVec(_matModel, normalVtx);
+          }
+          colorVtx
+            = lighting(colorVtx, normalVtx, back ? -_light : _light, _ambient);
+        }
+        setClipColor(vtcs[j], colorVtx);
+      }
+      if (Tex) {
+        Vec2f texCoord = _texCoord;
+        loadTexCoord<VERTEX>(*pVtcs[j], texCoord);
+        setClipTexCoord(vtcs[j], texCoord);
+      }
+    }
+    timer.next(Profiler::Clip);
+    clipAndRasterize(vtcs, colorsSide[back], timer);
+  }
+}
+
 #endif // RENDER_CONTEXT_H
\ No newline at end of file
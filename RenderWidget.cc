@@ -1,16 +1,149 @@
+#include <chrono>
+
 #include <QtWidgets>
 
+#include "color.h"
 #include "RenderWidget.h"
 
+RenderWidget::RenderWidget(RenderContext &context, QWidget *pQParent):
+  QWidget(pQParent),
+  _context(context),
+  _centerOrbit(0.0f, 0.0f, 0.0f),
+  _state(context.getState()),
+  _states(_state),
+  _requested(false), _busy(false), _exit(false),
+  _pending(false), _dtFrame(0.0),
+  _heatKind(RenderContext::HeatFragments),
+  _dtBudget(0.0)
+{
+  _threadRender = std::thread(&RenderWidget::runRender, this);
+}
+
+RenderWidget::~RenderWidget()
+{
+  stopRender();
+}
+
+void RenderWidget::requestRender()
+{
+  // fold all requests until return to event loop into one
+  if (_pending) return;
+  _pending = true;
+  QMetaObject::invokeMethod(this, [this]() { submitRender(); },
+    Qt::QueuedConnection);
+}
+
+void RenderWidget::submitRender()
+{
+  _pending = false;
+  _states.back() = _state;
+  _states.publish();
+  std::lock_guard<std::mutex> lock(_lockRender);
+  _requested = true;
+  _wakeRender.notify_one();
+}
+
+void RenderWidget::waitRender()
+{
+  std::unique_lock<std::mutex> lock(_lockRender);
+  while (_requested || _busy) _idleRender.wait(lock);
+}
+
+void RenderWidget::stopRender()
+{
+  if (!_threadRender.joinable()) return; // already stopped
+  { std::lock_guard<std::mutex> lock(_lockRender);
+    _exit = true;
+    _wakeRender.notify_one();
+  }
+  _threadRender.join();
+}
+
+void RenderWidget::runRender()
+{
+  for (;;) {
+    { std::unique_lock<std::mutex> lock(_lockRender);
+      _busy = false; _idleRender.notify_all();
+      while (!_requested && !_exit) _wakeRender.wait(lock);
+      if (_exit) break;
+      // all requests until now are folded into this frame
+      _requested = false; _busy = true;
+    }
+    // apply latest state
+    if (_states.update()) _context.setState(_states.front());
+    // apply render scale for frame time budget
+    const double dtBudget = _dtBudget;
+    if (dtBudget != _dynRes.getBudget()) {
+      _dynRes.setBudget(dtBudget); _dynRes.reset();
+    }
+    _context.setRenderScale(dtBudget > 0.0 ? _dynRes.getScale() : 1.0f);
+    // render and hand over image
+    const std::chrono::steady_clock::time_point tStart
+      = std::chrono::steady_clock::now();
+    _context.render();
+    Frame &frame = _frames.back();
+    if (_context.isEnabled(RenderContext::Heatmap)) { // present heatmap
+      _context.getHeatmap(
+        (RenderContext::HeatKind)_heatKind.load(), frame.rgba);
+    } else _context.swapRGBA(frame.rgba);
+    frame.width = _context.getRenderWidth();
+    frame.height = _context.getRenderHeight();
+    frame.widthVP = _context.getViewportWidth();
+    frame.heightVP = _context.getViewportHeight();
+    _frames.publish();
+    const double dt = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - tStart).count();
+    if (dtBudget > 0.0) _dynRes.update(dt);
+    QMetaObject::invokeMethod(this,
+      [this, dt]() {
+        _dtFrame = dt;
+        update();
+        for (const auto &func : sigFrameDone) if (func) func();
+      },
+      Qt::QueuedConnection);
+  }
+}
+
+QImage RenderWidget::getImage()
+{
+  const Frame &frame = _frames.front();
+  if (!frame.width) return QImage(); // no frame yet
+  const uint width = frame.widthVP, height = frame.heightVP;
+  const uint32 *rgba = frame.rgba.data();
+  if (frame.width != width || frame.height != height) {
+    // scale up image of lowered render scale
+    _rgbaScaled.resize((size_t)width * height);
+    scaleBilinear(frame.width, frame.height, rgba,
+      width, height, _rgbaScaled.data());
+    rgba = _rgbaScaled.data();
+  }
+  // ARGB32 premultiplied is blitted without conversion
+  return QImage((const uchar*)rgba, width, height,
+    _context.getPixelFormat() == RenderContext::ARGB32Premultiplied
+    ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGBA8888);
+}
+
 void RenderWidget::paintEvent(QPaintEvent*)
 {
+  _frames.update();
+  Profiler::Timer timer(_context.getProfiler(), Profiler::Present);
+  const QImage qImg = getImage();
+  if (qImg.isNull()) return; // no frame yet
   QPainter qPainter(this);
-  const QImage qImg((uchar*)_context.getRGBA(),
-    _context.getViewportWidth(), _context.getViewportHeight(),
-    QImage::Format_RGBA8888);
   qPainter.drawImage(0, 0, qImg);
 }
 
+void RenderWidget::resizeEvent(QResizeEvent *pQEvent)
+{
+  const QSize size = pQEvent->size();
+  if (size.isEmpty()) return; // keep last viewport (e.g. while minimized)
+  _state.widthVP = (uint)size.width();
+  _state.heightVP = (uint)size.height();
+  // let listeners adapt the state (e.g. aspect ratio of projection)
+  for (const auto &func : sigViewportChanged) if (func) func();
+  requestRender();
+}
+
 void RenderWidget::mousePressEvent(QMouseEvent *pQEvent)
 {
   if (pQEvent->button() == Qt::LeftButton) {
@@ -28,17 +161,17 @@ void RenderWidget::mouseMoveEvent(QMouseEvent *pQEvent)
       (float)(pQEvent->pos().y() - _posNavLast.y()) / height());
     if (1.0f * manhattan(d) > 1E-10) {
       // retrieve camera matrix
-      const Mat4x4f &mat = _context.getCamMat();
+      const Mat4x4f mat = _state.matCam;
       const Vec3f right(mat._00, mat._10, mat._20);
       const Vec3f up(mat._01, mat._11, mat._21);
       // determine rotation axis for orbit navigation
       const Vec3f axis = normalize(d.y * right + d.x * up);
-      _context.setCamMat(
-        Mat4x4f(InitTrans, _centerOrbit)
+      _state.matCam
+        = Mat4x4f(InitTrans, _centerOrbit)
         * Mat4x4f(InitRot, axis, -2.0f * (float)Pi * length(d))
         * Mat4x4f(InitTrans, -_centerOrbit)
-        * mat);
-      _context.render();
+        * mat;
+      requestRender();
       // signal change of camera matrix
       for (const auto &func : sigMatCamChanged) if (func) func();
       // post-processing
@@ -1,46 +1,141 @@
 #ifndef RENDER_WIDGET_H
 #define RENDER_WIDGET_H
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include <QImage>
 #include <QWidget>
 
+#include "DynamicResolution.h"
 #include "RenderContext.h"
+#include "TripleBuffer.h"
 
-
+/* The rendering is done in a dedicated render thread:
+ * The GUI thread changes the state (see getState()) and calls
+ * requestRender(). The render thread applies the latest state, renders,
+ * and swaps the rendered image into a triple buffer. paintEvent()
+ * presents the latest completed image. Thus, the GUI never waits for a
+ * frame.
+ *
+ * Frame scheduling:
+ * All requests of one GUI event are folded into one request which is
+ * handed over when control returns to the event loop. Requests which
+ * arrive while a frame is rendered are folded into the next frame.
+ * Without requests, the render thread sleeps.
+ *
+ * Dynamic resolution:
+ * With a frame time budget, the render thread lowers the render scale
+ * of the context when frames take too long (and raises it again when
+ * there is headroom). paintEvent() scales smaller images up to the
+ * viewport size.
+ *
+ * Resizing:
+ * resizeEvent() passes the new size as viewport with the state to the
+ * render thread. The frame buffers keep their capacity when shrinking.
+ */
 class RenderWidget: public QWidget {
   private:
     RenderContext &_context;
     Vec3f _centerOrbit;
     QPoint _posNavLast;
+    // rendering state (changed in GUI thread only)
+    RenderContext::State _state;
+    // states handed over from GUI thread to render thread
+    TripleBufferT<RenderContext::State> _states;
+    // image handed over from render thread to GUI thread
+    struct Frame {
+      std::vector<uint32> rgba;
+      uint width = 0, height = 0; // size of rgba
+      uint widthVP = 0, heightVP = 0; // size of viewport
+    };
+    TripleBufferT<Frame> _frames;
+    // presented image scaled up to viewport size (in GUI thread)
+    std::vector<uint32> _rgbaScaled;
+    // render thread and its synchronization
+    std::mutex _lockRender;
+    std::condition_variable _wakeRender, _idleRender;
+    bool _requested, _busy, _exit;
+    std::thread _threadRender;
+    // flag: true ... request pending in GUI thread (not yet handed over)
+    bool _pending;
+    // duration of last presented frame (in s)
+    double _dtFrame;
+    // kind of heatmap presented in Heatmap mode
+    std::atomic<uint> _heatKind;
+    // frame time budget (in s, 0 ... disabled)
+    std::atomic<double> _dtBudget;
+    // controller of render scale (in render thread)
+    DynamicResolution _dynRes;
 
   public:
     std::vector<std::function<void()>> sigMatCamChanged;
+    // signaled (in GUI thread) when the viewport is resized
+    std::vector<std::function<void()>> sigViewportChanged;
+    // signaled (in GUI thread) when a rendered frame is presented
+    std::vector<std::function<void()>> sigFrameDone;
 
   public:
     explicit RenderWidget(
-      RenderContext &context, QWidget *pQParent = nullptr):
-      QWidget(pQParent),
-      _context(context),
-      _centerOrbit(0.0f, 0.0f, 0.0f)
-    { }
-    virtual ~RenderWidget() = default;
+      RenderContext &context, QWidget *pQParent = nullptr);
+    virtual ~RenderWidget();
     RenderWidget(const RenderWidget&) = delete;
     RenderWidget& operator=(const RenderWidget&) = delete;
 
   public:
     virtual QSize sizeHint() const override
     {
-      return QSize(
-        _context.getViewportWidth(), _context.getViewportHeight());
+      return QSize(_state.widthVP, _state.heightVP);
+    }
+
+    // returns the rendering state to change (in GUI thread)
+    RenderContext::State& getState() { return _state; }
+
+    // requests a frame with the current state
+    void requestRender();
+
+    // returns duration of last presented frame (in s)
+    double getFrameTime() const { return _dtFrame; }
+
+    // waits until the render thread is idle
+    void waitRender();
+
+    // stops the render thread (at latest in destructor)
+    // (Owners have to call it before members used in the render callback
+    // are destroyed.)
+    void stopRender();
+
+    // sets kind of heatmap presented in Heatmap mode
+    void setHeatKind(RenderContext::HeatKind kind)
+    {
+      _heatKind = kind; requestRender();
+    }
+
+    // sets frame time budget (in s, 0 ... full resolution always)
+    void setFrameBudget(double dt)
+    {
+      _dtBudget = dt; requestRender();
     }
 
+    // returns presented image (sharing data until next frame is presented)
+    QImage getImage();
+
   protected:
     virtual void paintEvent(QPaintEvent *pQEvent) override;
+    virtual void resizeEvent(QResizeEvent *pQEvent) override;
     virtual void mousePressEvent(QMouseEvent *pQEvent) override;
     virtual void mouseMoveEvent(QMouseEvent *pQEvent) override;
     //virtual void mouseReleaseEvent(QMouseEvent *pQEvent) override;
+
+  private:
+    // hands over the state to the render thread
+    void submitRender();
+
+    void runRender();
 };
 
 #endif // RENDER_WIDGET_H
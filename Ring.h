@@ -0,0 +1,173 @@
+/** @file
+ * interface of class template RingT
+ */
+
+#ifndef RING_H
+#define RING_H
+
+// standard C++ header:
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// own header:
+#include "util.h"
+
+/** provides a bounded lock-free ring buffer with one writer and
+ * multiple readers.
+ *
+ * Every reader sees every element (i.e. the elements are broadcast to
+ * all readers).
+ * An element is overwritten not before all readers have consumed it.
+ * Thus, the writer is throttled by the slowest reader (back-pressure).
+ *
+ * None of the methods blocks.
+ * It's up to the caller what to do meanwhile if the ring is full or
+ * empty.
+ *
+ * @tparam ELEMENT the type of elements
+ */
+template <typename ELEMENT>
+class RingT {
+
+  // types:
+  public:
+    typedef ELEMENT Element;
+
+  private:
+    /// read position of a reader (padded to an own cache line)
+    struct Reader {
+      std::atomic<size_t> i; ///< index of next element to read
+      char pad[64 - sizeof (std::atomic<size_t>)]; ///< padding
+    };
+
+  // variables:
+  private:
+    /// storage of elements
+    std::vector<Element> _elements;
+    /// mask to map indices to storage (size of storage - 1)
+    size_t _mask;
+    /// index of next element to write (only changed by writer)
+    std::atomic<size_t> _iWrite;
+    /// cached minimum of read positions (only used by writer)
+    size_t _iReadMin;
+    /// read positions of readers
+    std::unique_ptr<Reader[]> _readers;
+    /// number of readers
+    uint _nReaders;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /** constructor.
+     *
+     * @param size number of elements (must be a power of 2)
+     * @param nReaders number of readers
+     */
+    RingT(size_t size, uint nReaders):
+      _elements(size), _mask(size - 1),
+      _iWrite(0), _iReadMin(0),
+      _readers(new Reader[nReaders]), _nReaders(nReaders)
+    {
+      assert(size > 0 && (size & _mask) == 0);
+      for (uint i = 0; i < _nReaders; ++i) _readers[i].i = 0;
+    }
+
+    /// destructor.
+    ~RingT() = default;
+
+    // disabled:
+    RingT(const RingT&) = delete;
+    RingT& operator=(const RingT&) = delete;
+
+    //@}
+  public:
+    /// @name Writer Side
+    //@{
+
+    /** returns the next element to write.
+     *
+     * The element becomes visible to the readers with commit().
+     *
+     * @return element to fill\n
+     *         nullptr ... ring is full
+     */
+    Element* push()
+    {
+      const size_t iWrite = _iWrite.load(std::memory_order_relaxed);
+      if (iWrite - _iReadMin > _mask) {
+        _iReadMin = getReadMin();
+        if (iWrite - _iReadMin > _mask) return nullptr;
+      }
+      return &_elements[iWrite & _mask];
+    }
+
+    /** publishes the element returned by last push().
+     */
+    void commit() { _iWrite.fetch_add(1, std::memory_order_seq_cst); }
+
+    /** returns whether all readers have consumed all elements.
+     *
+     * @return true ... all elements consumed\n
+     *         false ... otherwise
+     */
+    bool drained() const
+    {
+      return getReadMin() == _iWrite.load(std::memory_order_relaxed);
+    }
+
+    //@}
+  public:
+    /// @name Reader Side
+    //@{
+
+    /** returns the next element for a reader.
+     *
+     * @param iReader index of reader
+     * @return next element to read\n
+     *         nullptr ... no element available
+     */
+    const Element* front(uint iReader) const
+    {
+      assert(iReader < _nReaders);
+      const size_t iRead
+        = _readers[iReader].i.load(std::memory_order_relaxed);
+      return _iWrite.load(std::memory_order_seq_cst) != iRead
+        ? &_elements[iRead & _mask] : nullptr;
+    }
+
+    /** releases the element returned by last front().
+     *
+     * @param iReader index of reader
+     */
+    void pop(uint iReader)
+    {
+      assert(iReader < _nReaders);
+      _readers[iReader].i.fetch_add(1, std::memory_order_release);
+    }
+
+    //@}
+  private:
+    /// @name Internal Stuff
+    //@{
+
+    /// returns the read position of the slowest reader.
+    size_t getReadMin() const
+    {
+      size_t iReadMin = _iWrite.load(std::memory_order_relaxed);
+      for (uint i = 0; i < _nReaders; ++i) {
+        const size_t iRead = _readers[i].i.load(std::memory_order_acquire);
+        if (iReadMin - iRead < (size_t)1 << (8 * sizeof (size_t) - 1)) {
+          iReadMin = iRead; // handles wrap-around of indices
+        }
+      }
+      return iReadMin;
+    }
+
+    //@}
+};
+
+#endif // RING_H
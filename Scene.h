@@ -0,0 +1,43 @@
+/** @file
+ * functions to set up and render the scene of the demo
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+// own header:
+#include "linmath.h"
+#include "Mesh.h"
+#include "RenderContext.h"
+
+/** sets up view and clear color of demo scene
+ * (as initially shown in the GUI).
+ *
+ * @param context the render context to set up
+ */
+inline void initDemoScene(RenderContext &context)
+{
+  context.setClearColor(Vec4f(0.5f, 0.75f, 1.0f, 1.0f));
+  context.setCamMat(Mat4x4f(InitTrans, Vec3f(0.0f, 0.0f, 2.5f)));
+  context.getProjMat()
+    = makePersp(degToRad(30.0f),
+      (float)context.getViewportWidth() / context.getViewportHeight(),
+      0.01f, 100.0f);
+}
+
+/** draws the triangles of a mesh.
+ *
+ * The attributes which the vertices don't provide are taken from the
+ * current normal, color, and texture coordinate of render context
+ * (see RenderContext::drawMesh()).
+ *
+ * @param context the render context to draw into
+ * @param mesh the mesh to draw (indexed or non-indexed)
+ */
+template <typename VERTEX, typename INDEX>
+void drawMesh(RenderContext &context, const MeshT<VERTEX, INDEX> &mesh)
+{
+  context.drawMesh(mesh);
+}
+
+#endif // SCENE_H
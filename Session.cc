@@ -0,0 +1,94 @@
+#include <fstream>
+#include <locale>
+#include <sstream>
+
+#include "Session.h"
+
+namespace {
+
+// header line of session files
+const char *const header = "# NoGL3d session 1";
+
+// writes a matrix
+void write(std::ostream &out, const Mat4x4f &mat)
+{
+  for (float value : mat.comp) out << ' ' << value;
+}
+
+// reads a matrix
+bool read(std::istream &in, Mat4x4f &mat)
+{
+  for (float &value : mat.comp) if (!(in >> value)) return false;
+  return true;
+}
+
+} // namespace
+
+bool Session::save(const std::string &file)
+{
+  std::ofstream fOut(file);
+  if (!fOut) { _error = "Cannot open file."; return false; }
+  fOut.imbue(std::locale::classic());
+  fOut.precision(9); // enough to read back floats exactly
+  fOut << header << '\n'
+    << "# t resSphere mode ambient matProj matCam matModel\n";
+  for (const Frame &frame : _frames) {
+    fOut << frame.t << ' ' << frame.resSphere << ' ' << frame.mode << ' '
+      << frame.ambient;
+    write(fOut, frame.matProj);
+    write(fOut, frame.matCam);
+    write(fOut, frame.matModel);
+    fOut << '\n';
+  }
+  fOut.close();
+  if (!fOut) { _error = "Cannot write file."; return false; }
+  return true;
+}
+
+bool Session::load(const std::string &file)
+{
+  std::ifstream fIn(file);
+  if (!fIn) { _error = "Cannot open file."; return false; }
+  std::string line;
+  if (!std::getline(fIn, line) || line != header) {
+    _error = "Not a session."; return false;
+  }
+  std::vector<Frame> frames;
+  for (uint i = 2; std::getline(fIn, line); ++i) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream in(line);
+    in.imbue(std::locale::classic());
+    Frame frame;
+    if (!(in >> frame.t >> frame.resSphere >> frame.mode >> frame.ambient)
+      || !read(in, frame.matProj) || !read(in, frame.matCam)
+      || !read(in, frame.matModel)) {
+      _error = "Broken frame in line " + std::to_string(i) + ".";
+      return false;
+    }
+    if (frame.resSphere > ResSphereMax) {
+      _error = "Resolution of sphere out of range in line "
+        + std::to_string(i) + ".";
+      return false;
+    }
+    frames.push_back(frame);
+  }
+  _frames.swap(frames);
+  return true;
+}
+
+bool Session::saveTimings(
+  const std::string &file, const std::vector<double> &dts) const
+{
+  if (_frames.empty() && !dts.empty()) return false;
+  std::ofstream fOut(file);
+  if (!fOut) return false;
+  fOut.imbue(std::locale::classic());
+  fOut << "frame,t,resSphere,mode,dt_ms\n";
+  for (size_t i = 0; i < dts.size(); ++i) {
+    const Frame &frame = _frames[i % _frames.size()];
+    fOut << i << ',' << frame.t << ',' << frame.resSphere << ','
+      << frame.mode << ',' << 1000.0 * dts[i] << '\n';
+  }
+  fOut.close();
+  return (bool)fOut;
+}
@@ -0,0 +1,127 @@
+/** @file
+ * interface of class Session
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+// standard C++ header:
+#include <string>
+#include <vector>
+
+// own header:
+#include "linmath.h"
+#include "util.h"
+
+/* A session records the navigation of an interactive session frame by
+ * frame (camera, model, modes, and resolution of sphere with the time
+ * of the frame) to replay it later at full speed.
+ * Thus, builds can be compared on identical camera paths.
+ *
+ * Sessions are stored as text file:
+ *
+ * - a header line "# NoGL3d session 1"
+ * - one line per frame with the values (separated by white space):
+ *   t resSphere mode ambient matProj matCam matModel
+ *   (matrices with 16 values each in order of Mat4x4f::comp)
+ *
+ * Lines starting with '#' are ignored. Floats are written with enough
+ * digits to be read back exactly.
+ */
+
+/** provides recording, storing, and loading of sessions.
+ */
+class Session {
+
+  // types:
+  public:
+    /// max. resolution of sphere (as offered in GUI)
+    enum { ResSphereMax = 8 };
+
+    /// recorded frame
+    struct Frame {
+      double t; ///< time since start of recording (in s)
+      uint resSphere; ///< resolution of sphere
+      uint mode; ///< enabled modes (bit i set ... Mode i enabled)
+      float ambient; ///< ratio of ambient light
+      Mat4x4f matProj; ///< projection matrix
+      Mat4x4f matCam; ///< camera matrix
+      Mat4x4f matModel; ///< model matrix
+    };
+
+  // variables:
+  private:
+    /// recorded frames
+    std::vector<Frame> _frames;
+    /// message of last error
+    std::string _error;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// constructor.
+    Session() = default;
+
+    /// destructor.
+    ~Session() = default;
+
+    // disabled:
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    //@}
+  public:
+    /// @name Public Access
+    //@{
+
+    /// returns recorded frames.
+    const std::vector<Frame>& getFrames() const { return _frames; }
+
+    /// returns number of recorded frames.
+    size_t size() const { return _frames.size(); }
+
+    /// removes all frames.
+    void clear() { _frames.clear(); }
+
+    /** appends a frame.
+     *
+     * @param frame the frame to append
+     */
+    void add(const Frame &frame) { _frames.push_back(frame); }
+
+    /** saves the session to a file.
+     *
+     * @param file path of file
+     * @return true ... session saved\n
+     *         false ... file not writable
+     */
+    bool save(const std::string &file);
+
+    /** loads a session from a file (replacing the current frames).
+     *
+     * @param file path of file
+     * @return true ... session loaded\n
+     *         false ... file not readable or broken, e.g. resolution of
+     *         sphere above ResSphereMax (see getError())
+     */
+    bool load(const std::string &file);
+
+    /** writes timings of a replay as CSV file.
+     *
+     * @param file path of file
+     * @param dts duration of every frame (in s)
+     * @return true ... file written\n
+     *         false ... file not writable
+     */
+    bool saveTimings(
+      const std::string &file, const std::vector<double> &dts) const;
+
+    /// returns message of last error.
+    const std::string& getError() const { return _error; }
+
+    //@}
+};
+
+#endif // SESSION_H
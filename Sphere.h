@@ -1,25 +1,33 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
-#include "mesh.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Mesh.h"
 
 namespace {
 
-template <typename MESH, bool FRONT>
-void storeVertex(MESH &mesh, const Vec3f &coord)
+template <typename VERTEX, bool FRONT>
+void storeVertex(VERTEX &vtx, const Vec3f &coord)
 {
-  typedef typename MESH::Vertex Vertex;
-  mesh.vtcs.push_back(Vertex());
-  Vertex &vtx = mesh.vtcs.back();
+  typedef VERTEX Vertex;
   // coord
   storeCoord<Vertex>(vtx, coord);
   // normal
   typedef typename Vertex::Normal Normal;
-  if (sizeof (Normal)) storeNormal<Vertex>(vtx, coord);
+  if (!std::is_void<Normal>::value) storeNormal<Vertex>(vtx, coord);
   // no colors
   // texture coordinate
   typedef typename Vertex::TexCoord TexCoord;
-  if (sizeof (TexCoord)) {
+  if (!std::is_void<TexCoord>::value) {
     const Vec2f v = normalize(Vec2f(coord.x, coord.z), NoThrow);
     storeTexCoord<Vertex>(vtx,
       Vec2f(FRONT
@@ -29,9 +37,9 @@ void storeVertex(MESH &mesh, const Vec3f &coord)
   }
 }
 
-template <typename MESH, bool FRONT>
+template <typename VERTEX, bool FRONT>
 void makeSpherePatch(
-  MESH &mesh, uint depth,
+  VERTEX *&pVtx, uint depth,
   const Vec3f &v1, const Vec3f &v2, const Vec3f &v3)
 {
   if (depth) {
@@ -39,82 +47,732 @@ void makeSpherePatch(
     const Vec3f v23 = normalize(v2 + v3, NoThrow);
     const Vec3f v31 = normalize(v3 + v1, NoThrow);
     --depth;
-    makeSpherePatch<MESH, FRONT>(mesh, depth, v1, v12, v31);
-    makeSpherePatch<MESH, FRONT>(mesh, depth, v2, v23, v12);
-    makeSpherePatch<MESH, FRONT>(mesh, depth, v3, v31, v23);
-    makeSpherePatch<MESH, FRONT>(mesh, depth, v12, v23, v31);
+    makeSpherePatch<VERTEX, FRONT>(pVtx, depth, v1, v12, v31);
+    makeSpherePatch<VERTEX, FRONT>(pVtx, depth, v2, v23, v12);
+    makeSpherePatch<VERTEX, FRONT>(pVtx, depth, v3, v31, v23);
+    makeSpherePatch<VERTEX, FRONT>(pVtx, depth, v12, v23, v31);
   } else {
-    storeVertex<MESH, FRONT>(mesh, v1);
-    storeVertex<MESH, FRONT>(mesh, v2);
-    storeVertex<MESH, FRONT>(mesh, v3);
+    storeVertex<VERTEX, FRONT>(*pVtx++, v1);
+    storeVertex<VERTEX, FRONT>(*pVtx++, v2);
+    storeVertex<VERTEX, FRONT>(*pVtx++, v3);
   }
 }
 
-} // namespace
+// returns number of vertices of a sphere patch
+inline size_t getNVtcsSpherePatch(uint depth)
+{
+  return (size_t)3 << 2 * depth; // 3 * 4^depth
+}
 
-template <typename MESH>
-void makeSphereMesh(MESH &mesh, uint depth)
+/* number of subdivisions of an octant before it is split into jobs
+ * (i.e. 8 * 4^2 = 128 sub-patches are built in parallel)
+ */
+enum { SphereJobLevels = 2 };
+
+// returns middle of two points on sphere (as in makeSpherePatch())
+inline Vec3f getSphereMiddle(const Vec3f &v1, const Vec3f &v2)
 {
-  /* Octants:
-   *       +----+     +----+
-   *      /    /|    /    /|
-   *     +----+ |   +----+ |
-   *     |  2 | +   |  1 | +
-   *   +----+ |/  +----+ |/
-   *  /    /|-+  /    /|-+
-   * +----+ |   +----+ |
-   * |  3 | +---|  4 | +---+
-   * |    |/   /|    |/   /|
-   * +----+---+ +----+---+ |
-   *     |  6 | +   |  5 | +
-   *   +----+ |/  +----+ |/
-   *  /    /|-+  /    /|-+
-   * +----+ |   +----+ |
-   * |  7 | +   |  8 | +
-   * |    |/    |    |/
-   * +----+     +----+
-   * 
-   *           y
-   *        2  |     1
-   *           | /
-   *     3     |/ 4
-   *     ------+------x
-   *        6 /|     5
-   *         / |
-   *     7  z  |  8
-   */
+  return normalize(v1 + v2, NoThrow);
+}
+
+/* replaces a patch by one of its sub-patches.
+ *
+ * level ... number of subdivisions
+ * iSub ... index of sub-patch (in order of makeSpherePatch())
+ * p1, p2, p3 ... corners of patch (replaced by corners of sub-patch)
+ */
+template <typename POINT>
+void getSphereSubPatch(
+  uint level, size_t iSub, POINT &p1, POINT &p2, POINT &p3)
+{
+  while (level--) {
+    const POINT p12 = getSphereMiddle(p1, p2);
+    const POINT p23 = getSphereMiddle(p2, p3);
+    const POINT p31 = getSphereMiddle(p3, p1);
+    switch (iSub >> 2 * level & 3) {
+      case 0: p2 = p12; p3 = p31; break;
+      case 1: p1 = p2; p2 = p23; p3 = p12; break;
+      case 2: p1 = p3; p2 = p31; p3 = p23; break;
+      default: p1 = p12; p2 = p23; p3 = p31;
+    }
+  }
+}
+
+// corners of an octant of sphere
+struct SphereOctantCorners {
+  bool front; // flag: true ... octant is in front (z > 0)
+  Vec3f v1, v2, v3; // corners (v3 is a pole)
+};
+
+/* Octants:
+ *       +----+     +----+
+ *      /    /|    /    /|
+ *     +----+ |   +----+ |
+ *     |  2 | +   |  1 | +
+ *   +----+ |/  +----+ |/
+ *  /    /|-+  /    /|-+
+ * +----+ |   +----+ |
+ * |  3 | +---|  4 | +---+
+ * |    |/   /|    |/   /|
+ * +----+---+ +----+---+ |
+ *     |  6 | +   |  5 | +
+ *   +----+ |/  +----+ |/
+ *  /    /|-+  /    /|-+
+ * +----+ |   +----+ |
+ * |  7 | +   |  8 | +
+ * |    |/    |    |/
+ * +----+     +----+
+ * 
+ *           y
+ *        2  |     1
+ *           | /
+ *     3     |/ 4
+ *     ------+------x
+ *        6 /|     5
+ *         / |
+ *     7  z  |  8
+ */
+const SphereOctantCorners sphereOctants[] = {
   // octant 1: top, left, back
-  makeSpherePatch<MESH, false>(mesh, depth,
-    Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, -1.0f),
-    Vec3f(0.0f, 1.0f, 0.0f));
+  { false, Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, -1.0f),
+    Vec3f(0.0f, 1.0f, 0.0f) },
   // octant 2: top, right, back
-  makeSpherePatch<MESH, false>(mesh, depth,
-    Vec3f(0.0f, 0.0f, -1.0f), Vec3f(-1.0f, 0.0f, 0.0f),
-    Vec3f(0.0f, 1.0f, 0.0f));
+  { false, Vec3f(0.0f, 0.0f, -1.0f), Vec3f(-1.0f, 0.0f, 0.0f),
+    Vec3f(0.0f, 1.0f, 0.0f) },
   // octant 3: top, right, front
-  makeSpherePatch<MESH, true>(mesh, depth,
-    Vec3f(-1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f),
-    Vec3f(0.0f, 1.0f, 0.0f));
+  { true, Vec3f(-1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f),
+    Vec3f(0.0f, 1.0f, 0.0f) },
   // octant 4: top, left, front
-  makeSpherePatch<MESH, true>(mesh, depth,
-    Vec3f(0.0f, 0.0f, 1.0f), Vec3f(1.0f, 0.0f, 0.0f),
-    Vec3f(0.0f, 1.0f, 0.0f));
+  { true, Vec3f(0.0f, 0.0f, 1.0f), Vec3f(1.0f, 0.0f, 0.0f),
+    Vec3f(0.0f, 1.0f, 0.0f) },
   // octant 5: bottom, left, back
-  makeSpherePatch<MESH, false>(mesh, depth,
-    Vec3f(0.0f, 0.0f, -1.0f), Vec3f(1.0f, 0.0f, 0.0f),
-    Vec3f(0.0f, -1.0f, 0.0f));
+  { false, Vec3f(0.0f, 0.0f, -1.0f), Vec3f(1.0f, 0.0f, 0.0f),
+    Vec3f(0.0f, -1.0f, 0.0f) },
   // octant 6: bottom, right, back
-  makeSpherePatch<MESH, false>(mesh, depth,
-    Vec3f(-1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, -1.0f),
-    Vec3f(0.0f, -1.0f, 0.0f));
+  { false, Vec3f(-1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, -1.0f),
+    Vec3f(0.0f, -1.0f, 0.0f) },
   // octant 7: bottom, right, front
-  makeSpherePatch<MESH, true>(mesh, depth,
-    Vec3f(0.0f, 0.0f, 1.0f), Vec3f(-1.0f, 0.0f, 0.0f),
-    Vec3f(0.0f, -1.0f, 0.0f));
+  { true, Vec3f(0.0f, 0.0f, 1.0f), Vec3f(-1.0f, 0.0f, 0.0f),
+    Vec3f(0.0f, -1.0f, 0.0f) },
   // octant 8: bottom, left, front
-  makeSpherePatch<MESH, true>(mesh, depth,
-    Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f),
-    Vec3f(0.0f, -1.0f, 0.0f));
+  { true, Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f),
+    Vec3f(0.0f, -1.0f, 0.0f) }
+};
+
+enum { NSphereOctants = sizeof sphereOctants / sizeof *sphereOctants };
+
+/* layout of vertices of an indexed sphere mesh
+ * (see makeSphereMeshIndexed())
+ *
+ * Each octant is a triangular lattice with n = 2^depth steps per edge.
+ * Lattice point (i, j) of an octant with corners v1, v2, v3 is
+ * (n - i - j) * v1 + i * v2 + j * v3 (before projection onto the
+ * sphere), i.e. j = 0 is the equator and j = n is the pole.
+ * Vertices are shared between octants except on the texture seam
+ * (the half-circle through +x where u jumps from 1 to 0) and at the
+ * poles (where u differs between front and back).
+ *
+ * Storage order of vertices:
+ * - 4 poles: top back, top front, bottom back, bottom front
+ * - 4 n points of equator (starting at +x, in order +x, -z, -x, +z)
+ *   and the front copy of +x
+ * - n - 1 inner points of 8 meridians (top and bottom of +x, -z, -x,
+ *   +z) and the front copies of the 2 meridians of +x
+ * - (n - 1) (n - 2) / 2 inner points per octant
+ *
+ * Each vertex is stored by exactly one octant (the owner).
+ */
+struct SphereLayout {
+  uint n; // number of steps per edge of octant
+
+  explicit SphereLayout(uint depth): n(1u << depth) { }
+
+  // returns number of vertices
+  size_t getNVtcs() const { return 4 * (size_t)n * n + 2 * n + 3; }
+
+  // returns number of indices
+  size_t getNIdcs() const { return 8 * 3 * (size_t)n * n; }
+
+  // returns number of lattice points of an octant
+  size_t getNLattice() const { return (size_t)(n + 1) * (n + 2) / 2; }
+
+  // returns index of lattice point (i, j) in lattice of an octant
+  size_t getILattice(uint i, uint j) const
+  {
+    return (size_t)j * (n + 1) - (size_t)j * (j - 1) / 2 + i;
+  }
+
+  /* returns index of vertex for lattice point (i, j) of an octant.
+   *
+   * iOct ... index of octant
+   *   (0 ... 3: top, 4 ... 7: bottom, in order of equator)
+   * front ... flag: true ... octant is in front (z > 0)
+   * own ... set to whether the octant stores the vertex
+   */
+  uint getIVtx(uint iOct, bool front, uint i, uint j, bool &own) const
+  {
+    const uint h = iOct / 4, e = iOct % 4; // hemisphere, 1st direction
+    const uint nM = n - 1;
+    const uint iEq = 4, iMer = iEq + 4 * n + 1, iIn = iMer + 10 * nM;
+    if (j == n) { // pole
+      own = e == (front ? 2u : 0u);
+      return 2 * h + front;
+    }
+    if (j == 0) { // equator (owned by top hemisphere)
+      const uint p = (e * n + (h ? n - i : i)) % (4 * n);
+      const bool seam = p == 0 && front;
+      own = !h && (i < n || seam);
+      return seam ? iEq + 4 * n : iEq + p;
+    }
+    if (i == 0 || i + j == n) { // meridian (through v1 or v2)
+      const uint dir = (e + ((i == 0) != !h)) % 4;
+      own = i == 0 || dir == 0; // copies on seam are not shared
+      return dir == 0 && front
+        ? iMer + (8 + h) * nM + j - 1
+        : iMer + (4 * h + dir) * nM + j - 1;
+    }
+    own = true; // inner point
+    return (uint)(iIn + iOct * (nM * (nM - 1) / 2)
+      + (j - 1) * nM - (j - 1) * j / 2 + i - 1);
+  }
+};
+
+// point of octant lattice
+struct SpherePoint {
+  Vec3f coord; // coordinate (on unit sphere)
+  uint i, j; // lattice coordinates
+};
+
+// returns middle of two lattice points (as in makeSpherePatch())
+inline SpherePoint getSphereMiddle(
+  const SpherePoint &p1, const SpherePoint &p2)
+{
+  return {
+    getSphereMiddle(p1.coord, p2.coord), (p1.i + p2.i) / 2, (p1.j + p2.j) / 2
+  };
+}
+
+/* part (sub-patch) of an octant of indexed sphere mesh in construction
+ *
+ * The lattice of an octant is divided into cells of m x m steps
+ * (the sub-patches) which are upright (like the octant) or inverted.
+ * A lattice point on the border of cells is stored by the upright cell
+ * which contains it and has the lowest i, j.
+ * Hence, sub-patches built in parallel never store the same point.
+ */
+struct SphereOctant {
+  const SphereLayout &layout;
+  uint iOct; // index of octant
+  bool front; // flag: true ... octant is in front (z > 0)
+  Vec3f *coords; // coordinates of lattice points
+  uint *pIdx; // next index to store
+  uint m; // size of cells (in lattice steps)
+  uint iCell, jCell; // cell of sub-patch
+  bool upright; // flag: true ... cell of sub-patch is upright
+
+  // constructor (with the cell of a sub-patch from its corners)
+  SphereOctant(
+    const SphereLayout &layout, uint iOct, bool front, Vec3f *coords,
+    uint *pIdx, const SpherePoint &p1, const SpherePoint &p2,
+    const SpherePoint &p3, uint m):
+    layout(layout), iOct(iOct), front(front), coords(coords), pIdx(pIdx),
+    m(m)
+  {
+    const uint i = std::min(std::min(p1.i, p2.i), p3.i);
+    const uint j = std::min(std::min(p1.j, p2.j), p3.j);
+    const uint ij = std::min(std::min(p1.i + p1.j, p2.i + p2.j), p3.i + p3.j);
+    iCell = i / m; jCell = j / m; upright = ij == i + j;
+  }
+
+  // returns whether the sub-patch stores a lattice point
+  bool isOwn(uint i, uint j) const
+  {
+    uint iC = i / m, jC = j / m;
+    const bool up = i % m + j % m <= m; // otherwise inside inverted cell
+    if ((iC + jC) * m == layout.n) { // corner on border of octant
+      if (iC) --iC; else --jC;
+    }
+    return iC == iCell && jC == jCell && up == upright;
+  }
+
+  // stores a lattice point and its index
+  void store(const SpherePoint &point)
+  {
+    if (isOwn(point.i, point.j)) {
+      coords[layout.getILattice(point.i, point.j)] = point.coord;
+    }
+    bool own;
+    *pIdx++ = layout.getIVtx(iOct, front, point.i, point.j, own);
+  }
+};
+
+void makeSpherePatchIndexed(
+  SphereOctant &octant, uint depth,
+  const SpherePoint &p1, const SpherePoint &p2, const SpherePoint &p3)
+{
+  if (depth) {
+    // same subdivision as in makeSpherePatch() (to get equal coordinates)
+    const SpherePoint p12 = getSphereMiddle(p1, p2);
+    const SpherePoint p23 = getSphereMiddle(p2, p3);
+    const SpherePoint p31 = getSphereMiddle(p3, p1);
+    --depth;
+    makeSpherePatchIndexed(octant, depth, p1, p12, p31);
+    makeSpherePatchIndexed(octant, depth, p2, p23, p12);
+    makeSpherePatchIndexed(octant, depth, p3, p31, p23);
+    makeSpherePatchIndexed(octant, depth, p12, p23, p31);
+  } else {
+    octant.store(p1); octant.store(p2); octant.store(p3);
+  }
+}
+
+/* stores the vertices of a row of lattice owned by an octant
+ * (after its lattice is filled)
+ */
+template <typename VERTEX, bool FRONT>
+void storeSphereOctantVtcs(
+  const SphereLayout &layout, uint iOct, const Vec3f coords[], uint j,
+  VERTEX vtcs[])
+{
+  for (uint i = 0; i + j <= layout.n; ++i) {
+    bool own;
+    const uint iVtx = layout.getIVtx(iOct, FRONT, i, j, own);
+    if (own) {
+      storeVertex<VERTEX, FRONT>(vtcs[iVtx], coords[layout.getILattice(i, j)]);
+    }
+  }
 }
 
+/* criterion of adaptive tessellation of sphere
+ * (see makeSphereMeshAdaptive())
+ *
+ * The decision whether an edge is split depends on the end points of
+ * the edge only. Hence, both triangles which share an edge agree, and
+ * no T-junctions (cracks) can occur.
+ */
+struct SphereTessellation {
+  Mat4x4f matMVP; // model-view-projection matrix
+  float width2, height2; // half size of viewport (in pixels)
+  float errorMax; // max. projected error (in pixels)
+  float lenMin2; // squared length below which edges are not split
+  Vec3f posCam; // position of camera (in model space)
+  Vec4f planes[6]; // clip planes (in model space, normalized)
+  Vec3f dirCam; // direction to camera (normalized)
+  float cosCap, sinCap; // half angle of cap of sphere visible from camera
+  bool cullBack; // flag: true ... back faces are not refined
+
+  /* constructor.
+   *
+   * matProj, matView, matModel ... matrices of render context
+   * width, height ... size of viewport
+   * errorMax ... max. projected error (in pixels)
+   * depthMax ... max. depth of subdivision
+   * cullBack ... flag: true ... don't refine back faces
+   */
+  SphereTessellation(
+    const Mat4x4f &matProj, const Mat4x4f &matView,
+    const Mat4x4f &matModel, uint width, uint height,
+    float errorMax, uint depthMax, bool cullBack):
+    matMVP(matProj * matView * matModel),
+    width2(0.5f * width), height2(0.5f * height), errorMax(errorMax),
+    // edges of depth d are 1.1 ... 1.75 times sqrt(2) / 2^d long
+    lenMin2(std::ldexp(8.0f, -2 * (int)depthMax)),
+    posCam(transformPoint(invert(matView * matModel), Vec3f(Null))),
+    cullBack(cullBack)
+  {
+    // clip planes from rows of matrix: -w <= x, y, z <= w
+    const Vec4f w(matMVP[3][0], matMVP[3][1], matMVP[3][2], matMVP[3][3]);
+    for (int i = 0; i < 3; ++i) {
+      const Vec4f r(matMVP[i][0], matMVP[i][1], matMVP[i][2], matMVP[i][3]);
+      planes[2 * i] = w + r; planes[2 * i + 1] = w - r;
+    }
+    for (Vec4f &plane : planes) {
+      const float len = length(plane.xyz());
+      if (len > 0.0f) plane = (1.0f / len) * plane;
+    }
+    // camera inside of sphere: no back faces to skip
+    const float distCam = length(posCam);
+    if (distCam <= 1.0f) this->cullBack = false;
+    else {
+      dirCam = (1.0f / distCam) * posCam;
+      cosCap = 1.0f / distCam; sinCap = std::sqrt(1.0f - cosCap * cosCap);
+    }
+  }
+
+  // returns whether a ball (in model space) is beyond a clip plane
+  bool isOutside(const Vec3f &center, float radius) const
+  {
+    for (const Vec4f &plane : planes) {
+      if (dot(plane.xyz(), center) + plane.w < -radius) return true;
+    }
+    return false;
+  }
+
+  /* returns whether a ball (around a point on unit sphere) covers back
+   * faces only.
+   */
+  bool isBack(const Vec3f &center, float radius) const
+  {
+    // angle between center and camera > half angle of cap + angle of ball
+    const float cosBall = 1.0f - 0.5f * radius * radius;
+    if (cosBall <= -cosCap) return false; // sum of angles >= 180 deg
+    const float sinBall = std::sqrt(1.0f - cosBall * cosBall);
+    return dot(center, dirCam) < cosCap * cosBall - sinCap * sinBall;
+  }
+
+  /* returns whether an edge (of unit sphere) has to be split.
+   *
+   * The projected error is the distance in pixels between the middle of
+   * the edge and the middle of the arc which it approximates.
+   */
+  bool split(const Vec3f &p, const Vec3f &q) const
+  {
+    const Vec3f d = p - q;
+    if (dot(d, d) < lenMin2) return false; // finest level reached
+    const Vec3f s = p + q; // (same for both directions of edge)
+    const Vec3f mArc = normalize(s, NoThrow);
+    // edge with adjacent triangles (approx.) not visible
+    const float radius = 2.0f * std::sqrt(dot(d, d));
+    if (cullBack && isBack(mArc, radius)) return false;
+    if (isOutside(mArc, radius)) return false;
+    const Vec4f cArc = matMVP * Vec4f(mArc, 1.0f);
+    const Vec4f cChord = matMVP * Vec4f(0.5f * s, 1.0f);
+    // behind camera: refine (as projection is not meaningful)
+    if (cArc.w <= 0.0f || cChord.w <= 0.0f) return true;
+    const float dx = (cArc.x / cArc.w - cChord.x / cChord.w) * width2;
+    const float dy = (cArc.y / cArc.w - cChord.y / cChord.w) * height2;
+    return dx * dx + dy * dy > errorMax * errorMax;
+  }
+};
+
+/* subdivides a patch of sphere adaptively.
+ *
+ * Only edges of the recursive subdivision (of makeSpherePatch()) might
+ * be split. If not all edges of a triangle are split, the triangle is
+ * divided into 2 or 3 triangles with new diagonals which are never
+ * split. Hence, the recursion ends when the edges become too short.
+ *
+ * edges ... bits of edges which are edges of the subdivision
+ *   (bit 0: v1 v2, bit 1: v2 v3, bit 2: v3 v1)
+ */
+template <typename VERTEX, bool FRONT>
+void makeSpherePatchAdaptive(
+  std::vector<VERTEX> &vtcs, const SphereTessellation &tess,
+  const Vec3f &v1, const Vec3f &v2, const Vec3f &v3, uint edges = 7)
+{
+  const uint split = (edges & 1 && tess.split(v1, v2)) * 1
+    | (edges & 2 && tess.split(v2, v3)) * 2
+    | (edges & 4 && tess.split(v3, v1)) * 4;
+  if (!split) {
+    vtcs.resize(vtcs.size() + 3);
+    VERTEX *pVtx = &vtcs.back() - 2;
+    storeVertex<VERTEX, FRONT>(pVtx[0], v1);
+    storeVertex<VERTEX, FRONT>(pVtx[1], v2);
+    storeVertex<VERTEX, FRONT>(pVtx[2], v3);
+    return;
+  }
+  // middles of split edges (same as in makeSpherePatch())
+  const Vec3f v12 = split & 1 ? normalize(v1 + v2, NoThrow) : Vec3f();
+  const Vec3f v23 = split & 2 ? normalize(v2 + v3, NoThrow) : Vec3f();
+  const Vec3f v31 = split & 4 ? normalize(v3 + v1, NoThrow) : Vec3f();
+  auto make = [&](
+    const Vec3f &v1, const Vec3f &v2, const Vec3f &v3, uint edges) {
+    makeSpherePatchAdaptive<VERTEX, FRONT>(vtcs, tess, v1, v2, v3, edges);
+  };
+  switch (split) {
+    // one edge split: 2 triangles
+    case 1:
+      make(v1, v12, v3, 1 | (edges & 4));
+      make(v12, v2, v3, 1 | (edges & 2));
+      break;
+    case 2:
+      make(v2, v23, v1, 1 | (edges & 1) << 2);
+      make(v23, v3, v1, 1 | (edges & 4) >> 1);
+      break;
+    case 4:
+      make(v3, v31, v2, 1 | (edges & 2) << 1);
+      make(v31, v1, v2, 1 | (edges & 1) << 1);
+      break;
+    // two edges split: 3 triangles
+    case 1 | 2:
+      make(v12, v2, v23, 3); make(v1, v12, v23, 1);
+      make(v1, v23, v3, 2 | (edges & 4));
+      break;
+    case 2 | 4:
+      make(v23, v3, v31, 3); make(v2, v23, v31, 1);
+      make(v2, v31, v1, 2 | (edges & 1) << 2);
+      break;
+    case 4 | 1:
+      make(v31, v1, v12, 3); make(v3, v31, v12, 1);
+      make(v3, v12, v2, 2 | (edges & 2) << 1);
+      break;
+    // all edges split: 4 triangles (as in makeSpherePatch())
+    default:
+      make(v1, v12, v31, 7); make(v2, v23, v12, 7);
+      make(v3, v31, v23, 7); make(v12, v23, v31, 7);
+  }
+}
+
+} // namespace
+
+/* makes a (non-indexed) sphere mesh.
+ *
+ * The sphere is made of 8 patches (one per octant) which are subdivided
+ * recursively.
+ * The storage is allocated in advance.
+ * Hence, each sub-patch (see SphereJobLevels) writes into its own slice
+ * of vertices and the sub-patches might be built in parallel.
+ *
+ * mesh ... the mesh to fill (previous contents are replaced)
+ * depth ... depth of recursive subdivision
+ * pJobSys ... job system to build octants in parallel
+ *   (nullptr ... build in calling thread only)
+ */
+template <typename MESH>
+void makeSphereMesh(MESH &mesh, uint depth, JobSystem *pJobSys = nullptr)
+{
+  typedef typename MESH::Vertex Vertex;
+  const uint level = std::min(depth, (uint)SphereJobLevels);
+  const size_t nSubs = (size_t)1 << 2 * level; // sub-patches per octant
+  const size_t nVtcsSub = getNVtcsSpherePatch(depth - level);
+  mesh.vtcs.resize(NSphereOctants * nSubs * nVtcsSub);
+  Vertex *const vtcs = mesh.vtcs.data();
+  const auto makeSubs = [&](size_t i0, size_t i1) {
+    for (size_t i = i0; i < i1; ++i) {
+      const SphereOctantCorners &octant = sphereOctants[i / nSubs];
+      Vec3f v1 = octant.v1, v2 = octant.v2, v3 = octant.v3;
+      getSphereSubPatch(level, i % nSubs, v1, v2, v3);
+      Vertex *pVtx = vtcs + i * nVtcsSub;
+      if (octant.front) {
+        makeSpherePatch<Vertex, true>(pVtx, depth - level, v1, v2, v3);
+      } else {
+        makeSpherePatch<Vertex, false>(pVtx, depth - level, v1, v2, v3);
+      }
+    }
+  };
+  const size_t n = NSphereOctants * nSubs;
+  if (pJobSys) pJobSys->parallelFor(0, n, 1, makeSubs);
+  else makeSubs(0, n);
+}
+
+/* makes an indexed sphere mesh.
+ *
+ * The triangles are the same as of makeSphereMesh() (in the same order)
+ * but adjacent triangles share their vertices. Only the vertices on the
+ * texture seam and at the poles are duplicated (as their texture
+ * coordinates differ). Hence, there are approx. 1/6 of the vertices,
+ * and the texture coordinates of every vertex are computed only once.
+ * The storage is allocated in advance with exact sizes.
+ * The mesh is built in 2 passes:
+ * 1. Each sub-patch (see SphereJobLevels) writes its own slice of
+ *    indices and the coordinates of lattice points it owns
+ *    (see SphereOctant).
+ * 2. Each row of lattice writes the vertices its octant owns
+ *    (see SphereLayout).
+ * Hence, the sub-patches and rows might be built in parallel.
+ *
+ * mesh ... the indexed mesh to fill (previous contents are replaced)
+ * depth ... depth of recursive subdivision
+ * pJobSys ... job system to build octants in parallel
+ *   (nullptr ... build in calling thread only)
+ */
+template <typename MESH>
+void makeSphereMeshIndexed(
+  MESH &mesh, uint depth, JobSystem *pJobSys = nullptr)
+{
+  typedef typename MESH::Vertex Vertex;
+  const SphereLayout layout(depth);
+  mesh.vtcs.resize(layout.getNVtcs());
+  mesh.idcs.resize(layout.getNIdcs());
+  // coordinates of lattice points (one lattice per octant)
+  const size_t nLattice = layout.getNLattice();
+  std::vector<Vec3f> coords(NSphereOctants * nLattice);
+  // 1st pass: indices and coordinates of sub-patches
+  const uint n = layout.n;
+  const uint level = std::min(depth, (uint)SphereJobLevels);
+  const size_t nSubs = (size_t)1 << 2 * level; // sub-patches per octant
+  const size_t nIdcsSub = layout.getNIdcs() / (NSphereOctants * nSubs);
+  const auto makeSubs = [&](size_t i0, size_t i1) {
+    for (size_t i = i0; i < i1; ++i) {
+      const uint iOct = (uint)(i / nSubs);
+      const SphereOctantCorners &corners = sphereOctants[iOct];
+      SpherePoint p1 = { corners.v1, 0, 0 };
+      SpherePoint p2 = { corners.v2, n, 0 };
+      SpherePoint p3 = { corners.v3, 0, n };
+      getSphereSubPatch(level, i % nSubs, p1, p2, p3);
+      SphereOctant octant(layout, iOct, corners.front,
+        coords.data() + iOct * nLattice, mesh.idcs.data() + i * nIdcsSub,
+        p1, p2, p3, n >> level);
+      makeSpherePatchIndexed(octant, depth - level, p1, p2, p3);
+    }
+  };
+  // 2nd pass: vertices (row by row of lattice)
+  const auto storeRows = [&](size_t i0, size_t i1) {
+    for (size_t i = i0; i < i1; ++i) {
+      const uint iOct = (uint)(i / (n + 1)), j = (uint)(i % (n + 1));
+      const Vec3f *const coordsOct = coords.data() + iOct * nLattice;
+      if (sphereOctants[iOct].front) {
+        storeSphereOctantVtcs<Vertex, true>(
+          layout, iOct, coordsOct, j, mesh.vtcs.data());
+      } else {
+        storeSphereOctantVtcs<Vertex, false>(
+          layout, iOct, coordsOct, j, mesh.vtcs.data());
+      }
+    }
+  };
+  const size_t nJobs = NSphereOctants * nSubs;
+  const size_t nRows = NSphereOctants * (n + 1);
+  if (pJobSys) {
+    pJobSys->parallelFor(0, nJobs, 1, makeSubs);
+    pJobSys->parallelFor(0, nRows, std::max(nRows / nJobs, (size_t)1),
+      storeRows);
+  } else {
+    makeSubs(0, nJobs); storeRows(0, nRows);
+  }
+}
+
+/* makes a (non-indexed) sphere mesh tessellated for a certain view.
+ *
+ * The octants are subdivided recursively like in makeSphereMesh() but
+ * only where the projected error of an edge exceeds a limit
+ * (see SphereTessellation). Triangles with 1 or 2 split edges are
+ * divided into 2 or 3 triangles accordingly.
+ * Thus, the number of triangles follows the coverage of the sphere on
+ * screen, and adjacent triangles always share their edges (no cracks).
+ * The storage of the mesh is reused (but not allocated in advance as the
+ * number of triangles isn't known before).
+ *
+ * mesh ... the mesh to fill (previous contents are replaced)
+ * tess ... criterion of tessellation
+ */
+template <typename MESH>
+void makeSphereMeshAdaptive(MESH &mesh, const SphereTessellation &tess)
+{
+  typedef typename MESH::Vertex Vertex;
+  mesh.vtcs.clear(); mesh.idcs.clear();
+  for (const SphereOctantCorners &octant : sphereOctants) {
+    if (octant.front) {
+      makeSpherePatchAdaptive<Vertex, true>(mesh.vtcs, tess,
+        octant.v1, octant.v2, octant.v3);
+    } else {
+      makeSpherePatchAdaptive<Vertex, false>(mesh.vtcs, tess,
+        octant.v1, octant.v2, octant.v3);
+    }
+  }
+}
+
+/* caches indexed sphere meshes per resolution (depth of subdivision).
+ *
+ * Meshes are built on first request and kept until clear().
+ * Hence, switching between resolutions doesn't rebuild them.
+ * With request(), a missing mesh is built in a background job (of the
+ * caller's job system) while the caller keeps using another mesh.
+ * The cache itself has to be used by one thread only.
+ */
+template <typename MESH>
+class SphereMeshCacheT {
+  private:
+    std::vector<std::unique_ptr<MESH>> _meshes;
+    // background build
+    JobSystem *_pJobSysBuild; // job system running the build (if any)
+    uint _depthBuild;
+    std::unique_ptr<MESH> _pMeshBuild;
+    std::function<void()> _cbDone;
+    std::atomic<bool> _done; // set by background job when mesh is built
+    std::atomic<bool> _running; // reset by background job when returning
+
+  public:
+    SphereMeshCacheT():
+      _pJobSysBuild(nullptr), _depthBuild(0), _done(false), _running(false)
+    { }
+    ~SphereMeshCacheT() { wait(); }
+    SphereMeshCacheT(const SphereMeshCacheT&) = delete;
+    SphereMeshCacheT& operator=(const SphereMeshCacheT&) = delete;
+
+    /* returns sphere mesh of a certain resolution.
+     *
+     * depth ... depth of recursive subdivision
+     * pJobSys ... job system to build a new mesh in parallel
+     */
+    const MESH& get(uint depth, JobSystem *pJobSys = nullptr)
+    {
+      collect();
+      if (depth >= _meshes.size()) _meshes.resize(depth + 1);
+      std::unique_ptr<MESH> &pMesh = _meshes[depth];
+      if (!pMesh) {
+        pMesh.reset(new MESH());
+        makeSphereMeshIndexed(*pMesh, depth, pJobSys);
+      }
+      return *pMesh;
+    }
+
+    /* returns sphere mesh of a certain resolution if available.
+     *
+     * Otherwise, the mesh is built in a background job (if no other build
+     * is running) and nullptr is returned. The caller should render another
+     * mesh and request again later.
+     * Without job system or worker threads, the mesh is built immediately
+     * instead.
+     *
+     * depth ... depth of recursive subdivision
+     * pJobSys ... job system to run the build (and its parallel parts)
+     * cbDone ... called in background job when the build is finished
+     *   (e.g. to trigger a new frame)
+     */
+    const MESH* request(
+      uint depth, JobSystem *pJobSys, const std::function<void()> &cbDone)
+    {
+      collect();
+      if (depth < _meshes.size() && _meshes[depth]) {
+        return _meshes[depth].get();
+      }
+      if (!pJobSys || !pJobSys->getThreads()) return &get(depth, pJobSys);
+      if (!_running.load(std::memory_order_acquire)) {
+        _pJobSysBuild = pJobSys; _depthBuild = depth;
+        _pMeshBuild.reset(new MESH()); _cbDone = cbDone;
+        _running = true;
+        const JobSystem::Job job = { &buildJob, this, 0, 0 };
+        pJobSys->submit(job);
+      }
+      return nullptr;
+    }
+
+    // releases all cached meshes (waits for a background build)
+    void clear()
+    {
+      wait();
+      _done = false; _pMeshBuild.reset();
+      _meshes.clear();
+    }
+
+  private:
+    // builds the requested mesh (called as job)
+    static void buildJob(void *pCtx, size_t, size_t)
+    {
+      SphereMeshCacheT &cache = *(SphereMeshCacheT*)pCtx;
+      makeSphereMeshIndexed(
+        *cache._pMeshBuild, cache._depthBuild, cache._pJobSysBuild);
+      cache._done.store(true, std::memory_order_release);
+      if (cache._cbDone) cache._cbDone();
+      cache._running.store(false, std::memory_order_release);
+    }
+
+    // waits for a background build (helping the job system meanwhile)
+    void wait()
+    {
+      while (_running.load(std::memory_order_acquire)) {
+        if (!_pJobSysBuild->runOne()) std::this_thread::yield();
+      }
+    }
+
+    // takes over a finished background build
+    void collect()
+    {
+      if (!_done.load(std::memory_order_acquire)) return;
+      wait(); _done = false;
+      if (_depthBuild >= _meshes.size()) _meshes.resize(_depthBuild + 1);
+      if (!_meshes[_depthBuild]) _meshes[_depthBuild].swap(_pMeshBuild);
+      _pMeshBuild.reset();
+    }
+};
+
 #endif // SPHERE_H
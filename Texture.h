@@ -37,6 +37,9 @@ class Texture {
       return *this;
     }
     bool empty() const { return _width * _height == 0; }
+    uint getWidth() const { return _width; }
+    uint getHeight() const { return _height; }
+    const uint32* data() const { return _texel.data(); }
     bool load(uint width, uint height, const uint32 data[])
     {
       if (!(isPowerOf2(width) && isPowerOf2(height))) return false;
@@ -51,10 +54,10 @@ class Texture {
       assert(_width != 0 && _height != 0);
 #if 1 // should work
       const float u = coord.x < 0.0f
-        ? 1.0f - coord.x - (int)coord.x
+        ? 1.0f + coord.x - (int)coord.x
         : coord.x - (int)coord.x;
       const float v = coord.y < 0.0f
-        ? 1.0f - coord.y - (int)coord.y
+        ? 1.0f + coord.y - (int)coord.y
         : coord.y - (int)coord.y;
       return _texel[(size_t)(v * _mV) * _width + (size_t)(u * _mU)];
 #else // to explore
@@ -0,0 +1,126 @@
+/** @file
+ * interface of class template TripleBufferT
+ */
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// standard C++ header:
+#include <atomic>
+
+// own header:
+#include "util.h"
+
+/** provides a lock-free triple buffer to hand over values from one
+ * writer thread to one reader thread.
+ *
+ * The writer fills the back buffer and publishes it.
+ * The reader fetches the latest published value into the front buffer.
+ * Values published meanwhile are dropped (i.e. the reader always gets
+ * the latest value but not necessarily all of them).
+ *
+ * None of the methods blocks.
+ * Neither the writer nor the reader waits for the other.
+ *
+ * @tparam VALUE the type of values
+ */
+template <typename VALUE>
+class TripleBufferT {
+
+  // types:
+  public:
+    typedef VALUE Value;
+
+  private:
+    /// flag in _iMid: the middle buffer has not yet been fetched
+    enum { Fresh = 4 };
+
+  // variables:
+  private:
+    /// storage of buffers
+    Value _values[3];
+    /// index of back buffer (only used by writer)
+    uint _iBack;
+    /// index of middle buffer (| Fresh if published but not fetched)
+    std::atomic<uint> _iMid;
+    /// index of front buffer (only used by reader)
+    uint _iFront;
+
+  // methods:
+  public:
+    /// @name Construction & Destruction
+    //@{
+
+    /// default constructor.
+    TripleBufferT(): _iBack(0), _iMid(1), _iFront(2) { }
+
+    /** constructor.
+     *
+     * @param value initial value of all buffers
+     */
+    explicit TripleBufferT(const Value &value):
+      _values{ value, value, value }, _iBack(0), _iMid(1), _iFront(2)
+    { }
+
+    /// destructor.
+    ~TripleBufferT() = default;
+
+    // disabled:
+    TripleBufferT(const TripleBufferT&) = delete;
+    TripleBufferT& operator=(const TripleBufferT&) = delete;
+
+    //@}
+  public:
+    /// @name Writer Side
+    //@{
+
+    /** returns the back buffer to fill.
+     *
+     * @note
+     * After publish(), the back buffer is another one which may contain
+     * any older value.
+     *
+     * @return back buffer
+     */
+    Value& back() { return _values[_iBack]; }
+
+    /** publishes the back buffer.
+     */
+    void publish()
+    {
+      _iBack = _iMid.exchange(_iBack | Fresh, std::memory_order_acq_rel)
+        & ~Fresh;
+    }
+
+    //@}
+  public:
+    /// @name Reader Side
+    //@{
+
+    /** fetches the latest published value into the front buffer.
+     *
+     * @return true ... a new value has been fetched\n
+     *         false ... nothing published since last call
+     */
+    bool update()
+    {
+      if (!(_iMid.load(std::memory_order_relaxed) & Fresh)) return false;
+      _iFront = _iMid.exchange(_iFront, std::memory_order_acq_rel) & ~Fresh;
+      return true;
+    }
+
+    /** returns the front buffer.
+     *
+     * @return front buffer (with the value fetched in last update())
+     */
+    Value& front() { return _values[_iFront]; }
+    /** returns the front buffer.
+     *
+     * @return front buffer (read-only)
+     */
+    const Value& front() const { return _values[_iFront]; }
+
+    //@}
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -1,33 +1,180 @@
+#include <algorithm>
 #include <array>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __SSE2__
 
 #include "color.h"
+#include "JobSystem.h"
+
+namespace {
+
+// number of rows processed in one job
+const size_t grainRows = 16;
+
+// calls func for all rows (in parallel if a job system is provided)
+template <typename FUNC>
+void forRows(JobSystem *pJobSys, uint height, const FUNC &func)
+{
+  if (pJobSys) pJobSys->parallelFor(0, height, grainRows, func);
+  else func((size_t)0, (size_t)height);
+}
+
+// source samples and weight of a sample of bilinear filter
+struct Tap {
+  uint i0, i1; // indices of source samples
+  uint f; // weight of i1 in [0, 256] (i0 gets 256 - f)
+};
+
+// computes taps to scale n source samples to m samples
+std::vector<Tap> makeTaps(uint n, uint m)
+{
+  std::vector<Tap> taps(m);
+  const float scale = (float)n / m;
+  for (uint i = 0; i < m; ++i) {
+    const float s = std::max((i + 0.5f) * scale - 0.5f, 0.0f);
+    const uint i0 = std::min((uint)s, n - 1);
+    taps[i].i0 = i0; taps[i].i1 = std::min(i0 + 1, n - 1);
+    taps[i].f = (uint)((s - i0) * 256.0f + 0.5f);
+  }
+  return taps;
+}
+
+// interpolates two RGBA values channel-wise
+inline uint32 lerpRGBA(uint32 rgba0, uint32 rgba1, uint f)
+{
+  uint32 rgba = 0;
+  for (uint shift = 0; shift < 32; shift += 8) {
+    const uint c0 = rgba0 >> shift & 0xff, c1 = rgba1 >> shift & 0xff;
+    rgba |= (c0 * (256 - f) + c1 * f + 128) >> 8 << shift;
+  }
+  return rgba;
+}
+
+// interpolates two rows
+void lerpRow(
+  uint n, const uint32 row0[], const uint32 row1[], uint f, uint32 row[])
+{
+  uint i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(128);
+  const __m128i w0 = _mm_set1_epi16((short)(256 - f));
+  const __m128i w1 = _mm_set1_epi16((short)f);
+  for (; i + 4 <= n; i += 4) { // 4 pixels at once
+    const __m128i p0 = _mm_loadu_si128((const __m128i*)(row0 + i));
+    const __m128i p1 = _mm_loadu_si128((const __m128i*)(row1 + i));
+    const __m128i lo = _mm_srli_epi16(
+      _mm_add_epi16(
+        _mm_add_epi16(
+          _mm_mullo_epi16(_mm_unpacklo_epi8(p0, zero), w0),
+          _mm_mullo_epi16(_mm_unpacklo_epi8(p1, zero), w1)),
+        round), 8);
+    const __m128i hi = _mm_srli_epi16(
+      _mm_add_epi16(
+        _mm_add_epi16(
+          _mm_mullo_epi16(_mm_unpackhi_epi8(p0, zero), w0),
+          _mm_mullo_epi16(_mm_unpackhi_epi8(p1, zero), w1)),
+        round), 8);
+    _mm_storeu_si128((__m128i*)(row + i), _mm_packus_epi16(lo, hi));
+  }
+#endif // __SSE2__
+  for (; i < n; ++i) row[i] = lerpRGBA(row0[i], row1[i], f);
+}
+
+// scales a row horizontally
+void scaleRow(
+  const uint32 rowSrc[], const std::vector<Tap> &taps, uint32 row[])
+{
+  const uint n = (uint)taps.size();
+  uint i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(128);
+  for (; i + 2 <= n; i += 2) { // 2 pixels at once
+    const Tap &tapA = taps[i], &tapB = taps[i + 1];
+    const __m128i p = _mm_set_epi32(
+      (int)rowSrc[tapB.i1], (int)rowSrc[tapB.i0],
+      (int)rowSrc[tapA.i1], (int)rowSrc[tapA.i0]);
+    const short fA = (short)tapA.f, gA = (short)(256 - tapA.f);
+    const short fB = (short)tapB.f, gB = (short)(256 - tapB.f);
+    const __m128i mA = _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero),
+      _mm_set_epi16(fA, fA, fA, fA, gA, gA, gA, gA));
+    const __m128i mB = _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero),
+      _mm_set_epi16(fB, fB, fB, fB, gB, gB, gB, gB));
+    // add weighted samples (upper to lower half)
+    const __m128i sA = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(mA, _mm_srli_si128(mA, 8)), round), 8);
+    const __m128i sB = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(mB, _mm_srli_si128(mB, 8)), round), 8);
+    _mm_storel_epi64((__m128i*)(row + i),
+      _mm_packus_epi16(_mm_unpacklo_epi64(sA, sB), zero));
+  }
+#endif // __SSE2__
+  for (; i < n; ++i) {
+    const Tap &tap = taps[i];
+    row[i] = lerpRGBA(rowSrc[tap.i0], rowSrc[tap.i1], tap.f);
+  }
+}
+
+} // namespace
 
 void colorToAlpha(
-  uint width, uint height, uint32 img[], const Vec3f &pivot, float exp)
+  uint width, uint height, uint32 img[], const Vec3f &pivot, float exp,
+  JobSystem *pJobSys)
 {
   // maximum distance is length(Vec3f(1, 1, 1) - Vec3f(0, 0, 0))
   const float dMax = sqrt(3.0f);
   // scale d to range of [0, 90] degree
   const float normD = 0.5f * (float)Pi / dMax;
   // process any pixel of image
-  const uint32 *end = img + width * height;
-  for (; img != end; ++img) {
-    const Vec3f color = rgbaToColor(*img).xyz();
-    const float d = length(color - pivot);
-    const float alpha = 1.0f - pow(cos(d * normD), exp);
-    (*img &= 0x00ffffff);
-    (*img |= (uint32)(0xff000000 * alpha) & (uint32)0xff000000);
-  }
+  forRows(pJobSys, height,
+    [&](size_t y0, size_t y1) {
+      uint32 *pixel = img + y0 * width;
+      const uint32 *end = img + y1 * width;
+      for (; pixel != end; ++pixel) {
+        const Vec3f color = rgbaToColor(*pixel).xyz();
+        const float d = length(color - pivot);
+        const float alpha = 1.0f - pow(cos(d * normD), exp);
+        (*pixel &= 0x00ffffff);
+        (*pixel |= (uint32)(0xff000000 * alpha) & (uint32)0xff000000);
+      }
+    });
 }
 
 void mergeColors(
   uint width, uint height,
   uint32 img[], const uint32 img0[], const uint32 img1[],
-  float f0, float f1)
+  float f0, float f1, JobSystem *pJobSys)
 {
-  const uint32 *end = img + width * height;
-  for (; img != end; ++img, ++img0, ++img1) {
-    *img = colorToRGBA(
-      lerp(rgbaToColor(*img0), rgbaToColor(*img1), f0, f1));
-  }
+  forRows(pJobSys, height,
+    [&](size_t y0, size_t y1) {
+      for (size_t i = y0 * width, n = y1 * width; i < n; ++i) {
+        img[i] = colorToRGBA(
+          lerp(rgbaToColor(img0[i]), rgbaToColor(img1[i]), f0, f1));
+      }
+    });
+}
+
+void scaleBilinear(
+  uint widthSrc, uint heightSrc, const uint32 imgSrc[],
+  uint width, uint height, uint32 img[], JobSystem *pJobSys)
+{
+  const std::vector<Tap> tapsX = makeTaps(widthSrc, width);
+  const std::vector<Tap> tapsY = makeTaps(heightSrc, height);
+  forRows(pJobSys, height,
+    [&](size_t y0, size_t y1) {
+      // vertical pass into temporary row, then horizontal pass
+      std::vector<uint32> rowSrc(widthSrc);
+      for (size_t y = y0; y < y1; ++y) {
+        const Tap &tap = tapsY[y];
+        lerpRow(widthSrc,
+          imgSrc + (size_t)tap.i0 * widthSrc,
+          imgSrc + (size_t)tap.i1 * widthSrc,
+          tap.f, rowSrc.data());
+        scaleRow(rowSrc.data(), tapsX, img + y * width);
+      }
+    });
 }
\ No newline at end of file
@@ -9,6 +9,9 @@
 #include "util.h"
 #include "linmath.h"
 
+// forward declarations:
+class JobSystem;
+
 /** converts a color from 4 vector to RGBA 32-bit values.
  *
  * @param color color as 4 vector
@@ -22,6 +25,32 @@ inline uint32 colorToRGBA(const Vec4f &color)
     | ((uint32)(0x000000ff * color.x) & (uint32)0x000000ff);
 }
 
+/** converts a color from 4 vector to premultiplied ARGB 32-bit value.
+ *
+ * This is the pixel format of QImage::Format_ARGB32_Premultiplied.
+ *
+ * @param color color as 4 vector
+ * @return color as premultiplied ARGB 32-bit value
+ *         (B in the least significant byte, A in the most significant)
+ */
+inline uint32 colorToARGBPremul(const Vec4f &color)
+{
+  return colorToRGBA(Vec4f(
+    color.z * color.w, color.y * color.w, color.x * color.w, color.w));
+}
+
+/** exchanges red and blue of a 32-bit color value.
+ *
+ * This converts RGBA to (non-premultiplied) ARGB and vice versa.
+ *
+ * @param rgba color as RGBA (or ARGB) 32-bit value
+ * @return color as ARGB (or RGBA) 32-bit value
+ */
+inline uint32 swapRB(uint32 rgba)
+{
+  return (rgba & 0xff00ff00) | (rgba >> 16 & 0xff) | (rgba & 0xff) << 16;
+}
+
 /** converts a color from RGBA 32-bit values to 4 vector.
  *
  * @param rgba as RGBA 32-bit value
@@ -52,9 +81,12 @@ inline Vec4f rgbaToColor(const uint32 rgba)
  *        least significant byte, A (alpha) in the most significant.
  * @param pivot the pivot color
  * @param exp the exponent for cos()
+ * @param pJobSys job system to process rows in parallel
+ *        (nullptr ... process in calling thread only)
  */
 void colorToAlpha(
-  uint width, uint height, uint32 img[], const Vec3f &pivot, float exp);
+  uint width, uint height, uint32 img[], const Vec3f &pivot, float exp,
+  JobSystem *pJobSys = nullptr);
 
 /** merges two images.
  *
@@ -65,10 +97,33 @@ void colorToAlpha(
  * @param img1 second image
  * @param f0 factor for @a img0 [0, 1]
  * @param f1 factor for @a img1 [0, 1 - @a f0]
+ * @param pJobSys job system to process rows in parallel
+ *        (nullptr ... process in calling thread only)
  */
 void mergeColors(
   uint width, uint height,
   uint32 img[], const uint32 img0[], const uint32 img1[],
-  float f0, float f1);
+  float f0, float f1, JobSystem *pJobSys = nullptr);
+
+/** scales an image with bilinear filtering (e.g. to upscale an image
+ * rendered at lower resolution for presentation).
+ *
+ * The channels are filtered independently with 8 bit fixed point
+ * weights (using SSE2 if available with identical results).
+ * The pixel centers of both images are aligned
+ * (i.e. the image borders are mapped onto each other).
+ *
+ * @param widthSrc width of source image
+ * @param heightSrc height of source image
+ * @param imgSrc source image (widthSrc * heightSrc RGBA values)
+ * @param width width of result image
+ * @param height height of result image
+ * @param img result image (width * height RGBA values)
+ * @param pJobSys job system to process rows in parallel
+ *        (nullptr ... process in calling thread only)
+ */
+void scaleBilinear(
+  uint widthSrc, uint heightSrc, const uint32 imgSrc[],
+  uint width, uint height, uint32 img[], JobSystem *pJobSys = nullptr);
 
 #endif // COLOR_H
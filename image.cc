@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+#include "image.h"
+
+namespace {
+
+// reads the next number of a PPM header (skipping white space and comments)
+bool readPPMValue(std::istream &in, uint &value)
+{
+  for (int c; (c = in.peek()) != EOF;) {
+    if (c == '#') while ((c = in.get()) != EOF && c != '\n');
+    else if (std::isspace(c)) in.get();
+    else break;
+  }
+  return (bool)(in >> value);
+}
+
+// extracts the RGB bytes of a row of RGBA values
+void getRGB(uint width, const uint32 rgba[], unsigned char rgb[])
+{
+  for (uint x = 0; x < width; ++x) {
+    rgb[3 * x + 0] = (unsigned char)(rgba[x] >> 0);
+    rgb[3 * x + 1] = (unsigned char)(rgba[x] >> 8);
+    rgb[3 * x + 2] = (unsigned char)(rgba[x] >> 16);
+  }
+}
+
+// computes the CRC-32 used in PNG chunks
+class CRC32 {
+  private:
+    uint32 _table[256];
+  public:
+    CRC32()
+    {
+      for (uint32 i = 0; i < 256; ++i) {
+        uint32 c = i;
+        for (int k = 0; k < 8; ++k) {
+          c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        _table[i] = c;
+      }
+    }
+    uint32 operator()(
+      uint32 crc, const unsigned char *data, size_t size) const
+    {
+      crc = ~crc;
+      for (size_t i = 0; i < size; ++i) {
+        crc = _table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+      }
+      return ~crc;
+    }
+};
+
+// appends a 32-bit value in big endian (network byte order)
+void appendU32(std::vector<unsigned char> &data, uint32 value)
+{
+  data.push_back((unsigned char)(value >> 24));
+  data.push_back((unsigned char)(value >> 16));
+  data.push_back((unsigned char)(value >> 8));
+  data.push_back((unsigned char)value);
+}
+
+// writes a PNG chunk
+void writeChunk(
+  std::ostream &out, const char type[4],
+  const std::vector<unsigned char> &data)
+{
+  static const CRC32 crc32;
+  std::vector<unsigned char> chunk;
+  chunk.reserve(data.size() + 12);
+  appendU32(chunk, (uint32)data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  appendU32(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+  out.write((const char*)chunk.data(), chunk.size());
+}
+
+bool hasExt(const std::string &file, const char *ext)
+{
+  const std::string::size_type i = file.rfind('.');
+  if (i == std::string::npos) return false;
+  std::string fileExt = file.substr(i + 1);
+  for (char &c : fileExt) c = (char)std::tolower((unsigned char)c);
+  return fileExt == ext;
+}
+
+} // namespace
+
+bool readPPM(
+  const std::string &file, uint &width, uint &height,
+  std::vector<uint32> &img)
+{
+  std::ifstream in(file.c_str(), std::ios::binary);
+  char magic[2];
+  if (!in.read(magic, 2) || magic[0] != 'P' || magic[1] != '6') return false;
+  uint w, h, max;
+  if (!readPPMValue(in, w) || !readPPMValue(in, h)
+    || !readPPMValue(in, max) || max != 255) return false;
+  in.get(); // single white space after header
+  std::vector<unsigned char> rgb(3 * (size_t)w * h);
+  if (!in.read((char*)rgb.data(), rgb.size())) return false;
+  img.resize((size_t)w * h);
+  for (size_t i = 0, n = img.size(); i < n; ++i) {
+    img[i] = 0xff000000
+      | (uint32)rgb[3 * i + 2] << 16
+      | (uint32)rgb[3 * i + 1] << 8
+      | (uint32)rgb[3 * i + 0];
+  }
+  width = w; height = h;
+  return true;
+}
+
+bool writePPM(
+  const std::string &file, uint width, uint height, const uint32 img[])
+{
+  std::ofstream out(file.c_str(), std::ios::binary);
+  out << "P6\n" << width << ' ' << height << "\n255\n";
+  std::vector<unsigned char> rgb(3 * width);
+  for (uint y = 0; y < height; ++y) {
+    getRGB(width, img + (size_t)y * width, rgb.data());
+    out.write((const char*)rgb.data(), rgb.size());
+  }
+  return (bool)out;
+}
+
+bool writePNG(
+  const std::string &file, uint width, uint height, const uint32 img[])
+{
+  std::ofstream out(file.c_str(), std::ios::binary);
+  static const char signature[] = "\x89PNG\r\n\x1a\n";
+  out.write(signature, 8);
+  { // IHDR
+    std::vector<unsigned char> data;
+    appendU32(data, width); appendU32(data, height);
+    data.push_back(8); // bits per channel
+    data.push_back(2); // color type: RGB
+    data.push_back(0); // compression: deflate
+    data.push_back(0); // filter method: adaptive
+    data.push_back(0); // interlace: none
+    writeChunk(out, "IHDR", data);
+  }
+  { // IDAT: zlib stream with uncompressed deflate blocks
+    const size_t sizeRow = 1 + 3 * (size_t)width; // with filter type
+    std::vector<unsigned char> raw(sizeRow * height);
+    for (uint y = 0; y < height; ++y) {
+      unsigned char *row = raw.data() + y * sizeRow;
+      row[0] = 0; // filter type: none
+      getRGB(width, img + (size_t)y * width, row + 1);
+    }
+    std::vector<unsigned char> data;
+    data.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    data.push_back(0x78); data.push_back(0x01); // zlib header
+    const size_t sizeBlockMax = 65535;
+    size_t i = 0;
+    do {
+      const size_t size = std::min(raw.size() - i, sizeBlockMax);
+      const bool last = i + size == raw.size();
+      data.push_back(last ? 1 : 0); // BFINAL, BTYPE = 00 (stored)
+      data.push_back((unsigned char)size);
+      data.push_back((unsigned char)(size >> 8));
+      data.push_back((unsigned char)~size);
+      data.push_back((unsigned char)(~size >> 8));
+      data.insert(data.end(), raw.begin() + i, raw.begin() + i + size);
+      i += size;
+    } while (i < raw.size());
+    // Adler-32 checksum of uncompressed data
+    uint32 a = 1, b = 0;
+    for (unsigned char value : raw) {
+      a = (a + value) % 65521; b = (b + a) % 65521;
+    }
+    appendU32(data, b << 16 | a);
+    writeChunk(out, "IDAT", data);
+  }
+  writeChunk(out, "IEND", std::vector<unsigned char>());
+  return (bool)out;
+}
+
+bool writeImage(
+  const std::string &file, uint width, uint height, const uint32 img[])
+{
+  if (hasExt(file, "png")) return writePNG(file, width, height, img);
+  if (hasExt(file, "ppm")) return writePPM(file, width, height, img);
+  return false;
+}
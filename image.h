@@ -0,0 +1,77 @@
+/** @file
+ * functions to read and write image files (without any image library)
+ */
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+// standard C++ header:
+#include <string>
+#include <vector>
+
+// own header:
+#include "util.h"
+
+/** reads an image from a binary PPM file (P6, max. value 255).
+ *
+ * @param file path of file
+ * @param width width of image (set on success)
+ * @param height height of image (set on success)
+ * @param img color values of image (from top/left to bottom/right corner)
+ *        Thereby, in each element R (red) is stored in the
+ *        least significant byte, A (alpha, always 255) in the most
+ *        significant.
+ * @return true ... image read\n
+ *         false ... file not readable or not supported
+ */
+bool readPPM(
+  const std::string &file, uint &width, uint &height,
+  std::vector<uint32> &img);
+
+/** writes an image to a binary PPM file (P6).
+ *
+ * The alpha values are ignored.
+ *
+ * @param file path of file
+ * @param width width of image
+ * @param height height of image
+ * @param img color values of image (from top/left to bottom/right corner)
+ *        The image @a img has to provide at least width * height RGBA
+ *        values.
+ *        Thereby, in each element R (red) has to be stored in the
+ *        least significant byte, A (alpha) in the most significant.
+ * @return true ... image written\n
+ *         false ... file not writable
+ */
+bool writePPM(
+  const std::string &file, uint width, uint height, const uint32 img[]);
+
+/** writes an image to a PNG file (RGB, uncompressed).
+ *
+ * The alpha values are ignored.
+ * The image data is stored in uncompressed deflate blocks which is
+ * valid PNG but doesn't need zlib.
+ *
+ * @param file path of file
+ * @param width width of image
+ * @param height height of image
+ * @param img color values of image (see writePPM())
+ * @return true ... image written\n
+ *         false ... file not writable
+ */
+bool writePNG(
+  const std::string &file, uint width, uint height, const uint32 img[]);
+
+/** writes an image to a file choosing the format by file extension.
+ *
+ * @param file path of file (with extension .png or .ppm)
+ * @param width width of image
+ * @param height height of image
+ * @param img color values of image (see writePPM())
+ * @return true ... image written\n
+ *         false ... file not writable or extension not supported
+ */
+bool writeImage(
+  const std::string &file, uint width, uint height, const uint32 img[]);
+
+#endif // IMAGE_H
@@ -1,3 +1,258 @@
+#include <cstring>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __AVX512F__, __AVX2__, __SSE2__
+
 #include "linmath.h"
 
 const double Pi = 3.1415926535897932384626433832795;
+
+namespace {
+
+/* The batch kernels are written once for a SIMD type which provides
+ * a vector of N floats (Float) and the operations on it.
+ * SimdScalar (N = 1) processes the rest of a batch.
+ */
+
+// "SIMD" type for a single float
+struct SimdScalar {
+  enum { N = 1 };
+  typedef float Float;
+  static Float load(const float *p) { return *p; }
+  static void store(float *p, Float v) { *p = v; }
+  static Float set(float v) { return v; }
+  static Float sub(Float a, Float b) { return a - b; }
+  static Float mul(Float a, Float b) { return a * b; }
+  // returns a * b + c
+  static Float madd(Float a, Float b, Float c) { return a * b + c; }
+  static Float max(Float a, Float b) { return a > b ? a : b; }
+  // returns v / w if w is not 0 (as transformPoint()), else v
+  static Float divW(Float v, Float w) { return w != 0.0f ? v / w : v; }
+  // stores the outcodes of points
+  static void storeOutcodes(std::uint8_t *p, Float x, Float y, Float z)
+  {
+    // (NaNs count as outside as in clipping)
+    *p = (std::uint8_t)(
+      !(x >= -1.0f) * OutLeft | !(x <= 1.0f) * OutRight
+      | !(y >= -1.0f) * OutBottom | !(y <= 1.0f) * OutTop
+      | !(z >= -1.0f) * OutNear | !(z <= 1.0f) * OutFar);
+  }
+};
+
+#if defined(__AVX512F__)
+// SIMD type for 16 floats with AVX-512
+struct SimdAVX512 {
+  enum { N = 16 };
+  typedef __m512 Float;
+  static Float load(const float *p) { return _mm512_loadu_ps(p); }
+  static void store(float *p, Float v) { _mm512_storeu_ps(p, v); }
+  static Float set(float v) { return _mm512_set1_ps(v); }
+  static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+  static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+  static Float madd(Float a, Float b, Float c)
+  {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+  static Float max(Float a, Float b) { return _mm512_max_ps(a, b); }
+  static Float divW(Float v, Float w)
+  {
+    const __mmask16 mask
+      = _mm512_cmp_ps_mask(w, _mm512_setzero_ps(), _CMP_NEQ_UQ);
+    return _mm512_mask_div_ps(v, mask, v, w);
+  }
+  static void storeOutcodes(std::uint8_t *p, Float x, Float y, Float z)
+  {
+    const Float one = set(1.0f), oneNeg = set(-1.0f);
+    // adds flag to the outcodes of lanes which are outside
+    __m512i codes = _mm512_setzero_si512();
+    auto add = [&codes](__mmask16 outside, int flag) {
+      codes = _mm512_mask_or_epi32(
+        codes, outside, codes, _mm512_set1_epi32(flag));
+    };
+    add(_mm512_cmp_ps_mask(x, oneNeg, _CMP_NGE_UQ), OutLeft);
+    add(_mm512_cmp_ps_mask(x, one, _CMP_NLE_UQ), OutRight);
+    add(_mm512_cmp_ps_mask(y, oneNeg, _CMP_NGE_UQ), OutBottom);
+    add(_mm512_cmp_ps_mask(y, one, _CMP_NLE_UQ), OutTop);
+    add(_mm512_cmp_ps_mask(z, oneNeg, _CMP_NGE_UQ), OutNear);
+    add(_mm512_cmp_ps_mask(z, one, _CMP_NLE_UQ), OutFar);
+    _mm_storeu_si128((__m128i*)p, _mm512_cvtepi32_epi8(codes));
+  }
+};
+typedef SimdAVX512 Simd;
+#elif defined(__AVX2__) && defined(__FMA__)
+// SIMD type for 8 floats with AVX2
+struct SimdAVX2 {
+  enum { N = 8 };
+  typedef __m256 Float;
+  static Float load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, Float v) { _mm256_storeu_ps(p, v); }
+  static Float set(float v) { return _mm256_set1_ps(v); }
+  static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+  static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  static Float madd(Float a, Float b, Float c)
+  {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+  static Float divW(Float v, Float w)
+  {
+    const Float mask = _mm256_cmp_ps(w, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+    return _mm256_blendv_ps(v, _mm256_div_ps(v, w), mask);
+  }
+  static void storeOutcodes(std::uint8_t *p, Float x, Float y, Float z)
+  {
+    const Float one = set(1.0f), oneNeg = set(-1.0f);
+    // adds flag to the outcodes of lanes which are outside
+    __m256i codes = _mm256_setzero_si256();
+    auto add = [&codes](Float outside, int flag) {
+      codes = _mm256_or_si256(codes,
+        _mm256_and_si256(
+          _mm256_castps_si256(outside), _mm256_set1_epi32(flag)));
+    };
+    add(_mm256_cmp_ps(x, oneNeg, _CMP_NGE_UQ), OutLeft);
+    add(_mm256_cmp_ps(x, one, _CMP_NLE_UQ), OutRight);
+    add(_mm256_cmp_ps(y, oneNeg, _CMP_NGE_UQ), OutBottom);
+    add(_mm256_cmp_ps(y, one, _CMP_NLE_UQ), OutTop);
+    add(_mm256_cmp_ps(z, oneNeg, _CMP_NGE_UQ), OutNear);
+    add(_mm256_cmp_ps(z, one, _CMP_NLE_UQ), OutFar);
+    // pack 8 x 32 bit to 8 x 8 bit
+    const __m128i codes16 = _mm_packs_epi32(
+      _mm256_castsi256_si128(codes), _mm256_extracti128_si256(codes, 1));
+    _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(codes16, codes16));
+  }
+};
+typedef SimdAVX2 Simd;
+#elif defined(__SSE2__)
+// SIMD type for 4 floats with SSE2
+struct SimdSSE2 {
+  enum { N = 4 };
+  typedef __m128 Float;
+  static Float load(const float *p) { return _mm_loadu_ps(p); }
+  static void store(float *p, Float v) { _mm_storeu_ps(p, v); }
+  static Float set(float v) { return _mm_set1_ps(v); }
+  static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+  static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+  static Float madd(Float a, Float b, Float c)
+  {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+  }
+  static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+  static Float divW(Float v, Float w)
+  {
+    const Float mask = _mm_cmpneq_ps(w, _mm_setzero_ps());
+    return _mm_or_ps(
+      _mm_and_ps(mask, _mm_div_ps(v, w)), _mm_andnot_ps(mask, v));
+  }
+  static void storeOutcodes(std::uint8_t *p, Float x, Float y, Float z)
+  {
+    const Float one = set(1.0f), oneNeg = set(-1.0f);
+    // adds flag to the outcodes of lanes which are outside
+    __m128i codes = _mm_setzero_si128();
+    auto add = [&codes](Float outside, int flag) {
+      codes = _mm_or_si128(codes,
+        _mm_and_si128(_mm_castps_si128(outside), _mm_set1_epi32(flag)));
+    };
+    add(_mm_cmpnge_ps(x, oneNeg), OutLeft);
+    add(_mm_cmpnle_ps(x, one), OutRight);
+    add(_mm_cmpnge_ps(y, oneNeg), OutBottom);
+    add(_mm_cmpnle_ps(y, one), OutTop);
+    add(_mm_cmpnge_ps(z, oneNeg), OutNear);
+    add(_mm_cmpnle_ps(z, one), OutFar);
+    // pack 4 x 32 bit to 4 x 8 bit
+    const __m128i codes16 = _mm_packs_epi32(codes, codes);
+    const int codes8 = _mm_cvtsi128_si32(_mm_packus_epi16(codes16, codes16));
+    std::memcpy(p, &codes8, 4);
+  }
+};
+typedef SimdSSE2 Simd;
+#else // (no SIMD)
+typedef SimdScalar Simd;
+#endif // __AVX512F__, __AVX2__, __SSE2__
+
+// transforms points from i in batches of SIMD::N (returns end of batches)
+template <typename SIMD>
+size_t transformPointsT(
+  const Mat4x4f &mat, size_t i, size_t n,
+  const float x[], const float y[], const float z[],
+  float xOut[], float yOut[], float zOut[], std::uint8_t outcodes[])
+{
+  typedef typename SIMD::Float Float;
+  Float m[16];
+  for (int j = 0; j < 16; ++j) m[j] = SIMD::set(mat.comp[j]);
+  // returns row j of matrix times (x, y, z, 1)
+  auto row = [&m](int j, Float xI, Float yI, Float zI) {
+    return SIMD::madd(m[4 * j + 2], zI,
+      SIMD::madd(m[4 * j + 1], yI, SIMD::madd(m[4 * j], xI, m[4 * j + 3])));
+  };
+  for (; i + SIMD::N <= n; i += SIMD::N) {
+    const Float xI = SIMD::load(x + i);
+    const Float yI = SIMD::load(y + i);
+    const Float zI = SIMD::load(z + i);
+    const Float w = row(3, xI, yI, zI);
+    const Float xO = SIMD::divW(row(0, xI, yI, zI), w);
+    const Float yO = SIMD::divW(row(1, xI, yI, zI), w);
+    const Float zO = SIMD::divW(row(2, xI, yI, zI), w);
+    SIMD::store(xOut + i, xO);
+    SIMD::store(yOut + i, yO);
+    SIMD::store(zOut + i, zO);
+    SIMD::storeOutcodes(outcodes + i, xO, yO, zO);
+  }
+  return i;
+}
+
+// lights normals from i in batches of SIMD::N (returns end of batches)
+template <typename SIMD>
+size_t lightNormalsT(
+  const Vec3f &light, float ambient, size_t i, size_t n,
+  const float nx[], const float ny[], const float nz[],
+  float fFront[], float fBack[])
+{
+  typedef typename SIMD::Float Float;
+  const Float lx = SIMD::set(light.x);
+  const Float ly = SIMD::set(light.y);
+  const Float lz = SIMD::set(light.z);
+  const Float zero = SIMD::set(0.0f);
+  const Float fAmbient = SIMD::set(ambient);
+  const Float fDiffuse = SIMD::set(1.0f - ambient);
+  for (; i + SIMD::N <= n; i += SIMD::N) {
+    const Float d = SIMD::madd(lz, SIMD::load(nz + i),
+      SIMD::madd(ly, SIMD::load(ny + i), SIMD::mul(lx, SIMD::load(nx + i))));
+    SIMD::store(fFront + i,
+      SIMD::madd(fDiffuse, SIMD::max(d, zero), fAmbient));
+    SIMD::store(fBack + i,
+      SIMD::madd(fDiffuse, SIMD::max(SIMD::sub(zero, d), zero), fAmbient));
+  }
+  return i;
+}
+
+} // namespace
+
+void transformPoints(
+  const Mat4x4f &mat, size_t n,
+  const float x[], const float y[], const float z[],
+  float xOut[], float yOut[], float zOut[], std::uint8_t outcodes[])
+{
+  const size_t i = transformPointsT<Simd>(
+    mat, 0, n, x, y, z, xOut, yOut, zOut, outcodes);
+  transformPointsT<SimdScalar>(
+    mat, i, n, x, y, z, xOut, yOut, zOut, outcodes);
+}
+
+void lightNormals(
+  const Mat4x4f &mat, size_t n,
+  const float nx[], const float ny[], const float nz[],
+  const Vec3f &light, float ambient, float fFront[], float fBack[])
+{
+  // dot(light, mat * normal) = dot(transposed(mat) * light, normal)
+  const Vec3f lightT(
+    mat._00 * light.x + mat._10 * light.y + mat._20 * light.z,
+    mat._01 * light.x + mat._11 * light.y + mat._21 * light.z,
+    mat._02 * light.x + mat._12 * light.y + mat._22 * light.z);
+  const size_t i = lightNormalsT<Simd>(
+    lightT, ambient, 0, n, nx, ny, nz, fFront, fBack);
+  lightNormalsT<SimdScalar>(
+    lightT, ambient, i, n, nx, ny, nz, fFront, fBack);
+}
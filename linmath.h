@@ -4,6 +4,13 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+
+#if defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __FMA__, __SSE2__
 
 extern const double Pi;
 
@@ -151,8 +158,18 @@ Vec3T<VALUE> cross(const Vec3T<VALUE> &v1, const Vec3T<VALUE> &v2)
 typedef Vec3T<float> Vec3f;
 typedef Vec3T<double> Vec3;
 
+/* alignment of Vec4T and Mat4x4T
+ *
+ * For float, 4 values (a vector or a row of a matrix) are aligned to 16
+ * bytes to be loaded and stored at once with SSE.
+ */
+template <typename VALUE>
+struct AlignSimdT { enum { value = alignof (VALUE) }; };
+template <>
+struct AlignSimdT<float> { enum { value = 16 }; };
+
 template <typename VALUE>
-struct Vec4T {
+struct alignas(AlignSimdT<VALUE>::value) Vec4T {
   typedef VALUE Value;
   Value x, y, z, w;
   // default constructor (leaving elements uninitialized)
@@ -228,7 +245,7 @@ enum ArgInitScale { InitScale };
 enum ArgInitPersp { InitPersp };
 
 template <typename VALUE>
-struct Mat4x4T {
+struct alignas(AlignSimdT<VALUE>::value) Mat4x4T {
   union {
     VALUE comp[4 * 4];
     struct {
@@ -386,6 +403,83 @@ struct Mat4x4T {
   }
 };
 
+#if defined(__SSE2__)
+/* SSE versions of the operations on Vec4T<float> and Mat4x4T<float>
+ * (The double versions stay scalar.)
+ */
+
+// loads a vector into an SSE register
+inline __m128 loadSimd(const Vec4T<float> &v) { return _mm_load_ps(&v.x); }
+
+// stores an SSE register into a vector
+inline Vec4T<float> storeSimd(__m128 v)
+{
+  Vec4T<float> vec; _mm_store_ps(&vec.x, v);
+  return vec;
+}
+
+// returns a * b + c (as FMA if available)
+inline __m128 maddSimd(__m128 a, __m128 b, __m128 c)
+{
+#if defined(__FMA__)
+  return _mm_fmadd_ps(a, b, c);
+#else // (no FMA)
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif // __FMA__
+}
+
+template <>
+inline Vec4T<float> operator-(const Vec4T<float> &v)
+{
+  return storeSimd(_mm_sub_ps(_mm_setzero_ps(), loadSimd(v)));
+}
+
+template <>
+inline Vec4T<float> operator+(const Vec4T<float> &v1, const Vec4T<float> &v2)
+{
+  return storeSimd(_mm_add_ps(loadSimd(v1), loadSimd(v2)));
+}
+
+template <>
+inline Vec4T<float> operator-(const Vec4T<float> &v1, const Vec4T<float> &v2)
+{
+  return storeSimd(_mm_sub_ps(loadSimd(v1), loadSimd(v2)));
+}
+
+template <>
+inline Vec4T<float> operator*(const Vec4T<float> &v, float s)
+{
+  return storeSimd(_mm_mul_ps(loadSimd(v), _mm_set1_ps(s)));
+}
+
+/* multiplies matrix with matrix.
+ *
+ * As the matrices are stored row by row, a row of the result is the sum
+ * of the rows of mat weighted by the elements of the row of this matrix,
+ * i.e. 1 multiplication and 3 FMAs per row.
+ */
+template <>
+inline Mat4x4T<float> Mat4x4T<float>::operator*(const Mat4x4T &mat) const
+{
+  const __m128 rows[4] = {
+    _mm_load_ps(mat.comp + 0), _mm_load_ps(mat.comp + 4),
+    _mm_load_ps(mat.comp + 8), _mm_load_ps(mat.comp + 12)
+  };
+  Mat4x4T matR;
+  for (int i = 0; i < 4; ++i) {
+    const float *const row = comp + 4 * i;
+    __m128 rowR = _mm_mul_ps(_mm_set1_ps(row[0]), rows[0]);
+    rowR = maddSimd(_mm_set1_ps(row[1]), rows[1], rowR);
+    rowR = maddSimd(_mm_set1_ps(row[2]), rows[2], rowR);
+    rowR = maddSimd(_mm_set1_ps(row[3]), rows[3], rowR);
+    _mm_store_ps(matR.comp + 4 * i, rowR);
+  }
+  return matR;
+}
+// (The product of matrix and vector stays scalar: with rows stored, it
+// needs horizontal sums which turned out slower than the scalar code.)
+#endif // __SSE2__
+
 template <typename VALUE>
 std::ostream& operator<<(std::ostream &out, const Mat4x4T<VALUE> &m)
 {
@@ -565,6 +659,50 @@ Mat4x4T<VALUE> invert(
         - mat._01 * mat._10 * mat._22));
 }
 
+/* checks whether a matrix is rigid, i.e. consists of rotation and
+ * translation only (as camera matrices usually do).
+ *
+ * The upper left 3x3 matrix has to be orthonormal and the last row
+ * (0, 0, 0, 1).
+ *
+ * mat ... the matrix
+ * eps ... tolerance for the products of rows of the 3x3 matrix
+ */
+template <typename VALUE>
+bool isRigid(const Mat4x4T<VALUE> &mat, VALUE eps = (VALUE)1E-5)
+{
+  if (mat._30 != (VALUE)0 || mat._31 != (VALUE)0 || mat._32 != (VALUE)0
+    || mat._33 != (VALUE)1) return false;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = i; j < 3; ++j) {
+      const VALUE dot = mat[i][0] * mat[j][0] + mat[i][1] * mat[j][1]
+        + mat[i][2] * mat[j][2];
+      if (std::abs(dot - (VALUE)(i == j)) > eps) return false;
+    }
+  }
+  return true;
+}
+
+/* returns the inverse of a rigid matrix (see isRigid()).
+ *
+ * For rotation R and translation t, the inverse is rotation R^T and
+ * translation -R^T * t which is much cheaper than invert().
+ *
+ * mat ... rigid matrix to invert
+ */
+template <typename VALUE>
+Mat4x4T<VALUE> invertRigid(const Mat4x4T<VALUE> &mat)
+{
+  return Mat4x4T<VALUE>(
+    mat._00, mat._10, mat._20,
+    -(mat._00 * mat._03 + mat._10 * mat._13 + mat._20 * mat._23),
+    mat._01, mat._11, mat._21,
+    -(mat._01 * mat._03 + mat._11 * mat._13 + mat._21 * mat._23),
+    mat._02, mat._12, mat._22,
+    -(mat._02 * mat._03 + mat._12 * mat._13 + mat._22 * mat._23),
+    (VALUE)0, (VALUE)0, (VALUE)0, (VALUE)1);
+}
+
 typedef Mat4x4T<float> Mat4x4f;
 typedef Mat4x4T<double> Mat4x4;
 
@@ -611,6 +749,59 @@ Vec3T<VALUE> transformVec(
   return Vec3T<VALUE>(vec.x, vec.y, vec.z);
 }
 
+/* flags of outcodes (a flag for each plane of the cube [-1, 1]³ which a
+ * point is outside of)
+ */
+enum Outcode {
+  OutLeft = 1 << 0, // x < -1
+  OutRight = 1 << 1, // x > 1
+  OutBottom = 1 << 2, // y < -1
+  OutTop = 1 << 3, // y > 1
+  OutNear = 1 << 4, // z < -1
+  OutFar = 1 << 5 // z > 1
+};
+
+/* transforms points given as structure of arrays (as transformPoint()).
+ *
+ * The points are processed in batches of 16, 8, or 4 with AVX-512,
+ * AVX2 (with FMA), or SSE2 (the widest one enabled at compile time),
+ * the rest one by one.
+ * (With FMA, the results may differ from transformPoint() in rounding.)
+ *
+ * mat ... the transformation
+ * n ... number of points
+ * x, y, z ... the coordinates of points
+ * xOut, yOut, zOut ... the transformed coordinates (divided by w if not 0)
+ *   (may be the same arrays as x, y, z)
+ * outcodes ... the outcodes of the transformed coordinates (see Outcode)
+ */
+void transformPoints(
+  const Mat4x4f &mat, size_t n,
+  const float x[], const float y[], const float z[],
+  float xOut[], float yOut[], float zOut[], std::uint8_t outcodes[]);
+
+/* computes the diffuse lighting of normals given as structure of arrays.
+ *
+ * The factor for the color of a vertex is
+ * ambient + (1 - ambient) * max(dot(light, normal), 0)
+ * where normal is transformed by mat (as in transformVec()).
+ * (Actually, the light is transformed once by the transposed matrix
+ * instead of every normal.)
+ * The normals are processed in batches as in transformPoints().
+ *
+ * mat ... the transformation of normals
+ * n ... number of normals
+ * nx, ny, nz ... the normals
+ * light ... the light vector
+ * ambient ... ratio of ambient light
+ * fFront ... the factors for light (i.e. for the front side of faces)
+ * fBack ... the factors for -light (i.e. for the back side of faces)
+ */
+void lightNormals(
+  const Mat4x4f &mat, size_t n,
+  const float nx[], const float ny[], const float nz[],
+  const Vec3f &light, float ambient, float fFront[], float fBack[]);
+
 /* builds a symmetrical perspective view matrix.
  *
  * fov ... vertical field of view (in rad.)
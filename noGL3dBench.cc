@@ -0,0 +1,403 @@
+// benchmark of rasterizer (without Qt)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Histogram.h"
+#include "RenderContext.h"
+#include "Scene.h"
+#include "Sphere.h"
+
+namespace {
+
+const char *const usage =
+  "Usage: noGL3dBench [OPTIONS]\n"
+  "Measures the render times for all combinations of rasterizer modes\n"
+  "and writes the results as JSON.\n"
+  "\n"
+  "Options:\n"
+  "  -o FILE     output file (default: stdout)\n"
+  "  -n N        number of measured repetitions (default: 10)\n"
+  "  -w N        number of warm-up frames (default: 3)\n"
+  "  -r RES      max. resolution of sphere (default: 5)\n"
+  "  -v SIZES    viewport sizes as comma separated list of WxH\n"
+  "              (default: 320x240,640x480,1280x720,1920x1080,3840x2160)\n"
+  "  -t EDGES    edge lengths of triangles (in pixels) as comma separated\n"
+  "              list (default: 1,2,4,8,16,32,64,128)\n"
+  "  -s SIZE     viewport size for triangle sizes (default: 1280x720)\n"
+  "  -m MODES    indices of mode combinations as comma separated list\n"
+  "              (default: all 24)\n"
+  "  -j N        number of worker threads (default: cores - 1)\n"
+  "  -b N        number of raster bands (default: 0)\n"
+  "  -V RES      resolution of sphere for vertex throughput (default: 8)\n"
+  "  -q          quick run: -n 3 -w 1 -r 3 -v 320x240,640x480 -t 4,32 -V 6\n";
+
+// number of rasterizer mode combinations
+const uint NCombos = 24;
+
+// names of depth modes
+const char *const depthModeNames[] = { "none", "write", "checkAndWrite" };
+
+// rasterizer mode combination (as indexed in RenderContext)
+struct Combo {
+  uint depthMode; bool smooth, blend, tex;
+  explicit Combo(uint i):
+    depthMode(i % 3), smooth((i / 3) % 2 != 0),
+    blend((i / 6) % 2 != 0), tex((i / 12) % 2 != 0)
+  { }
+  void apply(RenderContext &context) const
+  {
+    context.enable(RenderContext::DepthBuffer, depthMode > 0);
+    context.enable(RenderContext::DepthTest, depthMode > 1);
+    context.enable(RenderContext::Smooth, smooth);
+    context.enable(RenderContext::Blending, blend);
+    context.enable(RenderContext::Texturing, tex);
+  }
+};
+
+struct Size { uint width, height; };
+
+// settings of benchmark
+struct Settings {
+  uint nReps = 10, nWarmUp = 3;
+  uint resMax = 5;
+  uint resVtcs = 8;
+  std::vector<Size> viewports = {
+    { 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 },
+    { 3840, 2160 }
+  };
+  std::vector<uint> edges = { 1, 2, 4, 8, 16, 32, 64, 128 };
+  Size viewportTris = { 1280, 720 };
+  std::vector<uint> combos;
+  uint nThreads = JobSystem::getDefaultThreads();
+  uint nRasterBands = 0;
+};
+
+// statistics of measured frame times (in ms)
+struct Stats {
+  double min, p50, p90, p99, max, mean;
+  explicit Stats(std::vector<double> dts)
+  {
+    std::sort(dts.begin(), dts.end());
+    min = dts.front(); max = dts.back();
+    p50 = getPercentile(dts, 0.50); p90 = getPercentile(dts, 0.90);
+    p99 = getPercentile(dts, 0.99);
+    mean = 0.0; for (double dt : dts) mean += dt;
+    mean /= dts.size();
+  }
+};
+
+bool parseList(const char *arg, std::vector<uint> &values)
+{
+  values.clear();
+  for (const char *value = arg; *value;) {
+    uint v; int len;
+    if (std::sscanf(value, "%u%n", &v, &len) != 1) return false;
+    values.push_back(v);
+    value += len;
+    if (*value == ',') ++value;
+    else if (*value) return false;
+  }
+  return !values.empty();
+}
+
+bool parseSizes(const char *arg, std::vector<Size> &sizes)
+{
+  sizes.clear();
+  for (const char *value = arg; *value;) {
+    Size size; int len;
+    if (std::sscanf(value, "%ux%u%n", &size.width, &size.height, &len) != 2
+      || !size.width || !size.height) return false;
+    sizes.push_back(size);
+    value += len;
+    if (*value == ',') ++value;
+    else if (*value) return false;
+  }
+  return !sizes.empty();
+}
+
+// makes a checker texture with semi-transparent fields
+std::vector<uint32> makeCheckerTex(uint size)
+{
+  std::vector<uint32> img(size * size);
+  for (uint y = 0; y < size; ++y) {
+    for (uint x = 0; x < size; ++x) {
+      img[y * size + x] = ((x / 8 + y / 8) & 1) ? 0xff2040e0 : 0x80f0f0f0;
+    }
+  }
+  return img;
+}
+
+// makes a grid of triangles covering the viewport once
+void makeTriGrid(
+  MeshT<VertexCNT> &mesh, uint width, uint height, uint edge)
+{
+  mesh.vtcs.clear(); mesh.idcs.clear();
+  const uint nX = std::max(width / edge, 1u), nY = std::max(height / edge, 1u);
+  mesh.vtcs.reserve(6 * nX * nY);
+  const Vec3f normal(0.0f, 0.0f, 1.0f);
+  for (uint iY = 0; iY < nY; ++iY) {
+    const float y0 = 1.0f - 2.0f * iY * edge / height;
+    const float y1 = 1.0f - 2.0f * (iY + 1) * edge / height;
+    for (uint iX = 0; iX < nX; ++iX) {
+      const float x0 = -1.0f + 2.0f * iX * edge / width;
+      const float x1 = -1.0f + 2.0f * (iX + 1) * edge / width;
+      const float u0 = (float)iX / nX, u1 = (float)(iX + 1) / nX;
+      const float v0 = (float)iY / nY, v1 = (float)(iY + 1) / nY;
+      // counter-clockwise (front side)
+      mesh.vtcs.emplace_back(Vec3f(x0, y0, 0.0f), normal, Vec2f(u0, v0));
+      mesh.vtcs.emplace_back(Vec3f(x0, y1, 0.0f), normal, Vec2f(u0, v1));
+      mesh.vtcs.emplace_back(Vec3f(x1, y1, 0.0f), normal, Vec2f(u1, v1));
+      mesh.vtcs.emplace_back(Vec3f(x0, y0, 0.0f), normal, Vec2f(u0, v0));
+      mesh.vtcs.emplace_back(Vec3f(x1, y1, 0.0f), normal, Vec2f(u1, v1));
+      mesh.vtcs.emplace_back(Vec3f(x1, y0, 0.0f), normal, Vec2f(u1, v0));
+    }
+  }
+}
+
+// measures the render times of a mesh for all mode combinations
+void measure(
+  FILE *out, bool &first, const Settings &settings,
+  const char *suite, uint width, uint height, uint param,
+  RenderContext &context, const MeshT<VertexCNT> &mesh, double nPixels)
+{
+  context.setRenderCallback(
+    [&](RenderContext &context) {
+      context.clear(true, true);
+      context.setColor(Vec4f(1.0f, 1.0f, 1.0f, 0.75f));
+      drawMesh(context, mesh);
+    });
+  const double nTris = (double)getNTris(mesh);
+  std::vector<double> dts(settings.nReps);
+  for (uint iCombo : settings.combos) {
+    const Combo combo(iCombo);
+    combo.apply(context);
+    for (uint i = 0; i < settings.nWarmUp; ++i) context.render();
+    for (double &dt : dts) {
+      const std::chrono::steady_clock::time_point t0
+        = std::chrono::steady_clock::now();
+      context.render();
+      dt = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+    }
+    const Stats stats(dts);
+    std::fprintf(stderr, "%s %ux%u %s%u combo %2u: %9.3f ms\n",
+      suite, width, height, suite[0] == 's' ? "res " : "edge ", param,
+      iCombo, stats.p50);
+    std::fprintf(out,
+      "%s\n    { \"suite\": \"%s\", \"width\": %u, \"height\": %u, "
+      "\"%s\": %u,\n"
+      "      \"combo\": %u, \"depth\": \"%s\", \"smooth\": %s, "
+      "\"blend\": %s, \"tex\": %s,\n"
+      "      \"tris\": %.0f, \"pixels\": %.0f,\n"
+      "      \"ms\": { \"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, "
+      "\"p99\": %.6f, \"max\": %.6f, \"mean\": %.6f },\n"
+      "      \"nsPerPixel\": %.3f, \"nsPerTri\": %.3f }",
+      first ? "" : ",", suite, width, height,
+      suite[0] == 's' ? "res" : "edge", param,
+      iCombo, depthModeNames[combo.depthMode],
+      combo.smooth ? "true" : "false", combo.blend ? "true" : "false",
+      combo.tex ? "true" : "false",
+      nTris, nPixels,
+      stats.min, stats.p50, stats.p90, stats.p99, stats.max, stats.mean,
+      1E6 * stats.p50 / nPixels, nTris > 0 ? 1E6 * stats.p50 / nTris : 0.0);
+    std::fflush(out);
+    first = false;
+  }
+}
+
+// returns outcode of a point (as transformPoints())
+uint getOutcode(const Vec3f &p)
+{
+  return !(p.x >= -1.0f) * OutLeft | !(p.x <= 1.0f) * OutRight
+    | !(p.y >= -1.0f) * OutBottom | !(p.y <= 1.0f) * OutTop
+    | !(p.z >= -1.0f) * OutNear | !(p.z <= 1.0f) * OutFar;
+}
+
+/* measures the throughput of the vertex stage for the vertices of a mesh:
+ * scalar (vertex by vertex as in drawMesh()) vs. batches (as for MeshSoA)
+ */
+void measureVertices(
+  FILE *out, bool &first, const Settings &settings, uint res,
+  const MeshT<VertexCNT> &mesh)
+{
+  MeshSoA meshSoA; convertToSoA(mesh, meshSoA);
+  const size_t n = mesh.vtcs.size();
+  const Mat4x4f matModel
+    = Mat4x4f(InitRotY, 0.5f) * Mat4x4f(InitRotX, 0.3f);
+  const Mat4x4f matMVP
+    = makePersp(degToRad(60.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+    * Mat4x4f(InitTrans, Vec3f(0.0f, 0.0f, -2.5f)) * matModel;
+  const Vec3f light = normalize(Vec3f(1.0f, 1.0f, 1.0f));
+  const float ambient = 0.2f;
+  // results (SoA for both)
+  std::vector<float> x(n), y(n), z(n), fFront(n), fBack(n);
+  std::vector<std::uint8_t> outcodes(n);
+  auto runScalar = [&]() {
+    for (size_t i = 0; i < n; ++i) {
+      const VertexCNT &vtx = mesh.vtcs[i];
+      const Vec3f coord = transformPoint(matMVP, vtx.coord);
+      x[i] = coord.x; y[i] = coord.y; z[i] = coord.z;
+      outcodes[i] = (std::uint8_t)getOutcode(coord);
+      const float d = dot(light, transformVec(matModel, vtx.normal));
+      fFront[i] = ambient + (1.0f - ambient) * std::max(d, 0.0f);
+      fBack[i] = ambient + (1.0f - ambient) * std::max(-d, 0.0f);
+    }
+  };
+  auto runBatch = [&]() {
+    transformPoints(matMVP, n,
+      meshSoA.x.data(), meshSoA.y.data(), meshSoA.z.data(),
+      x.data(), y.data(), z.data(), outcodes.data());
+    lightNormals(matModel, n,
+      meshSoA.nx.data(), meshSoA.ny.data(), meshSoA.nz.data(),
+      light, ambient, fFront.data(), fBack.data());
+  };
+  std::vector<double> dts(settings.nReps);
+  for (uint iKernel = 0; iKernel < 2; ++iKernel) {
+    const char *const kernel = iKernel ? "batch" : "scalar";
+    for (uint i = 0; i < settings.nWarmUp; ++i) {
+      iKernel ? runBatch() : runScalar();
+    }
+    for (double &dt : dts) {
+      const std::chrono::steady_clock::time_point t0
+        = std::chrono::steady_clock::now();
+      iKernel ? runBatch() : runScalar();
+      dt = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+    }
+    const Stats stats(dts);
+    const double vtcsPerS = 1E3 * n / stats.p50;
+    std::fprintf(stderr, "vertices res %u %s: %9.3f ms, %.1f M vertices/s\n",
+      res, kernel, stats.p50, 1E-6 * vtcsPerS);
+    std::fprintf(out,
+      "%s\n    { \"suite\": \"vertices\", \"res\": %u, "
+      "\"kernel\": \"%s\", \"vtcs\": %u,\n"
+      "      \"ms\": { \"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, "
+      "\"p99\": %.6f, \"max\": %.6f, \"mean\": %.6f },\n"
+      "      \"vtcsPerS\": %.0f }",
+      first ? "" : ",", res, kernel, (uint)n,
+      stats.min, stats.p50, stats.p90, stats.p99, stats.max, stats.mean,
+      vtcsPerS);
+    std::fflush(out);
+    first = false;
+  }
+}
+
+// sets up a render context for the benchmark
+void init(RenderContext &context, const Settings &settings)
+{
+  context.setThreads(settings.nThreads);
+  context.setRasterBands(settings.nRasterBands);
+  const std::vector<uint32> img = makeCheckerTex(256);
+  context.setTex(context.loadTex(256, 256, img.data()));
+  context.enable(RenderContext::Lighting);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  Settings settings;
+  const char *fileOut = nullptr;
+  // process command line
+  for (int i = 1; i < argc; ++i) {
+    const char *opt = argv[i];
+    if (std::strcmp(opt, "-h") == 0 || std::strcmp(opt, "--help") == 0) {
+      std::fputs(usage, stdout); return 0;
+    }
+    if (std::strcmp(opt, "-q") == 0) {
+      settings.nReps = 3; settings.nWarmUp = 1; settings.resMax = 3;
+      settings.viewports = { { 320, 240 }, { 640, 480 } };
+      settings.edges = { 4, 32 };
+      settings.resVtcs = 6;
+      continue;
+    }
+    const char *arg = i + 1 < argc ? argv[++i] : nullptr;
+    bool ok = arg && opt[0] == '-' && opt[1] && !opt[2];
+    std::vector<Size> sizes;
+    if (ok) {
+      switch (opt[1]) {
+        case 'o': fileOut = arg; break;
+        case 'n':
+          ok = std::sscanf(arg, "%u", &settings.nReps) == 1
+            && settings.nReps > 0;
+          break;
+        case 'w': ok = std::sscanf(arg, "%u", &settings.nWarmUp) == 1; break;
+        case 'r': ok = std::sscanf(arg, "%u", &settings.resMax) == 1; break;
+        case 'V': ok = std::sscanf(arg, "%u", &settings.resVtcs) == 1; break;
+        case 'v': ok = parseSizes(arg, settings.viewports); break;
+        case 't': ok = parseList(arg, settings.edges); break;
+        case 's':
+          ok = parseSizes(arg, sizes) && sizes.size() == 1;
+          if (ok) settings.viewportTris = sizes[0];
+          break;
+        case 'm': ok = parseList(arg, settings.combos); break;
+        case 'j':
+          ok = std::sscanf(arg, "%u", &settings.nThreads) == 1;
+          break;
+        case 'b':
+          ok = std::sscanf(arg, "%u", &settings.nRasterBands) == 1;
+          break;
+        default: ok = false;
+      }
+    }
+    for (uint edge : settings.edges) ok &= edge > 0;
+    for (uint iCombo : settings.combos) ok &= iCombo < NCombos;
+    if (!ok) {
+      std::fprintf(stderr, "ERROR: Wrong option '%s'!\n\n%s", opt, usage);
+      return 1;
+    }
+  }
+  if (settings.combos.empty()) {
+    for (uint i = 0; i < NCombos; ++i) settings.combos.push_back(i);
+  }
+  FILE *out = fileOut ? std::fopen(fileOut, "w") : stdout;
+  if (!out) {
+    std::fprintf(stderr, "ERROR: Cannot open '%s'!\n", fileOut);
+    return 1;
+  }
+  std::fprintf(out,
+    "{\n  \"compiler\": \"%s\",\n  \"threads\": %u, \"rasterBands\": %u,\n"
+    "  \"warmUp\": %u, \"repetitions\": %u,\n  \"results\": [",
+#if defined(__VERSION__)
+    __VERSION__,
+#else
+    "unknown",
+#endif // __VERSION__
+    settings.nThreads, settings.nRasterBands,
+    settings.nWarmUp, settings.nReps);
+  bool first = true;
+  MeshT<VertexCNT> mesh;
+  // suite 1: sphere (demo scene) in all resolutions and viewport sizes
+  for (const Size &size : settings.viewports) {
+    RenderContext context(size.width, size.height);
+    init(context, settings);
+    initDemoScene(context);
+    for (uint res = 0; res <= settings.resMax; ++res) {
+      makeSphereMeshIndexed(mesh, res, &context.getJobSystem());
+      measure(out, first, settings, "sphere", size.width, size.height, res,
+        context, mesh, (double)size.width * size.height);
+    }
+  }
+  // suite 2: screen filled with triangles of certain size
+  { const Size &size = settings.viewportTris;
+    RenderContext context(size.width, size.height);
+    init(context, settings);
+    for (uint edge : settings.edges) {
+      makeTriGrid(mesh, size.width, size.height, edge);
+      const double nPixels = 0.5 * edge * edge * getNTris(mesh);
+      measure(out, first, settings, "tris", size.width, size.height, edge,
+        context, mesh, nPixels);
+    }
+  }
+  // suite 3: throughput of vertex stage (scalar vs. batches)
+  makeSphereMeshIndexed(mesh, settings.resVtcs);
+  measureVertices(out, first, settings, settings.resVtcs, mesh);
+  std::fprintf(out, "\n  ]\n}\n");
+  if (out != stdout) std::fclose(out);
+  return 0;
+}
@@ -0,0 +1,437 @@
+// headless renderer of demo scene (without Qt)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "color.h"
+#include "Histogram.h"
+#include "image.h"
+#include "MeshOpt.h"
+#include "RenderContext.h"
+#include "Scene.h"
+#include "Session.h"
+#include "Sphere.h"
+
+namespace {
+
+const char *const usage =
+  "Usage: noGL3dRender [OPTIONS]\n"
+  "Renders the scene of qNoGL3dDemo into an image file.\n"
+  "\n"
+  "Options:\n"
+  "  -o FILE     output image (.png or .ppm, default: noGL3d.png)\n"
+  "  -s WxH      size of image (default: 1024x768)\n"
+  "  -x SCALE    render scale in (0, 1], i.e. render with fewer pixels\n"
+  "              and scale image up bilinearly (default: 1)\n"
+  "  -r RES      resolution of sphere (default: 4)\n"
+  "  -e PX       tessellate sphere adaptively per frame up to this error\n"
+  "              on screen (in pixels, -r is max. depth, default: off)\n"
+  "  -O N        optimize order of sphere mesh for a vertex cache with N\n"
+  "              entries and report ACMR and overdraw (default: off)\n"
+  "  -f FORMAT   vertex format of sphere: float, quantized (16 bit coord.,\n"
+  "              octahedral normal, 16 bit tex. coord.), coords (coord.\n"
+  "              only, with current normal and tex. coord.), soa (structure\n"
+  "              of arrays, transformed in batches, default: float)\n"
+  "  -m MODES    enabled modes as comma separated list of\n"
+  "              front, back, depthbuffer, depthtest, smooth, blending,\n"
+  "              texturing, lighting, heatmap (default: front)\n"
+  "  -a AMBIENT  ambient light in [0, 1] (default: 0.2)\n"
+  "  -c X,Y,Z    position of camera (default: 0,0,2.5)\n"
+  "  -y ANGLE    rotation of sphere about y axis in degrees (default: 0)\n"
+  "  -t FILE     texture (binary PPM, size a power of 2)\n"
+  "  -j N        number of worker threads (default: cores - 1)\n"
+  "  -b N        number of raster bands (default: 0)\n"
+  "  -n N        number of frames to render (default: 1)\n"
+  "  -p FILE     profile render stages and write Chrome trace (.json)\n"
+  "  -H FILE     output heatmap image (.png or .ppm, enables heatmap)\n"
+  "  -k KIND     kind of heatmap: writes, depthfailed, blended, fragments\n"
+  "              (default: fragments)\n"
+  "  -T FILE     record API trace of rendered frames (see noGL3dReplay)\n"
+  "  -S FILE     replay recorded session (camera, model, modes, res.\n"
+  "              of sphere per frame; -n N repeats it N times)\n"
+  "  -C FILE     output timings of session frames (.csv)\n";
+
+// names of modes (in order of RenderContext::Mode)
+const char *const modeNames[RenderContext::NModes] = {
+  "front", "back", "depthbuffer", "depthtest",
+  "smooth", "blending", "texturing", "lighting", "heatmap"
+};
+
+// vertex formats of sphere
+enum Format {
+  FormatFloat, FormatQuantized, FormatCoords, FormatSoA, NFormats
+};
+
+// names of vertex formats (in order of Format)
+const char *const formatNames[NFormats] = {
+  "float", "quantized", "coords", "soa"
+};
+
+// names of heatmap kinds (in order of RenderContext::HeatKind)
+const char *const heatKindNames[RenderContext::NHeatKinds] = {
+  "writes", "depthfailed", "blended", "fragments"
+};
+
+// parses kind of heatmap
+bool parseHeatKind(const char *arg, RenderContext::HeatKind &kind)
+{
+  for (uint i = 0; i < RenderContext::NHeatKinds; ++i) {
+    if (std::strcmp(heatKindNames[i], arg) == 0) {
+      kind = (RenderContext::HeatKind)i; return true;
+    }
+  }
+  return false;
+}
+
+// parses comma separated modes
+bool parseModes(const char *arg, uint &mode)
+{
+  mode = 0;
+  for (const char *name = arg; *name;) {
+    const size_t len = std::strcspn(name, ",");
+    uint i = 0;
+    for (; i < RenderContext::NModes; ++i) {
+      if (std::strlen(modeNames[i]) == len
+        && std::strncmp(modeNames[i], name, len) == 0) break;
+    }
+    if (i == RenderContext::NModes) return false;
+    mode |= 1 << i;
+    name += len; if (*name) ++name;
+  }
+  return true;
+}
+
+// loads a texture from PPM file (flipped to make lower, left texel (0, 0))
+uint loadTex(RenderContext &context, const char *file)
+{
+  uint width, height; std::vector<uint32> img;
+  if (!readPPM(file, width, height, img)) return 0;
+  for (uint y = 0; y < height / 2; ++y) {
+    std::swap_ranges(
+      img.begin() + (size_t)y * width, img.begin() + (size_t)(y + 1) * width,
+      img.begin() + (size_t)(height - 1 - y) * width);
+  }
+  return context.loadTex(width, height, img.data());
+}
+
+// converts the sphere into a vertex format (other than float)
+void convertSphere(
+  const MeshT<VertexCNT> &mesh, Format format,
+  MeshT<VertexQCNT> &meshQ, MeshT<VertexC> &meshC, MeshSoA &meshSoA)
+{
+  switch (format) {
+    case FormatQuantized: quantizeMesh(mesh, meshQ); break;
+    case FormatCoords:
+      meshC.vtcs.resize(mesh.vtcs.size());
+      for (size_t i = 0; i < mesh.vtcs.size(); ++i) {
+        meshC.vtcs[i].coord = mesh.vtcs[i].coord;
+      }
+      meshC.idcs = mesh.idcs;
+      break;
+    case FormatSoA: convertToSoA(mesh, meshSoA); break;
+    default: break;
+  }
+}
+
+// returns overdraw (writes per covered pixel) of a frame (not timed)
+double getOverdraw(RenderContext &context)
+{
+  const bool heatmap = context.isEnabled(RenderContext::Heatmap);
+  context.enable(RenderContext::Heatmap);
+  context.render();
+  uint64_t sum = 0; uint nPixels = 0;
+  for (uint y = 0; y < context.getRenderHeight(); ++y) {
+    for (uint x = 0; x < context.getRenderWidth(); ++x) {
+      const uint value = context.getHeat(RenderContext::HeatWrites, x, y);
+      sum += value; nPixels += value > 0;
+    }
+  }
+  context.enable(RenderContext::Heatmap, heatmap);
+  return nPixels ? (double)sum / nPixels : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  // default settings
+  std::string fileOut = "noGL3d.png";
+  uint width = 1024, height = 768;
+  float renderScale = 1.0f;
+  uint resSphere = 4;
+  float errorSphere = 0.0f;
+  uint cacheSizeOpt = 0;
+  Format format = FormatFloat;
+  uint mode = 1 << RenderContext::FrontSide;
+  float ambient = 0.2f;
+  Vec3f posCam(0.0f, 0.0f, 2.5f);
+  float angle = 0.0f;
+  const char *fileTex = nullptr;
+  uint nThreads = JobSystem::getDefaultThreads();
+  uint nRasterBands = 0;
+  uint nFrames = 1;
+  const char *fileTrace = nullptr;
+  const char *fileHeat = nullptr;
+  const char *fileApiTrace = nullptr;
+  const char *fileSession = nullptr;
+  const char *fileTimings = nullptr;
+  RenderContext::HeatKind heatKind = RenderContext::HeatFragments;
+  // process command line
+  for (int i = 1; i < argc; ++i) {
+    const char *opt = argv[i];
+    if (std::strcmp(opt, "-h") == 0 || std::strcmp(opt, "--help") == 0) {
+      std::fputs(usage, stdout); return 0;
+    }
+    const char *arg = i + 1 < argc ? argv[++i] : nullptr;
+    bool ok = arg && opt[0] == '-' && opt[1] && !opt[2];
+    if (ok) {
+      switch (opt[1]) {
+        case 'o': fileOut = arg; break;
+        case 's':
+          ok = std::sscanf(arg, "%ux%u", &width, &height) == 2
+            && width > 0 && height > 0;
+          break;
+        case 'x':
+          ok = std::sscanf(arg, "%f", &renderScale) == 1
+            && renderScale > 0.0f && renderScale <= 1.0f;
+          break;
+        case 'r': ok = std::sscanf(arg, "%u", &resSphere) == 1; break;
+        case 'e':
+          ok = std::sscanf(arg, "%f", &errorSphere) == 1 && errorSphere >= 0;
+          break;
+        case 'O': ok = std::sscanf(arg, "%u", &cacheSizeOpt) == 1; break;
+        case 'f':
+          ok = false;
+          for (uint j = 0; j < NFormats && !ok; ++j) {
+            if ((ok = std::strcmp(arg, formatNames[j]) == 0)) {
+              format = (Format)j;
+            }
+          }
+          break;
+        case 'm': ok = parseModes(arg, mode); break;
+        case 'a': ok = std::sscanf(arg, "%f", &ambient) == 1; break;
+        case 'c':
+          ok = std::sscanf(arg, "%f,%f,%f", &posCam.x, &posCam.y, &posCam.z)
+            == 3;
+          break;
+        case 'y': ok = std::sscanf(arg, "%f", &angle) == 1; break;
+        case 't': fileTex = arg; break;
+        case 'j': ok = std::sscanf(arg, "%u", &nThreads) == 1; break;
+        case 'b': ok = std::sscanf(arg, "%u", &nRasterBands) == 1; break;
+        case 'n':
+          ok = std::sscanf(arg, "%u", &nFrames) == 1 && nFrames > 0;
+          break;
+        case 'p': fileTrace = arg; break;
+        case 'H': fileHeat = arg; mode |= 1 << RenderContext::Heatmap; break;
+        case 'k': ok = parseHeatKind(arg, heatKind); break;
+        case 'T': fileApiTrace = arg; break;
+        case 'S': fileSession = arg; break;
+        case 'C': fileTimings = arg; break;
+        default: ok = false;
+      }
+    }
+    if (!ok) {
+      std::fprintf(stderr, "ERROR: Wrong option '%s'!\n\n%s", opt, usage);
+      return 1;
+    }
+  }
+  // set up render context
+  RenderContext context(width, height);
+  context.setRenderScale(renderScale);
+  const uint widthR = context.getRenderWidth();
+  const uint heightR = context.getRenderHeight();
+  context.setThreads(nThreads);
+  context.setRasterBands(nRasterBands);
+  initDemoScene(context);
+  context.setCamMat(Mat4x4f(InitTrans, posCam));
+  context.getModelMat() = Mat4x4f(InitRotY, degToRad(angle));
+  for (uint i = 0; i < RenderContext::NModes; ++i) {
+    context.enable((RenderContext::Mode)i, (mode & 1 << i) != 0);
+  }
+  context.setAmbient(ambient);
+  if (fileTex) {
+    const uint iTex = loadTex(context, fileTex);
+    if (!iTex) {
+      std::fprintf(stderr, "ERROR: Cannot load texture '%s'!\n", fileTex);
+      return 1;
+    }
+    context.setTex(iTex);
+  }
+  Session session;
+  if (fileSession && !session.load(fileSession)) {
+    std::fprintf(stderr, "ERROR: Cannot read '%s': %s\n",
+      fileSession, session.getError().c_str());
+    return 1;
+  }
+  if (fileSession && !session.size()) {
+    std::fprintf(stderr, "ERROR: Session '%s' is empty!\n", fileSession);
+    return 1;
+  }
+  // build sphere (and keep every resolution used in session)
+  SphereMeshCacheT<MeshT<VertexCNT>> spheres;
+  const MeshT<VertexCNT> *pMesh
+    = &spheres.get(resSphere, &context.getJobSystem());
+  MeshT<VertexCNT> meshAdaptive; // re-built per frame (if enabled)
+  MeshT<VertexQCNT> meshQ; // quantized sphere (if enabled)
+  MeshT<VertexC> meshC; // sphere with coordinates only (if enabled)
+  MeshSoA meshSoA; // sphere as structure of arrays (if enabled)
+  if (errorSphere > 0.0f) pMesh = &meshAdaptive;
+  // render
+  context.setRenderCallback(
+    [&](RenderContext &context) {
+      if (errorSphere > 0.0f) { // tessellate for current view
+        const SphereTessellation tess(
+          context.getProjMat(), context.getViewMat(), context.getModelMat(),
+          widthR, heightR, errorSphere * context.getRenderScale(), resSphere,
+          !context.isEnabled(RenderContext::BackSide));
+        makeSphereMeshAdaptive(meshAdaptive, tess);
+      }
+      context.clear(true, true);
+      context.setColor(Vec4f(1.0f, 1.0f, 1.0f, 1.0f));
+      if (!meshQ.vtcs.empty()) drawMesh(context, meshQ);
+      else if (!meshC.vtcs.empty()) drawMesh(context, meshC);
+      else if (meshSoA.size()) drawMesh(context, meshSoA);
+      else drawMesh(context, *pMesh);
+    });
+  MeshT<VertexCNT> meshOpt; // optimized sphere (if enabled)
+  if (cacheSizeOpt && errorSphere <= 0.0f) {
+    meshOpt = *pMesh;
+    const float acmr0
+      = getACMR(meshOpt.idcs, meshOpt.vtcs.size(), cacheSizeOpt);
+    const double overdraw0 = getOverdraw(context);
+    optimizeMesh(meshOpt, cacheSizeOpt);
+    pMesh = &meshOpt;
+    const float acmr1
+      = getACMR(meshOpt.idcs, meshOpt.vtcs.size(), cacheSizeOpt);
+    const double overdraw1 = getOverdraw(context);
+    std::printf("Optimized sphere for cache of %u: "
+      "ACMR %.3f -> %.3f, overdraw %.3f -> %.3f\n",
+      cacheSizeOpt, acmr0, acmr1, overdraw0, overdraw1);
+  }
+  if (format != FormatFloat && errorSphere <= 0.0f) {
+    convertSphere(*pMesh, format, meshQ, meshC, meshSoA);
+    std::printf("Sphere in format %s: %u instead of %u bytes per vertex.\n",
+      formatNames[format],
+      (uint)(format == FormatQuantized ? sizeof (VertexQCNT)
+        : format == FormatCoords ? sizeof (VertexC) : 8 * sizeof (float)),
+      (uint)sizeof (VertexCNT));
+  }
+  if (fileApiTrace && !context.startApiTrace(fileApiTrace)) {
+    std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileApiTrace);
+    return 1;
+  }
+  Profiler &profiler = context.getProfiler();
+  if (fileTrace) {
+    std::string error;
+    if (!profiler.enablePerf(true, &error)) {
+      std::fprintf(stderr, "HW counters not available: %s\n", error.c_str());
+    }
+    profiler.startTrace(); profiler.enable();
+  }
+  if (fileSession) {
+    // replay session at full speed
+    std::vector<double> dts;
+    dts.reserve((size_t)nFrames * session.size());
+    for (uint i = 0; i < nFrames; ++i) {
+      for (const Session::Frame &frame : session.getFrames()) {
+        if (frame.resSphere != resSphere) { // not timed (as in GUI)
+          resSphere = frame.resSphere;
+          if (errorSphere <= 0.0f) {
+            pMesh = &spheres.get(resSphere, &context.getJobSystem());
+            if (cacheSizeOpt) {
+              meshOpt = *pMesh; optimizeMesh(meshOpt, cacheSizeOpt);
+              pMesh = &meshOpt;
+            }
+            convertSphere(*pMesh, format, meshQ, meshC, meshSoA);
+          }
+        }
+        context.getProjMat() = frame.matProj;
+        context.setCamMat(frame.matCam);
+        context.getModelMat() = frame.matModel;
+        for (uint j = 0; j < RenderContext::NModes; ++j) {
+          context.enable((RenderContext::Mode)j, (frame.mode & 1 << j) != 0);
+        }
+        context.setAmbient(frame.ambient);
+        const std::chrono::steady_clock::time_point t0
+          = std::chrono::steady_clock::now();
+        context.render();
+        dts.push_back(std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - t0).count());
+      }
+    }
+    if (fileTimings && !session.saveTimings(fileTimings, dts)) {
+      std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileTimings);
+      return 1;
+    }
+    double sum = 0.0;
+    for (double dt : dts) sum += dt;
+    std::sort(dts.begin(), dts.end());
+    std::printf("Replayed session of %u frames (%ux%u): "
+      "min %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f, mean %.3f ms\n",
+      (uint)dts.size(), widthR, heightR, 1000.0 * dts.front(),
+      1000.0 * getPercentile(dts, 0.50), 1000.0 * getPercentile(dts, 0.90),
+      1000.0 * getPercentile(dts, 0.99), 1000.0 * dts.back(),
+      1000.0 * sum / dts.size());
+  } else {
+    const std::chrono::steady_clock::time_point tStart
+      = std::chrono::steady_clock::now();
+    for (uint i = 0; i < nFrames; ++i) context.render();
+    const double dt = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - tStart).count();
+    std::printf("Rendered %u Tris (%ux%u) in %f s.\n",
+      (uint)getNTris(*pMesh), widthR, heightR, dt / nFrames);
+  }
+  if (fileApiTrace && !context.stopApiTrace()) {
+    std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileApiTrace);
+    return 1;
+  }
+  // write trace
+  if (fileTrace) {
+    profiler.enable(false); profiler.stopTrace();
+    std::fputs(profiler.getSummary().c_str(), stdout);
+    std::fputs(
+      profiler.getPerfSummary(&RenderContext::getRasterizeName).c_str(),
+      stdout);
+    if (!profiler.writeTrace(fileTrace)) {
+      std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileTrace);
+      return 1;
+    }
+  }
+  // write output (scaled up to full size)
+  std::vector<uint32> img;
+  const uint32 *rgba = context.getRGBA();
+  if (widthR != width || heightR != height) {
+    img.resize((size_t)width * height);
+    scaleBilinear(widthR, heightR, rgba, width, height, img.data(),
+      &context.getJobSystem());
+    rgba = img.data();
+  }
+  if (!writeImage(fileOut, width, height, rgba)) {
+    std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileOut.c_str());
+    return 1;
+  }
+  // write heatmap
+  if (fileHeat) { // in render size
+    const uint max = context.getHeatmap(heatKind, img);
+    uint64_t sum = 0; uint nPixels = 0;
+    for (uint y = 0; y < heightR; ++y) {
+      for (uint x = 0; x < widthR; ++x) {
+        const uint value = context.getHeat(heatKind, x, y);
+        sum += value; nPixels += value > 0;
+      }
+    }
+    std::printf("Heatmap (%s): max. %u, mean %.3f over %u pixels.\n",
+      heatKindNames[heatKind], max, nPixels ? (double)sum / nPixels : 0.0,
+      nPixels);
+    if (!writeImage(fileHeat, widthR, heightR, img.data())) {
+      std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileHeat);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,197 @@
+// headless replay of API traces (without Qt)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ApiTrace.h"
+#include "color.h"
+#include "CommandBuffer.h"
+#include "Histogram.h"
+#include "image.h"
+#include "RenderContext.h"
+
+namespace {
+
+const char *const usage =
+  "Usage: noGL3dReplay [OPTIONS] TRACE\n"
+  "Replays an API trace (recorded with RenderContext::startApiTrace())\n"
+  "and reports the render time of each frame.\n"
+  "\n"
+  "Options:\n"
+  "  -f FRAME    replay only this frame (0 ... first frame)\n"
+  "  -n N        number of repetitions, e.g. to loop one frame\n"
+  "              for profiling (default: 1)\n"
+  "  -w N        number of warm-up repetitions (default: 0)\n"
+  "  -o FILE     output image of last replayed frame (.png or .ppm)\n"
+  "  -p FILE     profile render stages and write Chrome trace (.json)\n"
+  "  -j N        number of worker threads (default: cores - 1)\n"
+  "  -b N        number of raster bands (default: 0)\n"
+  "  -v          print time of every replayed frame\n";
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  // default settings
+  const char *fileTrace = nullptr;
+  int iFrame = -1;
+  uint nReps = 1, nWarmUp = 0;
+  const char *fileOut = nullptr;
+  const char *fileProfile = nullptr;
+  uint nThreads = JobSystem::getDefaultThreads();
+  uint nRasterBands = 0;
+  bool verbose = false;
+  // process command line
+  for (int i = 1; i < argc; ++i) {
+    const char *opt = argv[i];
+    if (std::strcmp(opt, "-h") == 0 || std::strcmp(opt, "--help") == 0) {
+      std::fputs(usage, stdout); return 0;
+    }
+    if (opt[0] != '-') {
+      if (fileTrace) {
+        std::fprintf(stderr, "ERROR: Too many arguments!\n\n%s", usage);
+        return 1;
+      }
+      fileTrace = opt; continue;
+    }
+    if (std::strcmp(opt, "-v") == 0) { verbose = true; continue; }
+    const char *arg = i + 1 < argc ? argv[++i] : nullptr;
+    bool ok = arg && opt[1] && !opt[2];
+    if (ok) {
+      switch (opt[1]) {
+        case 'f': ok = std::sscanf(arg, "%d", &iFrame) == 1 && iFrame >= 0;
+          break;
+        case 'n': ok = std::sscanf(arg, "%u", &nReps) == 1 && nReps > 0;
+          break;
+        case 'w': ok = std::sscanf(arg, "%u", &nWarmUp) == 1; break;
+        case 'o': fileOut = arg; break;
+        case 'p': fileProfile = arg; break;
+        case 'j': ok = std::sscanf(arg, "%u", &nThreads) == 1; break;
+        case 'b': ok = std::sscanf(arg, "%u", &nRasterBands) == 1; break;
+        default: ok = false;
+      }
+    }
+    if (!ok) {
+      std::fprintf(stderr, "ERROR: Wrong option '%s'!\n\n%s", opt, usage);
+      return 1;
+    }
+  }
+  if (!fileTrace) {
+    std::fprintf(stderr, "ERROR: Missing trace file!\n\n%s", usage);
+    return 1;
+  }
+  // open trace
+  ApiTraceReader reader;
+  if (!reader.open(fileTrace)) {
+    std::fprintf(stderr, "ERROR: Cannot read '%s': %s\n",
+      fileTrace, reader.getError().c_str());
+    return 1;
+  }
+  const uint width = reader.getWidth(), height = reader.getHeight();
+  if (!width || !height
+    || reader.getFormat() > RenderContext::ARGB32Premultiplied) {
+    std::fprintf(stderr, "ERROR: Broken header in '%s'!\n", fileTrace);
+    return 1;
+  }
+  // set up render context
+  RenderContext context(
+    width, height, (RenderContext::PixelFormat)reader.getFormat());
+  context.setThreads(nThreads);
+  context.setRasterBands(nRasterBands);
+  // read textures and frames
+  std::vector<CommandBuffer> frames;
+  for (bool end = false; !end;) {
+    switch (reader.read()) {
+      case ApiTraceReader::RecTex:
+        if (!context.loadTex(reader.getTexWidth(), reader.getTexHeight(),
+          reader.getTexImg())) {
+          std::fprintf(stderr, "ERROR: Cannot load texture!\n");
+          return 1;
+        }
+        break;
+      case ApiTraceReader::RecFrame:
+        frames.push_back(std::move(reader.getFrame()));
+        break;
+      case ApiTraceReader::RecEnd: end = true; break;
+      case ApiTraceReader::RecError:
+        std::fprintf(stderr, "ERROR: Cannot read '%s': %s\n",
+          fileTrace, reader.getError().c_str());
+        return 1;
+    }
+  }
+  if (iFrame >= (int)frames.size()) {
+    std::fprintf(stderr, "ERROR: Frame %d not in trace (%u frames)!\n",
+      iFrame, (uint)frames.size());
+    return 1;
+  }
+  const uint iFrame0 = iFrame < 0 ? 0 : (uint)iFrame;
+  const uint iFrame1 = iFrame < 0 ? (uint)frames.size() : (uint)iFrame + 1;
+  // replay
+  uint iFrameCur = iFrame0;
+  context.setRenderCallback(
+    [&](RenderContext &context) { context.execute(frames[iFrameCur]); });
+  for (uint i = 0; i < nWarmUp; ++i) {
+    for (iFrameCur = iFrame0; iFrameCur < iFrame1; ++iFrameCur) {
+      context.render();
+    }
+  }
+  Profiler &profiler = context.getProfiler();
+  if (fileProfile) { profiler.startTrace(); profiler.enable(); }
+  std::vector<double> dts;
+  dts.reserve((size_t)nReps * (iFrame1 - iFrame0));
+  for (uint i = 0; i < nReps; ++i) {
+    for (iFrameCur = iFrame0; iFrameCur < iFrame1; ++iFrameCur) {
+      const std::chrono::steady_clock::time_point t0
+        = std::chrono::steady_clock::now();
+      context.render();
+      const double dt = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+      dts.push_back(dt);
+      if (verbose) {
+        std::printf("Frame %u: %u Cmds, %.3f ms\n",
+          iFrameCur, (uint)frames[iFrameCur].size(), dt);
+      }
+    }
+  }
+  // report
+  if (dts.empty()) {
+    std::fprintf(stderr, "ERROR: No frames replayed from '%s'!\n",
+      fileTrace);
+    return 1;
+  }
+  double sum = 0.0;
+  for (double dt : dts) sum += dt;
+  std::sort(dts.begin(), dts.end());
+  std::printf("Replayed %u frames (%ux%u): "
+    "min %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f, mean %.3f ms\n",
+    (uint)dts.size(), width, height, dts.front(),
+    getPercentile(dts, 0.50), getPercentile(dts, 0.90),
+    getPercentile(dts, 0.99), dts.back(), sum / dts.size());
+  if (fileProfile) {
+    profiler.enable(false); profiler.stopTrace();
+    std::fputs(profiler.getSummary().c_str(), stdout);
+    if (!profiler.writeTrace(fileProfile)) {
+      std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileProfile);
+      return 1;
+    }
+  }
+  // write output
+  if (fileOut) { // (in size of last replayed frame)
+    const uint widthOut = context.getRenderWidth();
+    const uint heightOut = context.getRenderHeight();
+    std::vector<uint32> rgba(context.getRGBA(),
+      context.getRGBA() + (size_t)widthOut * heightOut);
+    if (context.getPixelFormat() == RenderContext::ARGB32Premultiplied) {
+      for (uint32 &pixel : rgba) pixel = swapRB(pixel);
+    }
+    if (!writeImage(fileOut, widthOut, heightOut, rgba.data())) {
+      std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileOut);
+      return 1;
+    }
+  }
+  return 0;
+}
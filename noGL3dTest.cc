@@ -0,0 +1,726 @@
+// regression test of renderer: golden images and frame times (without Qt)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ApiTrace.h"
+#include "color.h"
+#include "CommandBuffer.h"
+#include "image.h"
+#include "MeshOpt.h"
+#include "RenderContext.h"
+#include "Scene.h"
+#include "Sphere.h"
+
+namespace {
+
+const char *const usage =
+  "Usage: noGL3dTest [OPTIONS]\n"
+  "Renders a fixed set of test scenes (all mode combinations and\n"
+  "clipping edge cases) and compares the images against golden images\n"
+  "(or the image of an equivalent scene) and/or the frame times against\n"
+  "a baseline.\n"
+  "\n"
+  "Options:\n"
+  "  -g DIR      compare images against golden images in DIR\n"
+  "  -u          update golden images in DIR (instead of comparing)\n"
+  "  -d DIR      write rendered and difference images of failed scenes\n"
+  "              into DIR\n"
+  "  -e TOL      tolerance per color channel (default: 2)\n"
+  "  -f RATIO    max. ratio of pixels exceeding tolerance (default: 0.002)\n"
+  "  -B FILE     compare frame times against baseline in FILE\n"
+  "  -U FILE     write frame times as baseline into FILE\n"
+  "  -t RATIO    max. ratio of frame time to baseline (default: 1.2)\n"
+  "  -s WxH      viewport size for frame times (default: 640x480)\n"
+  "  -n N        number of measured repetitions (default: 10)\n"
+  "  -k NAME     run only scenes which contain NAME\n"
+  "  -j N        number of worker threads (default: cores - 1)\n";
+
+// size of golden images
+const uint WidthGolden = 64, HeightGolden = 48;
+
+// geometry of test scenes
+enum Geom {
+  GeomNone, ///< nothing (clear only)
+  GeomSphere, ///< sphere of demo
+  GeomSphereAdaptive, ///< sphere tessellated for view (see setup())
+  GeomSphereOptimized, ///< sphere of demo with optimized order
+  GeomSphereQuantized, ///< sphere of demo with quantized vertices
+  GeomSphereCoords, ///< sphere of demo with coordinates only (VertexC)
+  GeomSphereSoA, ///< sphere of demo as structure of arrays (MeshSoA)
+  GeomSphereCmdBufs, ///< sphere of demo recorded into command buffers
+  GeomPlane, ///< ground plane from near camera to beyond far plane
+  GeomHuge, ///< triangles with vertices far outside of view
+  GeomDegenerate ///< zero area, collinear, and edge-on triangles
+};
+
+// test scene
+struct TestScene {
+  std::string name;
+  uint mode; // enabled modes (bit i set ... Mode i enabled)
+  Geom geom;
+  Vec3f posCam; // position of camera
+  float dNear; // near clip distance
+  int heatKind; // >= 0 ... compare heatmap of this kind instead of image
+  // render scale (< 1 ... image is scaled up bilinearly to viewport size)
+  float renderScale;
+  // scene which must look the same (compared against its image instead of
+  // a golden image, empty ... none)
+  std::string ref;
+};
+
+// makes the list of test scenes
+std::vector<TestScene> makeScenes()
+{
+  enum {
+    Front = 1 << RenderContext::FrontSide,
+    Back = 1 << RenderContext::BackSide,
+    DepthBuffer = 1 << RenderContext::DepthBuffer,
+    DepthTest = 1 << RenderContext::DepthTest,
+    Smooth = 1 << RenderContext::Smooth,
+    Blending = 1 << RenderContext::Blending,
+    Texturing = 1 << RenderContext::Texturing,
+    Lighting = 1 << RenderContext::Lighting,
+    Heatmap = 1 << RenderContext::Heatmap
+  };
+  const Vec3f posCam(0.0f, 0.0f, 4.0f);
+  std::vector<TestScene> scenes;
+  // all combinations of modes which select a flavor of rasterize()
+  // (Heatmap is checked by consistency, see checkConsistency())
+  static const char *const depthNames[] = {
+    "nodepth", "depthbuffer", "depthtest"
+  };
+  static const uint depthModes[] = { 0, DepthBuffer, DepthBuffer | DepthTest };
+  for (uint i = 0; i < 3 * 16; ++i) {
+    const uint flags = i / 3;
+    TestScene scene = {
+      std::string("modes-") + depthNames[i % 3],
+      Front | Back | depthModes[i % 3], GeomSphere, posCam, 0.01f, -1, 1.0f, ""
+    };
+    if (flags & 1) { scene.name += "-smooth"; scene.mode |= Smooth; }
+    if (flags & 2) { scene.name += "-blending"; scene.mode |= Blending; }
+    if (flags & 4) { scene.name += "-texturing"; scene.mode |= Texturing; }
+    if (flags & 8) { scene.name += "-lighting"; scene.mode |= Lighting; }
+    scenes.push_back(scene);
+  }
+  const uint modeStd = DepthBuffer | DepthTest | Smooth | Texturing | Lighting;
+  // culling
+  scenes.push_back({ "cull-back", Front | modeStd, GeomSphere, posCam,
+    0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "cull-front", Back | modeStd, GeomSphere, posCam,
+    0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "cull-all", modeStd, GeomSphere, posCam, 0.01f, -1,
+    1.0f, "" });
+  // optimized order of triangles and vertices
+  scenes.push_back({ "optimized", Front | modeStd, GeomSphereOptimized,
+    posCam, 0.01f, -1, 1.0f, "cull-back" });
+  // quantized vertices
+  scenes.push_back({ "quantized", Front | modeStd, GeomSphereQuantized,
+    posCam, 0.01f, -1, 1.0f, "cull-back" });
+  // coordinates only (current normal, i.e. lit uniformly, and texture
+  // coordinate, i.e. one texel)
+  scenes.push_back({ "coords", Front | modeStd, GeomSphereCoords,
+    posCam, 0.01f, -1, 1.0f, "" });
+  // structure of arrays
+  scenes.push_back({ "soa", Front | modeStd, GeomSphereSoA,
+    posCam, 0.01f, -1, 1.0f, "cull-back" });
+  scenes.push_back({ "soa-clip-sides", Front | modeStd, GeomSphereSoA,
+    Vec3f(0.0f, 0.0f, 1.5f), 0.01f, -1, 1.0f, "clip-sides" });
+  // command buffers (recorded by multiple threads, replayed in order)
+  scenes.push_back({ "cmdbufs", Front | modeStd, GeomSphereCmdBufs,
+    posCam, 0.01f, -1, 1.0f, "cull-back" });
+  // clipping
+  scenes.push_back({ "clip-near", Front | Back | modeStd, GeomSphere,
+    Vec3f(0.0f, 0.0f, 1.2f), 0.5f, -1, 1.0f, "" });
+  scenes.push_back({ "clip-sides", Front | modeStd, GeomSphere,
+    Vec3f(0.0f, 0.0f, 1.5f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "clip-corner", Front | modeStd, GeomSphere,
+    Vec3f(1.1f, 0.8f, 3.0f), 0.01f, -1, 1.0f, "" });
+  // clipping with flat shading (sub-triangles share the polygon's color)
+  scenes.push_back({ "clip-near-flat", (Front | Back | modeStd) & ~Smooth,
+    GeomSphere, Vec3f(0.0f, 0.0f, 1.2f), 0.5f, -1, 1.0f, "" });
+  scenes.push_back({ "clip-sides-flat", (Front | modeStd) & ~Smooth,
+    GeomSphere, Vec3f(0.0f, 0.0f, 1.5f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "clip-inside", Front | Back | modeStd, GeomSphere,
+    Vec3f(0.2f, 0.1f, 0.3f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "clip-plane", Front | Back | modeStd, GeomPlane,
+    Vec3f(0.0f, 0.0f, 2.5f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "clip-huge", Front | Back | modeStd, GeomHuge,
+    Vec3f(0.0f, 0.0f, 2.5f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "degenerate", Front | Back | modeStd, GeomDegenerate,
+    Vec3f(0.0f, 0.0f, 2.5f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "tiny", Front | modeStd, GeomSphere,
+    Vec3f(0.0f, 0.0f, 30.0f), 0.01f, -1, 1.0f, "" });
+  // render scale (exact ratio and ratio with remainder of SIMD width)
+  scenes.push_back({ "scale-half", Front | modeStd, GeomSphere,
+    posCam, 0.01f, -1, 0.5f, "" });
+  scenes.push_back({ "scale-odd", Front | modeStd, GeomSphere,
+    Vec3f(0.0f, 0.0f, 1.5f), 0.01f, -1, 0.55f, "" });
+  // adaptive tessellation (must be free of cracks)
+  scenes.push_back({ "adaptive", Front | modeStd, GeomSphereAdaptive,
+    posCam, 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "adaptive-near", Front | modeStd, GeomSphereAdaptive,
+    Vec3f(0.3f, 0.2f, 1.3f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "adaptive-tiny", Front | modeStd, GeomSphereAdaptive,
+    Vec3f(0.0f, 0.0f, 30.0f), 0.01f, -1, 1.0f, "" });
+  scenes.push_back({ "clear", modeStd, GeomNone, posCam, 0.01f, -1,
+    1.0f, "" });
+  // heatmaps
+  scenes.push_back({ "heat-writes", Front | Back | Blending | Heatmap
+    | DepthBuffer | DepthTest, GeomSphere, posCam, 0.01f,
+    RenderContext::HeatWrites, 1.0f, "" });
+  scenes.push_back({ "heat-depthfailed", Front | Back | Heatmap
+    | DepthBuffer | DepthTest, GeomSphere, posCam, 0.01f,
+    RenderContext::HeatDepthFailed, 1.0f, "" });
+  scenes.push_back({ "heat-fragments", Front | Back | Heatmap | modeStd,
+    GeomPlane, Vec3f(0.0f, 0.0f, 2.5f), 0.01f,
+    RenderContext::HeatFragments, 1.0f, "" });
+  return scenes;
+}
+
+// makes a checker texture with semi-transparent fields
+std::vector<uint32> makeCheckerTex(uint size)
+{
+  std::vector<uint32> img(size * size);
+  for (uint y = 0; y < size; ++y) {
+    for (uint x = 0; x < size; ++x) {
+      img[y * size + x] = ((x / 8 + y / 8) & 1) ? 0xff2040e0 : 0x80f0f0f0;
+    }
+  }
+  return img;
+}
+
+// makes the mesh for a geometry
+void makeMesh(MeshT<VertexCNT> &mesh, Geom geom, JobSystem &jobSys)
+{
+  mesh.vtcs.clear(); mesh.idcs.clear();
+  const Vec3f normal(0.0f, 0.0f, 1.0f);
+  auto addVtx = [&](const Vec3f &p) {
+    mesh.vtcs.emplace_back(p, normal,
+      Vec2f(clamp(p.x, -2.0f, 2.0f), clamp(p.y, -2.0f, 2.0f)));
+  };
+  auto addTri = [&](const Vec3f &p0, const Vec3f &p1, const Vec3f &p2) {
+    addVtx(p0); addVtx(p1); addVtx(p2);
+  };
+  switch (geom) {
+    case GeomNone: break;
+    case GeomSphere:
+    case GeomSphereQuantized: // (converted in Renderer::setup())
+    case GeomSphereCoords:
+    case GeomSphereSoA:
+    case GeomSphereCmdBufs:
+      makeSphereMeshIndexed(mesh, 3, &jobSys); break;
+    case GeomSphereAdaptive: break; // depends on view
+    case GeomSphereOptimized:
+      makeSphereMeshIndexed(mesh, 3, &jobSys); optimizeMesh(mesh);
+      break;
+    case GeomPlane: { // crosses side and far planes, texture repeated
+      // Vertices behind the camera are avoided as clipping happens after
+      // the perspective divide.
+      const Vec3f up(0.0f, 1.0f, 0.0f);
+      const float y = -0.5f, x0 = -20.0f, x1 = 20.0f;
+      const float z0 = 2.0f, z1 = -300.0f;
+      mesh.vtcs.emplace_back(Vec3f(x0, y, z0), up, Vec2f(0.0f, 0.0f));
+      mesh.vtcs.emplace_back(Vec3f(x1, y, z0), up, Vec2f(20.0f, 0.0f));
+      mesh.vtcs.emplace_back(Vec3f(x1, y, z1), up, Vec2f(20.0f, 155.0f));
+      mesh.vtcs.emplace_back(Vec3f(x0, y, z0), up, Vec2f(0.0f, 0.0f));
+      mesh.vtcs.emplace_back(Vec3f(x1, y, z1), up, Vec2f(20.0f, 155.0f));
+      mesh.vtcs.emplace_back(Vec3f(x0, y, z1), up, Vec2f(0.0f, 155.0f));
+    } break;
+    case GeomHuge: // vertices far outside of view (guard band precision)
+      addTri(Vec3f(-1E4f, -1E4f, -1.0f), Vec3f(1E4f, -1E4f, -1.0f),
+        Vec3f(0.0f, 0.5f, -1.0f));
+      addTri(Vec3f(-0.2f, -0.2f, 0.0f), Vec3f(1E6f, 0.0f, 0.0f),
+        Vec3f(-0.2f, 0.6f, 0.0f));
+      addTri(Vec3f(-0.6f, 0.3f, 0.5f), Vec3f(-0.5f, 0.2f, 0.5f),
+        Vec3f(-0.55f, 0.35f, -1E5f));
+      break;
+    case GeomDegenerate: {
+      const Vec3f a(-0.4f, -0.3f, 0.0f), b(0.4f, 0.3f, 0.0f);
+      addTri(a, a, a); // point
+      addTri(a, b, b); // line
+      addTri(a, 0.5f * (a + b), b); // collinear
+      // edge-on (plane contains view direction)
+      addTri(Vec3f(0.0f, -0.5f, 0.0f), Vec3f(0.0f, 0.5f, 0.0f),
+        Vec3f(0.0f, 0.0f, -1.0f));
+      // sliver (thinner than a pixel)
+      addTri(Vec3f(-0.5f, 0.4f, 0.0f), Vec3f(0.5f, 0.4f, 0.0f),
+        Vec3f(0.5f, 0.4001f, 0.0f));
+      // regular triangle (as reference)
+      addTri(Vec3f(0.1f, -0.4f, 0.0f), Vec3f(0.5f, -0.4f, 0.0f),
+        Vec3f(0.3f, -0.1f, 0.0f));
+    } break;
+  }
+}
+
+// records the triangles of a mesh into command buffers
+// (each filled by its own thread with a contiguous range of triangles)
+void recordMesh(
+  const MeshT<VertexCNT> &mesh, std::vector<CommandBuffer> &cmdBufs)
+{
+  const size_t nTris = getNTris(mesh), nBufs = cmdBufs.size();
+  std::vector<std::thread> threads;
+  for (size_t iBuf = 0; iBuf < nBufs; ++iBuf) {
+    threads.emplace_back([&, iBuf]() {
+      CommandBuffer &cmdBuf = cmdBufs[iBuf];
+      cmdBuf.reset();
+      const size_t iVtx0 = 3 * (nTris * iBuf / nBufs);
+      const size_t iVtx1 = 3 * (nTris * (iBuf + 1) / nBufs);
+      for (size_t iVtx = iVtx0; iVtx < iVtx1; ++iVtx) {
+        const VertexCNT &vtx = getTriVtx(mesh, iVtx);
+        cmdBuf.setNormal(vtx.normal);
+        cmdBuf.setTexCoord(vtx.texCoord);
+        cmdBuf.drawVertex(vtx.coord);
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+}
+
+// renders a test scene
+struct Renderer {
+  RenderContext context;
+  MeshT<VertexCNT> mesh;
+  MeshT<VertexQCNT> meshQ; // quantized mesh (for GeomSphereQuantized)
+  MeshT<VertexC> meshC; // mesh of coordinates (for GeomSphereCoords)
+  MeshSoA meshSoA; // structure of arrays (for GeomSphereSoA)
+  // command buffers of mesh (for GeomSphereCmdBufs)
+  std::vector<CommandBuffer> cmdBufs;
+  Geom geomMesh;
+
+  Renderer(uint width, uint height, uint nThreads,
+    RenderContext::PixelFormat format = RenderContext::RGBA8888):
+    context(width, height, format), cmdBufs(4), geomMesh(GeomNone)
+  {
+    context.setThreads(nThreads);
+    const std::vector<uint32> img = makeCheckerTex(64);
+    context.setTex(context.loadTex(64, 64, img.data()));
+    context.setClearColor(Vec4f(0.5f, 0.75f, 1.0f, 1.0f));
+    context.setAmbient(0.2f);
+    context.setRenderCallback(
+      [&](RenderContext &context) {
+        context.clear(true, true);
+        context.setColor(Vec4f(1.0f, 0.9f, 0.8f, 0.75f));
+        switch (geomMesh) {
+          case GeomSphereQuantized: drawMesh(context, meshQ); break;
+          case GeomSphereCoords: drawMesh(context, meshC); break;
+          case GeomSphereSoA: drawMesh(context, meshSoA); break;
+          case GeomSphereCmdBufs: context.execute(cmdBufs); break;
+          default: drawMesh(context, mesh);
+        }
+      });
+  }
+
+  void setup(const TestScene &scene)
+  {
+    if (scene.geom != geomMesh || mesh.vtcs.empty()) {
+      makeMesh(mesh, geomMesh = scene.geom, context.getJobSystem());
+      if (geomMesh == GeomSphereQuantized) quantizeMesh(mesh, meshQ);
+      if (geomMesh == GeomSphereCoords) {
+        makeSphereMeshIndexed(meshC, 3, &context.getJobSystem());
+      }
+      if (geomMesh == GeomSphereSoA) convertToSoA(mesh, meshSoA);
+      if (geomMesh == GeomSphereCmdBufs) recordMesh(mesh, cmdBufs);
+    }
+    for (uint i = 0; i < RenderContext::NModes; ++i) {
+      context.enable((RenderContext::Mode)i, (scene.mode & 1 << i) != 0);
+    }
+    context.setRenderScale(scene.renderScale);
+    context.getProjMat()
+      = makePersp(degToRad(30.0f),
+        (float)context.getViewportWidth() / context.getViewportHeight(),
+        scene.dNear, 100.0f);
+    context.setCamMat(Mat4x4f(InitTrans, scene.posCam));
+    context.getModelMat()
+      = scene.geom == GeomSphere || scene.geom == GeomSphereAdaptive
+        || scene.geom == GeomSphereOptimized
+        || scene.geom == GeomSphereQuantized
+        || scene.geom == GeomSphereCoords
+        || scene.geom == GeomSphereSoA
+        || scene.geom == GeomSphereCmdBufs
+      ? Mat4x4f(InitRotY, degToRad(30.0f)) * Mat4x4f(InitRotX, degToRad(20.0f))
+      : Mat4x4f(InitIdent);
+    if (scene.geom == GeomSphereAdaptive) {
+      const SphereTessellation tess(
+        context.getProjMat(), context.getViewMat(), context.getModelMat(),
+        context.getRenderWidth(), context.getRenderHeight(), 0.25f, 6,
+        !context.isEnabled(RenderContext::BackSide));
+      makeSphereMeshAdaptive(mesh, tess);
+    }
+  }
+
+  // renders scene and returns image (or heatmap) as RGBA
+  std::vector<uint32> render(const TestScene &scene)
+  {
+    setup(scene); context.render();
+    std::vector<uint32> img;
+    if (scene.heatKind >= 0) {
+      context.getHeatmap((RenderContext::HeatKind)scene.heatKind, img);
+    } else if (scene.renderScale < 1.0f) { // scale up as in GUI
+      img.resize(
+        (size_t)context.getViewportWidth() * context.getViewportHeight());
+      scaleBilinear(context.getRenderWidth(), context.getRenderHeight(),
+        context.getRGBA(), context.getViewportWidth(),
+        context.getViewportHeight(), img.data(), &context.getJobSystem());
+    } else {
+      const uint32 *rgba = context.getRGBA();
+      img.assign(rgba,
+        rgba + context.getRenderWidth() * context.getRenderHeight());
+    }
+    // convert from pixel format of color buffer (e.g. unpremultiply)
+    if (scene.heatKind < 0
+      && context.getPixelFormat() != RenderContext::RGBA8888) {
+      for (uint32 &pixel : img) {
+        pixel = colorToRGBA(context.pixelToColor(pixel));
+      }
+    }
+    return img;
+  }
+};
+
+// result of image comparison
+struct Diff {
+  uint nPixels; // pixels exceeding tolerance
+  uint max; // max. difference of a color channel
+};
+
+// compares RGB of two images (alpha is ignored as in PPM files)
+Diff compare(
+  const std::vector<uint32> &img, const std::vector<uint32> &imgRef,
+  uint tol, std::vector<uint32> *pImgDiff = nullptr)
+{
+  Diff diff = { 0, 0 };
+  if (pImgDiff) pImgDiff->assign(img.size(), 0xff000000);
+  for (size_t i = 0; i < img.size(); ++i) {
+    uint max = 0;
+    for (uint shift = 0; shift < 24; shift += 8) {
+      const int d
+        = (int)(img[i] >> shift & 0xff) - (int)(imgRef[i] >> shift & 0xff);
+      max = std::max(max, (uint)std::abs(d));
+    }
+    diff.max = std::max(diff.max, max);
+    if (max > tol) {
+      ++diff.nPixels;
+      if (pImgDiff) (*pImgDiff)[i] = 0xff0000ff | std::min(max * 4, 255u) << 8;
+    }
+  }
+  return diff;
+}
+
+// checks that modes which must not change the image don't
+// (Heatmap, pipelined mode with raster bands, resizing of viewport)
+bool checkConsistency(
+  Renderer &renderer, Renderer &rendererSmall, const TestScene &scene,
+  const std::vector<uint32> &img, std::string &error)
+{
+  if (scene.heatKind < 0) {
+    TestScene sceneHeat = scene;
+    sceneHeat.mode |= 1 << RenderContext::Heatmap;
+    if (renderer.render(sceneHeat) != img) {
+      error = "image changed by Heatmap"; return false;
+    }
+  }
+  renderer.context.setRasterBands(4);
+  const bool ok = renderer.render(scene) == img;
+  renderer.context.setRasterBands(0);
+  if (!ok) { error = "image changed by raster bands"; return false; }
+  // a resized context must render like one created with that size
+  RenderContext &context = renderer.context;
+  const uint width = context.getViewportWidth();
+  const uint height = context.getViewportHeight();
+  context.setViewport(2 * width, 2 * height); renderer.render(scene);
+  context.setViewport(rendererSmall.context.getViewportWidth(),
+    rendererSmall.context.getViewportHeight());
+  const bool okSmall = renderer.render(scene) == rendererSmall.render(scene);
+  context.setViewport(width, height);
+  if (!okSmall || renderer.render(scene) != img) {
+    error = "image changed by resizing viewport"; return false;
+  }
+  return true;
+}
+
+// checks that the replay of an API trace reproduces the traced frame
+// exactly (replayed like noGL3dReplay does)
+bool checkApiTrace(
+  Renderer &renderer, const TestScene &scene, const std::string &file,
+  std::string &error)
+{
+  // record
+  RenderContext &context = renderer.context;
+  if (!context.startApiTrace(file)) {
+    error = "cannot write " + file; return false;
+  }
+  renderer.setup(scene); context.render();
+  if (!context.stopApiTrace()) {
+    error = "cannot write " + file; std::remove(file.c_str()); return false;
+  }
+  // read textures and frames
+  std::unique_ptr<RenderContext> pContextReplay;
+  std::vector<CommandBuffer> frames;
+  { ApiTraceReader reader;
+    bool end = !reader.open(file);
+    if (!end) {
+      pContextReplay.reset(new RenderContext(
+        reader.getWidth(), reader.getHeight(),
+        (RenderContext::PixelFormat)reader.getFormat()));
+      pContextReplay->setThreads(context.getJobSystem().getThreads());
+    }
+    while (!end) {
+      switch (reader.read()) {
+        case ApiTraceReader::RecTex:
+          pContextReplay->loadTex(
+            reader.getTexWidth(), reader.getTexHeight(), reader.getTexImg());
+          break;
+        case ApiTraceReader::RecFrame:
+          frames.push_back(std::move(reader.getFrame()));
+          break;
+        case ApiTraceReader::RecEnd: end = true; break;
+        case ApiTraceReader::RecError:
+          pContextReplay.reset(); end = true; break;
+      }
+    }
+    if (!pContextReplay) error = "cannot read trace: " + reader.getError();
+  } // (closes file)
+  std::remove(file.c_str());
+  if (!pContextReplay) return false;
+  if (frames.size() != 1) {
+    error = "trace has " + std::to_string(frames.size()) + " frames";
+    return false;
+  }
+  // replay
+  RenderContext &contextReplay = *pContextReplay;
+  contextReplay.setRenderCallback(
+    [&](RenderContext &context) { context.execute(frames[0]); });
+  contextReplay.render();
+  const uint width = context.getRenderWidth();
+  const uint height = context.getRenderHeight();
+  if (contextReplay.getRenderWidth() != width
+    || contextReplay.getRenderHeight() != height
+    || !std::equal(context.getRGBA(), context.getRGBA() + width * height,
+      contextReplay.getRGBA())) {
+    error = "image changed by replay of API trace"; return false;
+  }
+  return true;
+}
+
+// loads baseline of frame times (name -> ms)
+bool loadBaseline(const char *file, std::map<std::string, double> &dts)
+{
+  std::ifstream fIn(file);
+  if (!fIn) return false;
+  std::string line;
+  while (std::getline(fIn, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream in(line);
+    std::string name; double dt;
+    if (!(in >> name >> dt)) return false;
+    dts[name] = dt;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  // default settings
+  const char *dirGolden = nullptr;
+  bool update = false;
+  const char *dirOut = nullptr;
+  uint tol = 2;
+  double ratioPixels = 0.002;
+  const char *fileBaseline = nullptr;
+  const char *fileBaselineOut = nullptr;
+  double threshold = 1.2;
+  uint width = 640, height = 480;
+  uint nReps = 10;
+  const char *filter = nullptr;
+  uint nThreads = JobSystem::getDefaultThreads();
+  // process command line
+  for (int i = 1; i < argc; ++i) {
+    const char *opt = argv[i];
+    if (std::strcmp(opt, "-h") == 0 || std::strcmp(opt, "--help") == 0) {
+      std::fputs(usage, stdout); return 0;
+    }
+    if (std::strcmp(opt, "-u") == 0) { update = true; continue; }
+    const char *arg = i + 1 < argc ? argv[++i] : nullptr;
+    bool ok = arg && opt[0] == '-' && opt[1] && !opt[2];
+    if (ok) {
+      switch (opt[1]) {
+        case 'g': dirGolden = arg; break;
+        case 'd': dirOut = arg; break;
+        case 'e': ok = std::sscanf(arg, "%u", &tol) == 1; break;
+        case 'f': ok = std::sscanf(arg, "%lf", &ratioPixels) == 1; break;
+        case 'B': fileBaseline = arg; break;
+        case 'U': fileBaselineOut = arg; break;
+        case 't':
+          ok = std::sscanf(arg, "%lf", &threshold) == 1 && threshold > 0.0;
+          break;
+        case 's':
+          ok = std::sscanf(arg, "%ux%u", &width, &height) == 2
+            && width > 0 && height > 0;
+          break;
+        case 'n': ok = std::sscanf(arg, "%u", &nReps) == 1 && nReps > 0;
+          break;
+        case 'k': filter = arg; break;
+        case 'j': ok = std::sscanf(arg, "%u", &nThreads) == 1; break;
+        default: ok = false;
+      }
+    }
+    if (!ok) {
+      std::fprintf(stderr, "ERROR: Wrong option '%s'!\n\n%s", opt, usage);
+      return 1;
+    }
+  }
+  if (!dirGolden && !fileBaseline && !fileBaselineOut) {
+    std::fprintf(stderr, "ERROR: Nothing to test!\n\n%s", usage);
+    return 1;
+  }
+  if (update && !dirGolden) {
+    std::fprintf(stderr, "ERROR: -u needs -g DIR!\n\n%s", usage);
+    return 1;
+  }
+  const std::vector<TestScene> scenesAll = makeScenes();
+  std::vector<TestScene> scenes = scenesAll;
+  if (filter) {
+    scenes.erase(
+      std::remove_if(scenes.begin(), scenes.end(),
+        [&](const TestScene &scene) {
+          return scene.name.find(filter) == std::string::npos;
+        }),
+      scenes.end());
+  }
+  uint nFailed = 0;
+  // golden images
+  if (dirGolden) {
+    Renderer renderer(WidthGolden, HeightGolden, nThreads);
+    Renderer rendererSmall(WidthGolden / 2, HeightGolden / 2, nThreads);
+    Renderer rendererARGB(WidthGolden, HeightGolden, nThreads,
+      RenderContext::ARGB32Premultiplied);
+    // temporary file for API traces
+    const std::string fileTrace
+      = std::string(dirOut ? dirOut : ".") + "/noGL3dTest.trace";
+    for (const TestScene &scene : scenes) {
+      const std::string file
+        = std::string(dirGolden) + "/" + scene.name + ".ppm";
+      const std::vector<uint32> img = renderer.render(scene);
+      std::string error;
+      bool ok = checkConsistency(renderer, rendererSmall, scene, img, error)
+        && checkApiTrace(renderer, scene, fileTrace, error);
+      // compares image against reference image (golden or of other scene)
+      auto compareRef = [&](const std::vector<uint32> &img,
+        const std::vector<uint32> &imgRef, const std::string &name) {
+        std::vector<uint32> imgDiff;
+        const Diff diff = compare(img, imgRef, tol, &imgDiff);
+        if (diff.nPixels <= ratioPixels * img.size()) return true;
+        error = std::to_string(diff.nPixels) + " pixels differ (max. "
+          + std::to_string(diff.max) + ")";
+        if (dirOut) {
+          const std::string path = std::string(dirOut) + "/" + name;
+          writePPM(path + ".ppm", WidthGolden, HeightGolden, img.data());
+          writePPM(path + "-diff.ppm", WidthGolden, HeightGolden,
+            imgDiff.data());
+        }
+        return false;
+      };
+      if (!scene.ref.empty()) { // no golden image (even with -u)
+        const std::vector<TestScene>::const_iterator iter
+          = std::find_if(scenesAll.begin(), scenesAll.end(),
+            [&](const TestScene &sceneRef) {
+              return sceneRef.name == scene.ref;
+            });
+        if (ok && iter == scenesAll.end()) {
+          ok = false; error = "unknown reference scene " + scene.ref;
+        } else if (ok
+          && !compareRef(img, renderer.render(*iter), scene.name)) {
+          ok = false; error += " from " + scene.ref;
+        }
+      } else if (update) {
+        if (!writePPM(file, WidthGolden, HeightGolden, img.data())) {
+          std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", file.c_str());
+          return 1;
+        }
+      } else if (ok) {
+        uint w, h; std::vector<uint32> imgRef;
+        if (!readPPM(file, w, h, imgRef)) {
+          ok = false; error = "cannot read " + file;
+        } else if (w != WidthGolden || h != HeightGolden) {
+          ok = false; error = "size of golden image doesn't match";
+        } else if ((ok = compareRef(img, imgRef, scene.name))
+          && scene.heatKind < 0) { // must match in other pixel format, too
+          ok = compareRef(
+            rendererARGB.render(scene), imgRef, scene.name + "-argb");
+          if (!ok) error += " in ARGB32Premultiplied";
+        }
+      }
+      std::printf("%s %s%s%s\n", ok ? "ok  " : "FAIL", scene.name.c_str(),
+        ok ? "" : ": ", error.c_str());
+      nFailed += !ok;
+    }
+  }
+  // frame times
+  if (fileBaseline || fileBaselineOut) {
+    std::map<std::string, double> dtsBase;
+    if (fileBaseline && !loadBaseline(fileBaseline, dtsBase)) {
+      std::fprintf(stderr, "ERROR: Cannot read '%s'!\n", fileBaseline);
+      return 1;
+    }
+    FILE *fOut = nullptr;
+    if (fileBaselineOut) {
+      if (!(fOut = std::fopen(fileBaselineOut, "w"))) {
+        std::fprintf(stderr, "ERROR: Cannot open '%s'!\n", fileBaselineOut);
+        return 1;
+      }
+      std::fprintf(fOut, "# frame times (p50 in ms) of noGL3dTest at %ux%u\n",
+        width, height);
+    }
+    Renderer renderer(width, height, nThreads);
+    std::vector<double> dts(nReps);
+    for (const TestScene &scene : scenes) {
+      renderer.setup(scene);
+      renderer.context.render(); // warm-up
+      for (double &dt : dts) {
+        const std::chrono::steady_clock::time_point t0
+          = std::chrono::steady_clock::now();
+        renderer.context.render();
+        dt = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - t0).count();
+      }
+      std::sort(dts.begin(), dts.end());
+      const double dt = dts[(nReps - 1) / 2];
+      if (fOut) std::fprintf(fOut, "%s %.6f\n", scene.name.c_str(), dt);
+      if (!fileBaseline) {
+        std::printf("time %s: %.3f ms\n", scene.name.c_str(), dt);
+        continue;
+      }
+      const std::map<std::string, double>::const_iterator iter
+        = dtsBase.find(scene.name);
+      if (iter == dtsBase.end()) {
+        std::printf("time %s: %.3f ms (no baseline)\n",
+          scene.name.c_str(), dt);
+        continue;
+      }
+      const bool ok = dt <= threshold * iter->second;
+      std::printf("%s %s: %.3f ms (baseline %.3f ms, %+.1f %%)\n",
+        ok ? "ok  " : "SLOW", scene.name.c_str(), dt, iter->second,
+        100.0 * (dt / iter->second - 1.0));
+      nFailed += !ok;
+    }
+    if (fOut && std::fclose(fOut) != 0) {
+      std::fprintf(stderr, "ERROR: Cannot write '%s'!\n", fileBaselineOut);
+      return 1;
+    }
+  }
+  if (nFailed) std::printf("%u checks failed.\n", nFailed);
+  return nFailed ? 1 : 0;
+}
@@ -4,7 +4,7 @@
 
 int main(int argc, char **argv)
 {
-  const int width = 1024, height = 768;
+  const int width = 1024, height = 768; // initial size of viewport
   qDebug() << "Qt Version:" << QT_VERSION_STR;
   QApplication app(argc, argv);
   MainWindow qWin(width, height);
@@ -1,4 +1,4 @@
-SOURCES = qNoGL3dDemo.cc MainWindow.cc RenderWidget.cc RenderContext.cc color.cc linmath.cc
+SOURCES = qNoGL3dDemo.cc MainWindow.cc RenderWidget.cc RenderContext.cc ApiTrace.cc PerfCounters.cc Profiler.cc Session.cc JobSystem.cc color.cc linmath.cc
 
 QT += widgets
 